@@ -0,0 +1,93 @@
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+from pathlib import Path
+
+# The bundle format understood by `sel4cp.h`:
+#     - a header: the magic number and the number of ELF files (2 x 4 bytes).
+#     - an entry for each ELF file: the PD id, the CRC-32, the offset and the size of the ELF file (4 + 4 + 8 + 8 bytes).
+#     - the ELF files in the order of the entries, each starting at a page-aligned offset.
+BUNDLE_MAGIC = 0x4c444253 # "SBDL" in little-endian.
+BUNDLE_MAX_PROGRAMS = 16
+HEADER_FORMAT = "<II"
+ENTRY_FORMAT = "<IIQQ"
+PAGE_SIZE = 0x1000
+
+
+def align(n: int) -> int:
+    return (n + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)
+
+
+def build_bundle(programs: list[tuple[bytes, int]]) -> bytes:
+    """
+        Builds a bundle of the given ELF files, each paired with the id of the PD to load it into.
+    """
+    if not 0 < len(programs) <= BUNDLE_MAX_PROGRAMS:
+        raise ValueError(f"a bundle must contain between 1 and {BUNDLE_MAX_PROGRAMS} ELF files")
+    pd_ids = [pd_id for _, pd_id in programs]
+    if len(set(pd_ids)) != len(pd_ids):
+        raise ValueError("several ELF files are loaded into the same PD")
+
+    offset = align(struct.calcsize(HEADER_FORMAT) + len(programs) * struct.calcsize(ENTRY_FORMAT))
+    manifest = bytearray(struct.pack(HEADER_FORMAT, BUNDLE_MAGIC, len(programs)))
+    body = bytearray()
+    for elf, pd_id in programs:
+        manifest += struct.pack(ENTRY_FORMAT, pd_id, zlib.crc32(elf), offset + len(body), len(elf))
+        body += elf
+        body += bytes(align(len(body)) - len(body))
+
+    return bytes(manifest) + bytes(offset - len(manifest)) + bytes(body)
+
+
+def patch_program(elf_path: str, system_path: str, access_rights_path: str, strip: bool) -> bytes:
+    """
+        Returns the given ELF file patched with the access rights in the given XML file,
+        leaving the ELF file itself untouched. If strip is set, the section headers and the symbol table are removed.
+    """
+    with tempfile.TemporaryDirectory() as directory:
+        patched_path = Path(directory) / Path(elf_path).name
+        shutil.copyfile(elf_path, patched_path)
+        options = ["--strip"] if strip else []
+        subprocess.run(["sel4cp_set_up_access_rights", *options, str(patched_path), system_path, access_rights_path], check=True)
+        return patched_path.read_bytes()
+
+
+def bundle_programs():
+    args = sys.argv[1:]
+    system_path = None
+    strip = False
+    while len(args) > 0 and args[0].startswith("--"):
+        if args[0] == "--system" and len(args) >= 2:
+            system_path = args[1]
+            args = args[2:]
+        elif args[0] == "--strip":
+            strip = True
+            args = args[1:]
+        else:
+            break
+    if len(args) < 2:
+        sys.exit("Usage: python3 bundle_programs.py [--system <system-configuration-file>] [--strip] <output-file> <program> [<program> ...]\n"
+                 "where <program> is either <patched-ELF-file>:<pd-id> or <ELF-file>:<access-rights-file>:<pd-id>")
+
+    programs = []
+    for arg in args[1:]:
+        parts = arg.split(":")
+        if len(parts) == 2:
+            programs.append((Path(parts[0]).read_bytes(), int(parts[1], 0)))
+        elif len(parts) == 3:
+            if system_path is None:
+                sys.exit(f"A system configuration file is required to patch {parts[0]} with access rights")
+            programs.append((patch_program(parts[0], system_path, parts[1], strip), int(parts[2], 0)))
+        else:
+            sys.exit(f"Invalid program: {arg}")
+
+    bundle = build_bundle(programs)
+    Path(args[0]).write_bytes(bundle)
+    print(f"Bundled {len(programs)} programs in {len(bundle)} bytes")
+
+
+if __name__ == "__main__":
+    bundle_programs()
@@ -0,0 +1,138 @@
+import struct
+import sys
+import zlib
+from pathlib import Path
+
+# The compressed container understood by `lzss.h` and `elf_loader.h`.
+# The container starts with a header of 16 bytes:
+#     - 4 bytes: the magic number.
+#     - 4 bytes: the CRC-32 of the uncompressed ELF file.
+#     - 8 bytes: the size of the uncompressed ELF file.
+# The header is followed by the LZSS-compressed ELF file.
+MAGIC = 0x315a4c53 # "SLZ1" in little-endian.
+HEADER_FORMAT = "<IIQ"
+
+# The LZSS format: a flag byte precedes every group of 8 tokens, where bit i (starting from
+# the least significant bit) is set if token i is a match and clear if it is a literal byte.
+# A match is encoded in 2 bytes: the low byte of (offset - 1), followed by a byte holding
+# the high 4 bits of (offset - 1) and (length - MIN_MATCH) in the high 4 bits. If the latter is 15,
+# an extra byte with the remaining length follows.
+WINDOW_SIZE = 0x1000
+MIN_MATCH = 3
+MAX_SHORT_MATCH = MIN_MATCH + 14
+MAX_MATCH = MIN_MATCH + 15 + 0xff
+MAX_CHAIN_LENGTH = 128 # the maximum number of earlier positions to try when looking for a match.
+
+
+def find_match(data: bytes, pos: int, chains: dict[bytes, list[int]]) -> tuple[int, int]:
+    """
+        Returns the offset and length of the longest match for the bytes at pos
+        within the preceding WINDOW_SIZE bytes, or a length of 0 if there is none.
+    """
+    best_offset, best_length = 0, 0
+    max_length = min(MAX_MATCH, len(data) - pos)
+    if max_length < MIN_MATCH:
+        return 0, 0
+
+    candidates = chains.get(data[pos:pos + MIN_MATCH], [])
+    for candidate in reversed(candidates[-MAX_CHAIN_LENGTH:]):
+        offset = pos - candidate
+        if offset > WINDOW_SIZE:
+            break
+        length = 0
+        # The match may overlap the bytes being encoded, as the decoder copies byte by byte.
+        while length < max_length and data[candidate + length] == data[pos + length]:
+            length += 1
+        if length > best_length:
+            best_offset, best_length = offset, length
+            if length == max_length:
+                break
+
+    return best_offset, best_length
+
+
+def compress(data: bytes) -> bytes:
+    """
+        Compresses the given data into a container that can be sent to the loader.
+    """
+    chains: dict[bytes, list[int]] = {}
+    output = bytearray(struct.pack(HEADER_FORMAT, MAGIC, zlib.crc32(data), len(data)))
+    flags_idx = 0
+    num_tokens = 8
+
+    pos = 0
+    while pos < len(data):
+        if num_tokens == 8:
+            flags_idx = len(output)
+            output.append(0)
+            num_tokens = 0
+
+        offset, length = find_match(data, pos, chains)
+        if length >= MIN_MATCH:
+            output[flags_idx] |= 1 << num_tokens
+            length_code = min(length - MIN_MATCH, 15)
+            output.append((offset - 1) & 0xff)
+            output.append(((offset - 1) >> 8) | (length_code << 4))
+            if length_code == 15:
+                output.append(length - MAX_SHORT_MATCH - 1)
+        else:
+            length = 1
+            output.append(data[pos])
+        num_tokens += 1
+
+        for i in range(pos, pos + length):
+            chains.setdefault(data[i:i + MIN_MATCH], []).append(i)
+        pos += length
+
+    return bytes(output)
+
+
+def decompress(container: bytes) -> bytes:
+    """
+        Decompresses the given container, mirroring the decoder of the loader.
+    """
+    magic, crc, size = struct.unpack_from(HEADER_FORMAT, container)
+    if magic != MAGIC:
+        raise ValueError("not a compressed ELF file")
+
+    output = bytearray()
+    pos = struct.calcsize(HEADER_FORMAT)
+    while pos < len(container):
+        flags = container[pos]
+        pos += 1
+        for i in range(8):
+            if pos >= len(container):
+                break
+            if flags & (1 << i):
+                low, high = container[pos], container[pos + 1]
+                pos += 2
+                offset = (low | ((high & 0x0f) << 8)) + 1
+                length = (high >> 4) + MIN_MATCH
+                if length == MAX_SHORT_MATCH + 1:
+                    length += container[pos]
+                    pos += 1
+                for _ in range(length):
+                    output.append(output[-offset])
+            else:
+                output.append(container[pos])
+                pos += 1
+
+    if len(output) != size or zlib.crc32(output) != crc:
+        raise ValueError("the decompressed ELF file does not match the container header")
+    return bytes(output)
+
+
+def compress_program():
+    if len(sys.argv) != 3:
+        sys.exit("Usage: python3 compress_program.py <ELF-file> <output-file>")
+
+    data = Path(sys.argv[1]).read_bytes()
+    container = compress(data)
+    if decompress(container) != data:
+        sys.exit("Failed to compress the ELF file")
+    Path(sys.argv[2]).write_bytes(container)
+    print(f"Compressed {len(data)} bytes to {len(container)} bytes ({len(data) / len(container):.1f}x)")
+
+
+if __name__ == "__main__":
+    compress_program()
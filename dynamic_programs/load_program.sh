@@ -1,16 +1,24 @@
 #!/bin/sh
-if [ $# -ne 2 ]
+# With --cached, the loader is first asked to load the ELF file from its image cache.
+CACHED=""
+if [ "$1" = "--cached" ]
+    then
+        CACHED="--cached"
+        shift
+fi
+
+if [ $# -lt 2 ] || [ $# -gt 3 ]
     then 
-        echo "Usage: sh load_program.sh <ELF-file> <target>"
+        echo "Usage: sh load_program.sh [--cached] <ELF-file> <target> [<pd-id>]"
         exit 1
 fi
 
-SIZE=$(ls -rtl $1 | awk '{printf "%x\n", $5}')
+SCRIPT_PATH=$(dirname "$0")
 
-echo "Sending ELF file size $SIZE"
-echo $SIZE > $2
+# The PD id 0 lets the loader choose the PD to load the ELF file into.
+PD_ID=${3:-0}
 
 echo "Sending ELF file!"
-cat $1 > $2
+python3 $SCRIPT_PATH/send_program.py $CACHED $1 $2 $PD_ID || exit 1
 
 echo "Sent ELF file!"
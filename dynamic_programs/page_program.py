@@ -0,0 +1,201 @@
+import struct
+import sys
+from pathlib import Path
+
+# The paged image format understood by `sel4cp.h`, which is loaded without interpreting ELF program headers:
+#     - a header: the magic number, the number of runs, the entry point, the offset and the size of
+#       the access right table, and the offset of the contents of the pages (4 + 4 + 8 + 4 + 4 + 8 bytes).
+#     - an entry for each run of consecutive pages with the same kind and flags: the virtual address
+#       of the first page, the number of pages, the ELF program header flags, and the kind (8 + 4 + 1 + 1 + 2 bytes).
+#     - the v2 access right table of the patched ELF file, at an 8-byte aligned offset.
+#     - the contents of the pages of the data and shared runs in the order of the runs, starting at a page-aligned offset.
+# The pages of zero runs only hold 0-initialized bytes, so their contents are not part of the image.
+MAGIC = 0x49475053 # "SPGI" in little-endian.
+HEADER_FORMAT = "<IIQIIQ"
+RUN_FORMAT = "<QIBBH"
+KIND_DATA = 0
+KIND_ZERO = 1
+KIND_SHARED = 2
+PAGE_SIZE = 0x1000
+
+# The parts of ELF files and access right tables required to build a paged image.
+ELF_MAGIC = b"\x7fELF"
+PT_LOAD = 1
+P_FLAGS_WRITABLE = 2
+EI_ACCESS_RIGHT_TABLE_OFFSET_IDX = 9
+ACCESS_RIGHT_TABLE_MAGIC = 0x54524153 # "SART" in little-endian.
+ACCESS_RIGHT_TABLE_HEADER_FORMAT = "<IHHII"
+ACCESS_RIGHT_INDEX_ENTRY_FORMAT = "<II"
+LOADER_SYMBOLS_ID = 6
+IMAGE_HASH_ID = 7
+
+
+def align(n: int, alignment: int) -> int:
+    return (n + alignment - 1) & ~(alignment - 1)
+
+
+def get_access_right_table(elf: bytes) -> bytes:
+    """
+        Returns the v2 access right table the given ELF file has been patched with.
+    """
+    offset = int.from_bytes(elf[EI_ACCESS_RIGHT_TABLE_OFFSET_IDX:EI_ACCESS_RIGHT_TABLE_OFFSET_IDX + 7], "little")
+    if offset == 0 or offset + struct.calcsize(ACCESS_RIGHT_TABLE_HEADER_FORMAT) > len(elf):
+        raise ValueError("the ELF file has not been patched with access rights")
+    magic, _, _, _, size = struct.unpack_from(ACCESS_RIGHT_TABLE_HEADER_FORMAT, elf, offset)
+    if magic != ACCESS_RIGHT_TABLE_MAGIC or offset + size > len(elf):
+        raise ValueError("the ELF file has not been patched with a v2 access right table")
+    return elf[offset:offset + size]
+
+
+def get_access_right(table: bytes, type_id: int, value_format: str) -> tuple | None:
+    """
+        Returns the values of the only access right of the given type in the given access right table,
+        which follow the type id and the size of the access right, or None if there is no such access right.
+    """
+    _, _, num_types, _, _ = struct.unpack_from(ACCESS_RIGHT_TABLE_HEADER_FORMAT, table)
+    if type_id >= num_types:
+        return None
+    index_offset = struct.calcsize(ACCESS_RIGHT_TABLE_HEADER_FORMAT) + type_id * struct.calcsize(ACCESS_RIGHT_INDEX_ENTRY_FORMAT)
+    offset, num_access_rights = struct.unpack_from(ACCESS_RIGHT_INDEX_ENTRY_FORMAT, table, index_offset)
+    if num_access_rights == 0:
+        return None
+    return struct.unpack_from("<II" + value_format[1:], table, offset)[2:]
+
+
+def get_loadable_segments(elf: bytes) -> list[tuple[int, int, bytes, int]]:
+    """
+        Returns the flags, the virtual address, the bytes in the ELF file, and the size in memory
+        of each loadable segment of the given ELF file, in the order of their virtual addresses.
+    """
+    if elf[:4] != ELF_MAGIC:
+        raise ValueError("not an ELF file")
+    phoff, = struct.unpack_from("<Q", elf, 0x20)
+    phentsize, phnum = struct.unpack_from("<HH", elf, 0x36)
+    segments = []
+    for i in range(phnum):
+        p_type, p_flags, p_offset, p_vaddr, _, p_filesz, p_memsz, _ = struct.unpack_from("<IIQQQQQQ", elf, phoff + i * phentsize)
+        if p_type == PT_LOAD and p_memsz != 0:
+            segments.append((p_flags, p_vaddr, elf[p_offset:p_offset + p_filesz], p_memsz))
+    return sorted(segments, key=lambda segment: segment[1])
+
+
+def get_pages(elf: bytes, table: bytes) -> list[tuple[int, int, int, bytes]]:
+    """
+        Splits the loadable segments of the given ELF file, which has been patched with the given
+        access right table, into pages, returning the virtual address, the flags, the kind, 
+        and the contents of each page in the order of their virtual addresses.
+    """
+    loader_symbols = get_access_right(table, LOADER_SYMBOLS_ID, "<QQ")
+    if loader_symbols is None:
+        raise ValueError("the access right table has no loader symbols access right")
+    _, pd_id_vaddr = loader_symbols
+    has_image_hash = get_access_right(table, IMAGE_HASH_ID, "<Q") is not None
+
+    pages: list[tuple[int, int, int, bytes]] = []
+    for p_flags, p_vaddr, contents, p_memsz in get_loadable_segments(elf):
+        first_page = p_vaddr & ~(PAGE_SIZE - 1)
+        end = align(p_vaddr + p_memsz, PAGE_SIZE)
+        if len(pages) != 0 and pages[-1][0] >= first_page:
+            raise ValueError(f"the segment at {p_vaddr:#x} shares a page with the previous segment")
+
+        # The pages of read-only segments are shared like in the ELF loader, apart from the page with the PD id variable.
+        shared = has_image_hash and not p_flags & P_FLAGS_WRITABLE and not first_page <= pd_id_vaddr < end
+        memory = bytes(p_vaddr - first_page) + contents
+        memory += bytes(end - first_page - len(memory))
+        for vaddr in range(first_page, end, PAGE_SIZE):
+            page = memory[vaddr - first_page:vaddr - first_page + PAGE_SIZE]
+            kind = KIND_SHARED if shared else KIND_DATA if any(page) else KIND_ZERO
+            pages.append((vaddr, p_flags, kind, page))
+    return pages
+
+
+def get_elf_pages(elf: bytes) -> dict[int, bytes]:
+    """
+        Returns the contents of each page of the loadable segments of the given ELF file, 
+        as the ELF loader would load them.
+    """
+    pages = {}
+    for _, p_vaddr, contents, p_memsz in get_loadable_segments(elf):
+        first_page = p_vaddr & ~(PAGE_SIZE - 1)
+        memory = bytes(p_vaddr - first_page) + contents
+        memory += bytes(align(p_vaddr + p_memsz, PAGE_SIZE) - first_page - len(memory))
+        for i in range(0, len(memory), PAGE_SIZE):
+            pages[first_page + i] = memory[i:i + PAGE_SIZE]
+    return pages
+
+
+def build_paged_image(elf: bytes) -> bytes:
+    """
+        Builds a paged image of the given ELF file, which must have been patched with
+        a v2 access right table including the loader symbols access right.
+    """
+    table = get_access_right_table(elf)
+    pages = get_pages(elf, table)
+
+    # Merge consecutive pages with the same flags and kind into runs.
+    runs: list[list[int]] = []
+    data = bytearray()
+    for vaddr, p_flags, kind, page in pages:
+        if len(runs) != 0 and runs[-1][0] + runs[-1][1] * PAGE_SIZE == vaddr and runs[-1][2:] == [p_flags, kind]:
+            runs[-1][1] += 1
+        else:
+            runs.append([vaddr, 1, p_flags, kind])
+        if kind != KIND_ZERO:
+            data += page
+
+    entry_point, = struct.unpack_from("<Q", elf, 0x18)
+    access_rights_offset = align(struct.calcsize(HEADER_FORMAT) + len(runs) * struct.calcsize(RUN_FORMAT), 8)
+    data_offset = align(access_rights_offset + len(table), PAGE_SIZE)
+    image = bytearray(struct.pack(HEADER_FORMAT, MAGIC, len(runs), entry_point, access_rights_offset, len(table), data_offset))
+    for vaddr, num_pages, p_flags, kind in runs:
+        image += struct.pack(RUN_FORMAT, vaddr, num_pages, p_flags, kind, 0)
+    image += bytes(access_rights_offset - len(image)) + table
+    image += bytes(data_offset - len(image)) + data
+    return bytes(image)
+
+
+def load_paged_image(image: bytes) -> dict[int, bytes]:
+    """
+        Returns the contents of each page of the given paged image, mirroring the loader.
+    """
+    magic, num_runs, _, _, _, data_offset = struct.unpack_from(HEADER_FORMAT, image)
+    if magic != MAGIC:
+        raise ValueError("not a paged image")
+    pages = {}
+    offset = data_offset
+    for i in range(num_runs):
+        vaddr, num_pages, _, kind, _ = struct.unpack_from(RUN_FORMAT, image, struct.calcsize(HEADER_FORMAT) + i * struct.calcsize(RUN_FORMAT))
+        for j in range(num_pages):
+            if kind == KIND_ZERO:
+                pages[vaddr + j * PAGE_SIZE] = bytes(PAGE_SIZE)
+            else:
+                pages[vaddr + j * PAGE_SIZE] = image[offset:offset + PAGE_SIZE]
+                offset += PAGE_SIZE
+    if offset != len(image):
+        raise ValueError("the size of the paged image does not match its runs")
+    return pages
+
+
+def page_program():
+    if len(sys.argv) != 3:
+        sys.exit("Usage: python3 page_program.py <patched-ELF-file> <output-file>")
+
+    elf = Path(sys.argv[1]).read_bytes()
+    try:
+        image = build_paged_image(elf)
+    except ValueError as error:
+        sys.exit(f"Failed to build a paged image of {sys.argv[1]}: {error}")
+
+    # Check the image against the loadable segments of the ELF file, as the ELF loader would load them.
+    expected = get_elf_pages(elf)
+    if load_paged_image(image) != expected:
+        sys.exit("Failed to build a paged image matching the ELF file")
+
+    Path(sys.argv[2]).write_bytes(image)
+    num_pages = len(expected)
+    num_stored_pages = (len(image) - struct.unpack_from(HEADER_FORMAT, image)[5]) // PAGE_SIZE
+    print(f"Paged {len(elf)} bytes into {len(image)} bytes ({num_stored_pages} of {num_pages} pages stored)")
+
+
+if __name__ == "__main__":
+    page_program()
@@ -0,0 +1,176 @@
+import struct
+import sys
+from pathlib import Path
+
+from page_program import (PAGE_SIZE, KIND_DATA, KIND_ZERO, KIND_SHARED, LOADER_SYMBOLS_ID, ACCESS_RIGHT_TABLE_HEADER_FORMAT,
+                          ACCESS_RIGHT_INDEX_ENTRY_FORMAT, align, get_access_right_table, get_access_right, get_pages, get_elf_pages)
+
+# The load plan format understood by `sel4cp.h`, whose operations load a program when they are executed in order:
+#     - a header: the magic number, the number of operations, the entry point, the offset and the size of
+#       the access right table, the offset of the contents of the pages, and the number of page upper directories,
+#       page directories, page tables, and pages the operations take from the pools (4 + 4 + 8 + 4 + 4 + 8 + 4 * 4 bytes).
+#     - the operations: the type, the ELF program header flags, the number of pages, an argument,
+#       and a virtual address (1 + 1 + 2 + 4 + 8 bytes).
+#     - the v2 access right table of the patched ELF file, at an 8-byte aligned offset.
+#     - the contents of the pages of the data and shared operations, starting at a page-aligned offset.
+MAGIC = 0x4e4c5053 # "SPLN" in little-endian.
+HEADER_FORMAT = "<IIQIIQIIII"
+OP_FORMAT = "<BBHIQ"
+OP_MAP_PAGE_UPPER_DIRECTORY = 0
+OP_MAP_PAGE_DIRECTORY = 1
+OP_MAP_PAGE_TABLE = 2
+OP_MAP_DATA_PAGES = 3
+OP_MAP_ZERO_PAGES = 4
+OP_MAP_SHARED_PAGES = 5
+OP_WRITE_PD_ID = 6
+OP_SET_IPC_BUFFER = 7
+OP_SET_UP_ACCESS_RIGHT = 8
+MAX_PAGES_PER_OP = 0xffff
+MAP_PAGES_OPS = {KIND_DATA: OP_MAP_DATA_PAGES, KIND_ZERO: OP_MAP_ZERO_PAGES, KIND_SHARED: OP_MAP_SHARED_PAGES}
+
+# The paging structures, with the number of bits of the virtual addresses each of them covers.
+PAGING_STRUCTURES = ((OP_MAP_PAGE_UPPER_DIRECTORY, 12 + 9 + 9 + 9), (OP_MAP_PAGE_DIRECTORY, 12 + 9 + 9), (OP_MAP_PAGE_TABLE, 12 + 9))
+
+# The access rights that are set up once the pages have been loaded, and the memory regions among them.
+SET_UP_ACCESS_RIGHT_IDS = (0, 1, 2, 3, 5)
+MEMORY_REGION_ID = 2
+LARGE_PAGE_MEMORY_REGION_ID = 5
+MEMORY_REGION_FORMAT = "<IIQQQ"
+
+
+def get_access_right_offsets(table: bytes, type_id: int) -> list[int]:
+    """
+        Returns the offset of each access right of the given type in the given access right table.
+    """
+    _, _, num_types, _, _ = struct.unpack_from(ACCESS_RIGHT_TABLE_HEADER_FORMAT, table)
+    if type_id >= num_types:
+        return []
+    index_offset = struct.calcsize(ACCESS_RIGHT_TABLE_HEADER_FORMAT) + type_id * struct.calcsize(ACCESS_RIGHT_INDEX_ENTRY_FORMAT)
+    offset, num_access_rights = struct.unpack_from(ACCESS_RIGHT_INDEX_ENTRY_FORMAT, table, index_offset)
+    offsets = []
+    for _ in range(num_access_rights):
+        offsets.append(offset)
+        offset += struct.unpack_from("<II", table, offset)[1]
+    return offsets
+
+
+def compile_load_plan(elf: bytes) -> bytes:
+    """
+        Compiles a load plan of the given ELF file, which must have been patched with
+        a v2 access right table including the loader symbols access right.
+    """
+    table = get_access_right_table(elf)
+    pages = get_pages(elf, table)
+    ipc_buffer_vaddr, pd_id_vaddr = get_access_right(table, LOADER_SYMBOLS_ID, "<QQ")
+
+    # Map every paging structure exactly once, before the first page that requires it.
+    ops: list[list[int]] = []
+    mapped: set[tuple[int, int]] = set()
+    def map_paging_structures(vaddr: int, large_page: bool):
+        for op_type, num_bits in PAGING_STRUCTURES[:2 if large_page else 3]:
+            structure = (num_bits, vaddr & ~((1 << num_bits) - 1))
+            if structure not in mapped:
+                mapped.add(structure)
+                ops.append([op_type, 0, 0, 0, structure[1]])
+
+    memory_regions: list[tuple[int, int, bool]] = []
+    for type_id in (MEMORY_REGION_ID, LARGE_PAGE_MEMORY_REGION_ID):
+        for offset in get_access_right_offsets(table, type_id):
+            _, _, _, vaddr, size = struct.unpack_from(MEMORY_REGION_FORMAT, table, offset)
+            memory_regions.append((vaddr, size, type_id == LARGE_PAGE_MEMORY_REGION_ID))
+    for vaddr, _, _, _ in pages:
+        map_paging_structures(vaddr, False)
+    map_paging_structures(ipc_buffer_vaddr, False)
+    for vaddr, size, large_pages in memory_regions:
+        page_size = 0x200000 if large_pages else PAGE_SIZE
+        for page_vaddr in range(vaddr, vaddr + size, page_size):
+            map_paging_structures(page_vaddr, large_pages)
+
+    # Map the pages, merging consecutive pages with the same flags and kind into one operation.
+    data = bytearray()
+    for vaddr, p_flags, kind, page in pages:
+        prev_op = ops[-1]
+        if prev_op[0] == MAP_PAGES_OPS[kind] and prev_op[1] == p_flags and prev_op[2] < MAX_PAGES_PER_OP and \
+           prev_op[4] + prev_op[2] * PAGE_SIZE == vaddr:
+            prev_op[2] += 1
+        else:
+            ops.append([MAP_PAGES_OPS[kind], p_flags, 1, len(data) // PAGE_SIZE, vaddr])
+        if kind != KIND_ZERO:
+            data += page
+
+    # The PD id is written into the pages mapped by the operation just before.
+    for i, (op_type, _, num_pages, _, vaddr) in enumerate(ops):
+        if op_type in (OP_MAP_DATA_PAGES, OP_MAP_ZERO_PAGES) and vaddr <= pd_id_vaddr < vaddr + num_pages * PAGE_SIZE:
+            ops.insert(i + 1, [OP_WRITE_PD_ID, 0, 0, 0, pd_id_vaddr])
+            break
+    else:
+        raise ValueError("the PD id variable is not part of a page that is not shared")
+
+    ops.append([OP_SET_IPC_BUFFER, 0, 0, 0, ipc_buffer_vaddr])
+    access_right_offsets = sorted(offset for type_id in SET_UP_ACCESS_RIGHT_IDS for offset in get_access_right_offsets(table, type_id))
+    for offset in access_right_offsets:
+        ops.append([OP_SET_UP_ACCESS_RIGHT, 0, 0, offset, 0])
+
+    # The totals of the objects taken from the pools, which include the IPC buffer page.
+    num_structures = [sum(1 for op in ops if op[0] == op_type) for op_type, _ in PAGING_STRUCTURES]
+    num_pages = sum(op[2] for op in ops if op[0] in MAP_PAGES_OPS.values()) + 1
+
+    entry_point, = struct.unpack_from("<Q", elf, 0x18)
+    access_rights_offset = align(struct.calcsize(HEADER_FORMAT) + len(ops) * struct.calcsize(OP_FORMAT), 8)
+    data_offset = align(access_rights_offset + len(table), PAGE_SIZE)
+    plan = bytearray(struct.pack(HEADER_FORMAT, MAGIC, len(ops), entry_point, access_rights_offset, len(table), data_offset, *num_structures, num_pages))
+    for op_type, p_flags, num_pages, arg, vaddr in ops:
+        plan += struct.pack(OP_FORMAT, op_type, p_flags, num_pages, arg, vaddr)
+    plan += bytes(access_rights_offset - len(plan)) + table
+    plan += bytes(data_offset - len(plan)) + data
+    return bytes(plan)
+
+
+def execute_load_plan(plan: bytes) -> dict[int, bytes]:
+    """
+        Returns the contents of each page mapped by the given load plan, mirroring the loader,
+        which requires the paging structures of a page to be mapped by preceding operations.
+    """
+    magic, num_ops, _, _, _, data_offset, _, _, _, _ = struct.unpack_from(HEADER_FORMAT, plan)
+    if magic != MAGIC:
+        raise ValueError("not a load plan")
+    pages = {}
+    mapped = set()
+    for i in range(num_ops):
+        op_type, _, num_pages, arg, vaddr = struct.unpack_from(OP_FORMAT, plan, struct.calcsize(HEADER_FORMAT) + i * struct.calcsize(OP_FORMAT))
+        if op_type < len(PAGING_STRUCTURES):
+            mapped.add((PAGING_STRUCTURES[op_type][1], vaddr))
+        elif op_type in MAP_PAGES_OPS.values():
+            for j in range(num_pages):
+                page_vaddr = vaddr + j * PAGE_SIZE
+                if any((num_bits, page_vaddr & ~((1 << num_bits) - 1)) not in mapped for _, num_bits in PAGING_STRUCTURES):
+                    raise ValueError(f"the paging structures of the page at {page_vaddr:#x} are not mapped")
+                if op_type == OP_MAP_ZERO_PAGES:
+                    pages[page_vaddr] = bytes(PAGE_SIZE)
+                else:
+                    offset = data_offset + (arg + j) * PAGE_SIZE
+                    pages[page_vaddr] = plan[offset:offset + PAGE_SIZE]
+    return pages
+
+
+def plan_program():
+    if len(sys.argv) != 3:
+        sys.exit("Usage: python3 plan_program.py <patched-ELF-file> <output-file>")
+
+    elf = Path(sys.argv[1]).read_bytes()
+    try:
+        plan = compile_load_plan(elf)
+        # Check the plan against the loadable segments of the ELF file, as the ELF loader would load them.
+        if execute_load_plan(plan) != get_elf_pages(elf):
+            raise ValueError("the pages mapped by the load plan do not match the ELF file")
+    except ValueError as error:
+        sys.exit(f"Failed to compile a load plan of {sys.argv[1]}: {error}")
+
+    Path(sys.argv[2]).write_bytes(plan)
+    _, num_ops, _, _, _, _, num_page_upper_directories, num_page_directories, num_page_tables, num_pages = struct.unpack_from(HEADER_FORMAT, plan)
+    print(f"Compiled {len(elf)} bytes into a load plan of {len(plan)} bytes ({num_ops} operations taking "
+          f"{num_page_upper_directories + num_page_directories + num_page_tables} paging structures and {num_pages} pages)")
+
+
+if __name__ == "__main__":
+    plan_program()
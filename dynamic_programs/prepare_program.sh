@@ -15,9 +15,23 @@ if [ ! $(echo $PATH | grep -E "(^|:)$LOCAL_PATH($|:)") ]
         export PATH=$PATH:$LOCAL_PATH
 fi
 
-# Ensure that the sel4cp_set_up_access_rights utility is installed.
-pip3 install -q $BASE_PATH/protection_model-1.0.0-py2.py3-none-any.whl 
+# Ensure that the sel4cp_set_up_access_rights utility is installed from the current wheel,
+# which is built from the source in protection_model with a new version number whenever it changes.
+pip3 install -q --no-deps $BASE_PATH/protection_model-1.0.4-py2.py3-none-any.whl 
 
 
 cp $BASE_PATH/build/$2 $BASE_PATH/dynamic_programs/$2
 sel4cp_set_up_access_rights $BASE_PATH/dynamic_programs/$2 $1 $BASE_PATH/dynamic_programs/$3
+
+# Produce a compressed container of the patched ELF file, which loads faster over the character device.
+python3 $BASE_PATH/dynamic_programs/compress_program.py $BASE_PATH/dynamic_programs/$2 $BASE_PATH/dynamic_programs/$2.lz
+
+# Produce a paged image of the patched ELF file, which leaves out the contents of 0-initialized pages,
+# and a compressed container of the paged image.
+python3 $BASE_PATH/dynamic_programs/page_program.py $BASE_PATH/dynamic_programs/$2 $BASE_PATH/dynamic_programs/$2.img
+python3 $BASE_PATH/dynamic_programs/compress_program.py $BASE_PATH/dynamic_programs/$2.img $BASE_PATH/dynamic_programs/$2.img.lz
+
+# Produce a load plan of the patched ELF file, whose operations the loading PD executes without making any decisions itself,
+# and a compressed container of the load plan.
+python3 $BASE_PATH/dynamic_programs/plan_program.py $BASE_PATH/dynamic_programs/$2 $BASE_PATH/dynamic_programs/$2.plan
+python3 $BASE_PATH/dynamic_programs/compress_program.py $BASE_PATH/dynamic_programs/$2.plan $BASE_PATH/dynamic_programs/$2.plan.lz
@@ -0,0 +1,224 @@
+import os
+import random
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+import zlib
+from pathlib import Path
+
+# The upload protocol implemented by `elf_loader.h`.
+MAGIC = 0x52444c53 # "SLDR" in little-endian.
+CACHED_MAGIC = 0x43444c53 # "SLDC" in little-endian.
+VERSION = 1
+FRAME_SYNC = bytes([0xa5, 0x5a])
+FRAME_SIZE = 256
+REPLY_SIZE = 6
+REPLY_ACK = ord("A")
+REPLY_NAK = ord("N")
+REPLY_ERROR = ord("E")
+REPLY_MISS = ord("M")
+
+DEFAULT_WINDOW_SIZE = 16 # the maximum number of unacknowledged frames in flight.
+RETRANSMISSION_TIMEOUT = 1.0 # seconds without progress before all unacknowledged frames are retransmitted.
+MAX_RETRANSMISSIONS = 20
+OUTPUT_ECHO_DURATION = 1.0 # seconds to keep echoing the output of the system after an upload.
+
+
+def build_header(magic: int, image: bytes, target_pd: int, upload_id: int) -> bytes:
+    """
+        Builds the upload header for the given image.
+    """
+    return struct.pack("<IBBHIIQ", magic, VERSION, target_pd, FRAME_SIZE, upload_id, zlib.crc32(image), len(image))
+
+
+def build_frames(image: bytes, target_pd: int) -> list[bytes]:
+    """
+        Splits the given image into the frames of a single upload.
+        Frame 0 carries the upload header, and the remaining frames carry the image.
+    """
+    upload_id = random.getrandbits(32)
+    header = build_header(MAGIC, image, target_pd, upload_id)
+
+    frames = [build_frame(0, header, b"")]
+    for offset in range(0, len(image), FRAME_SIZE):
+        seq = len(frames)
+        frames.append(build_frame(seq, image[offset:offset + FRAME_SIZE], struct.pack("<I", upload_id)))
+    return frames
+
+
+def build_frame(seq: int, payload: bytes, crc_prefix: bytes) -> bytes:
+    """
+        Builds a single frame with the given sequence number and payload.
+        The CRC-32 of the frame also covers the given crc_prefix, which is not transmitted.
+    """
+    body = struct.pack("<H", seq) + payload
+    return FRAME_SYNC + body + struct.pack("<I", zlib.crc32(crc_prefix + body))
+
+
+class ReplyParser:
+    """
+        Extracts replies from the output of the system.
+        All other output is passed through to stdout, as the loader
+        and the other PDs share the character device for their output.
+    """
+    def __init__(self):
+        self.pending = b""
+
+    def feed(self, data: bytes) -> list[tuple[int, int]]:
+        self.pending += data
+        replies = []
+        while True:
+            idx = self.pending.find(FRAME_SYNC)
+            if idx == -1:
+                # Keep a trailing first sync byte, as the reply may be split across reads.
+                keep = 1 if self.pending.endswith(FRAME_SYNC[:1]) else 0
+                self.echo(self.pending[:len(self.pending) - keep])
+                self.pending = self.pending[len(self.pending) - keep:]
+                return replies
+
+            self.echo(self.pending[:idx])
+            self.pending = self.pending[idx:]
+            if len(self.pending) < REPLY_SIZE:
+                return replies
+
+            reply_type, seq_low, seq_high, check = self.pending[2:REPLY_SIZE]
+            if reply_type ^ seq_low ^ seq_high == check:
+                replies.append((reply_type, seq_low | (seq_high << 8)))
+                self.pending = self.pending[REPLY_SIZE:]
+            else:
+                self.echo(self.pending[:1])
+                self.pending = self.pending[1:]
+
+    def echo(self, data: bytes) -> None:
+        if data:
+            sys.stdout.write(data.decode("ascii", errors="replace"))
+            sys.stdout.flush()
+
+
+def send_frames(fd: int, frames: list[bytes], window_size: int) -> bool:
+    """
+        Sends the given frames with a sliding window (Go-Back-N), such that
+        up to window_size frames are in flight before an acknowledgement is required.
+        Returns True if all frames have been acknowledged.
+    """
+    parser = ReplyParser()
+    base = 0 # the first unacknowledged frame.
+    next_frame = 0 # the next frame to send.
+    last_progress = time.monotonic()
+    num_retransmissions = 0
+
+    while base < len(frames):
+        # Fill the window.
+        while next_frame < len(frames) and next_frame < base + window_size:
+            os.write(fd, frames[next_frame])
+            next_frame += 1
+
+        readable, _, _ = select.select([fd], [], [], 0.05)
+        if readable:
+            for reply_type, seq in parser.feed(os.read(fd, 4096)):
+                if reply_type == REPLY_ERROR:
+                    print(f"\nThe loader aborted the upload at frame {seq}")
+                    return False
+                if seq > base:
+                    base = seq
+                    last_progress = time.monotonic()
+                    num_retransmissions = 0
+                if reply_type == REPLY_NAK:
+                    next_frame = base
+                next_frame = max(next_frame, base)
+
+        if time.monotonic() - last_progress > RETRANSMISSION_TIMEOUT:
+            num_retransmissions += 1
+            if num_retransmissions > MAX_RETRANSMISSIONS:
+                print(f"\nNo response from the loader; giving up at frame {base}")
+                return False
+            next_frame = base
+            last_progress = time.monotonic()
+
+    return True
+
+
+def request_cached_load(fd: int, image: bytes, target_pd: int) -> bool:
+    """
+        Asks the loader to load the given image from its image cache, such that it does not have to be sent.
+        Returns True if the image has been loaded from the cache, and False if it must be uploaded.
+    """
+    parser = ReplyParser()
+    frame = build_frame(0, build_header(CACHED_MAGIC, image, target_pd, random.getrandbits(32)), b"")
+    for _ in range(MAX_RETRANSMISSIONS):
+        os.write(fd, frame)
+        deadline = time.monotonic() + RETRANSMISSION_TIMEOUT
+        while time.monotonic() < deadline:
+            readable, _, _ = select.select([fd], [], [], 0.05)
+            if not readable:
+                continue
+            for reply_type, seq in parser.feed(os.read(fd, 4096)):
+                if reply_type == REPLY_ACK and seq == 1:
+                    return True
+                if reply_type == REPLY_MISS:
+                    return False
+                if reply_type == REPLY_ERROR:
+                    sys.exit("\nThe loader rejected the request to load the cached image")
+
+    sys.exit("\nNo response from the loader")
+
+
+def echo_output(fd: int, duration: float) -> None:
+    """
+        Echoes the output of the system for the given duration,
+        such that the output of loading the program is shown.
+    """
+    parser = ReplyParser()
+    end = time.monotonic() + duration
+    while time.monotonic() < end:
+        readable, _, _ = select.select([fd], [], [], 0.05)
+        if readable:
+            parser.feed(os.read(fd, 4096))
+
+
+def send_program():
+    args = sys.argv[1:]
+    # With --cached, the loader is first asked to load the image from its image cache.
+    cached = len(args) > 0 and args[0] == "--cached"
+    if cached:
+        args = args[1:]
+    num_args = len(args)
+    if num_args < 2 or num_args > 4:
+        sys.exit(f"Usage: python3 send_program.py [--cached] <ELF-file> <target> [<pd-id>] [<window-size>]")
+
+    image = Path(args[0]).read_bytes()
+    target = args[1]
+    target_pd = int(args[2], 0) if num_args > 2 else 0
+    window_size = int(args[3], 0) if num_args > 3 else DEFAULT_WINDOW_SIZE
+
+    fd = os.open(target, os.O_RDWR | os.O_NOCTTY)
+    try:
+        if os.isatty(fd):
+            tty.setraw(fd)
+            termios.tcflush(fd, termios.TCIFLUSH)
+
+        if cached:
+            start = time.monotonic()
+            if request_cached_load(fd, image, target_pd):
+                print(f"\nLoaded the cached ELF file in {time.monotonic() - start:.2f} s")
+                echo_output(fd, OUTPUT_ECHO_DURATION)
+                return
+            print("\nThe ELF file is not cached")
+
+        frames = build_frames(image, target_pd)
+        print(f"Sending {len(image)} bytes in {len(frames)} frames")
+        start = time.monotonic()
+        if not send_frames(fd, frames, window_size):
+            sys.exit(1)
+        duration = time.monotonic() - start
+        print(f"\nSent ELF file in {duration:.2f} s ({len(image) / duration:.0f} bytes/s)")
+        echo_output(fd, OUTPUT_ECHO_DURATION)
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    send_program()
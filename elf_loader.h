@@ -1,92 +1,1091 @@
-#define ELF_BUFFER_SIZE 0x50000
+// The loadable segments of a received ELF file are streamed directly into the new PD,
+// so only the headers and the bytes following the loadable segments (section headers,
+// symbol table, debug information, access rights, ...) must fit in the metadata buffer.
+// For a bundle of ELF files, this applies to all ELF files of the bundle together.
+#define ELF_METADATA_BUFFER_SIZE 0x40000
 
-static uint8_t elf_buffer[ELF_BUFFER_SIZE];
-static uint8_t *elf_current_vaddr = elf_buffer;
+// Once the header of an upload has been received, the UART is busy-polled for the rest of the upload.
+// Polling stops, and the loader returns to waiting for interrupts, if no character is received for
+// ELF_LOADER_POLL_IDLE_TIMEOUT_US microseconds, or if the loader has polled continuously for
+// ELF_LOADER_POLL_SLICE_US microseconds. The latter must be kept well below the MCS budget of the
+// loading PD, such that the loader blocks on its notification before its budget is exhausted.
+#ifndef ELF_LOADER_ENABLE_POLLING
+#define ELF_LOADER_ENABLE_POLLING 1
+#endif
+#define ELF_LOADER_POLL_IDLE_TIMEOUT_US 200
+#define ELF_LOADER_POLL_SLICE_US 500
+
+// The number of bytes between progress reports while receiving an ELF file.
+#define ELF_LOADER_PROGRESS_INTERVAL 0x10000
+
+/*
+ *  The upload protocol.
+ *  See dynamic_programs/send_program.py for the sending side.
+ *
+ *  An upload is a sequence of frames, each laid out as follows:
+ *      - 2 bytes: the sync marker ELF_LOADER_FRAME_SYNC_0, ELF_LOADER_FRAME_SYNC_1.
+ *      - 2 bytes: the sequence number of the frame in little-endian.
+ *      - n bytes: the payload of the frame.
+ *      - 4 bytes: the CRC-32 of the frame in little-endian.
+ *  Frame 0 carries an elf_loader_upload_header, and its CRC-32 covers the sequence number and the payload.
+ *  Frame i > 0 carries bytes [(i - 1) * ELF_LOADER_FRAME_SIZE, i * ELF_LOADER_FRAME_SIZE) of the image,
+ *  and its CRC-32 covers the upload id, the sequence number and the payload, 
+ *  such that stale frames from another upload are rejected.
+ *
+ *  Every frame is answered with a reply, laid out as follows:
+ *      - 2 bytes: the sync marker.
+ *      - 1 byte: the reply type; ELF_LOADER_REPLY_ACK, ELF_LOADER_REPLY_NAK or ELF_LOADER_REPLY_ERROR.
+ *      - 2 bytes: a sequence number in little-endian.
+ *      - 1 byte: the XOR of the three preceding bytes.
+ *  An ACK carries the sequence number of the next expected frame, acknowledging all frames before it.
+ *  A NAK carries the sequence number of the next expected frame, from which the sender must retransmit.
+ *  An ERROR aborts the upload.
+ *
+ *  A header frame with ELF_LOADER_CACHED_MAGIC instead of ELF_LOADER_MAGIC requests loading the image 
+ *  with the given image_crc32 and image_size from the image cache, without sending it again.
+ *  No data frames follow. The request is answered with an ACK carrying sequence number 1 if the image 
+ *  is cached, or with ELF_LOADER_REPLY_MISS if it is not, in which case the image must be uploaded.
+ */
+#define ELF_LOADER_MAGIC 0x52444c53 // "SLDR" in little-endian.
+#define ELF_LOADER_CACHED_MAGIC 0x43444c53 // "SLDC" in little-endian.
+#define ELF_LOADER_VERSION 1
+#define ELF_LOADER_FRAME_SYNC_0 0xa5
+#define ELF_LOADER_FRAME_SYNC_1 0x5a
+#define ELF_LOADER_FRAME_SIZE 256 // the payload size of all data frames, except possibly the last one.
+#define ELF_LOADER_FRAME_OVERHEAD 6 // the number of bytes in a frame besides the sync marker and the payload.
+#define ELF_LOADER_REPLY_ACK 'A'
+#define ELF_LOADER_REPLY_NAK 'N'
+#define ELF_LOADER_REPLY_ERROR 'E'
+#define ELF_LOADER_REPLY_MISS 'M'
+
+/*
+ *  An image may be a compressed container produced by dynamic_programs/compress_program.py
+ *  rather than a plain ELF file. The container starts with a header of 16 bytes:
+ *      - 4 bytes: ELF_LOADER_COMPRESSED_MAGIC in little-endian.
+ *      - 4 bytes: the CRC-32 of the uncompressed ELF file in little-endian.
+ *      - 8 bytes: the size of the uncompressed ELF file in little-endian.
+ *  The header is followed by the LZSS-compressed ELF file, see lzss.h, 
+ *  which is decompressed while the frames arrive.
+ */
+#define ELF_LOADER_COMPRESSED_MAGIC 0x315a4c53 // "SLZ1" in little-endian.
+#define ELF_LOADER_COMPRESSED_HEADER_SIZE 16
+
+// The image cache keeps the most recently received images in a memory region of the loader,
+// see elf_loader_set_cache, such that they can be loaded again without being sent.
+// An image is identified by the CRC-32 and the size given in its upload header, and it is kept
+// after decompression. The region is split into ELF_LOADER_CACHE_NUM_SLOTS slots of equal size,
+// and the least recently used image is replaced when a new image is received.
+// Images larger than a slot are not cached.
+#define ELF_LOADER_CACHE_NUM_SLOTS 4
+
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t target_pd; // the id of the PD to load the image into; 0 selects the default PD of the loader.
+    uint16_t frame_size;
+    uint32_t upload_id; // chosen by the sender to distinguish retransmissions from new uploads.
+    uint32_t image_crc32;
+    uint64_t image_size;
+} elf_loader_upload_header;
+
+typedef struct {
+    bool valid;
+    uint32_t image_crc32;
+    uint64_t image_size; // the size of the image as uploaded.
+    uint64_t size; // the size of the image kept in the slot, i.e. after decompression.
+    uint64_t last_used; // the value of elf_cache_clock when the image was last received or loaded.
+} elf_loader_cache_entry;
+
+typedef enum {
+    ELF_LOADER_IN_PROGRESS, // no ELF file has been completed.
+    ELF_LOADER_PD_STARTED, // an ELF file has been loaded and started in a new PD.
+    ELF_LOADER_PD_FAILED // loading an ELF file into a new PD has failed.
+} elf_loader_result;
+
+typedef enum {
+    ELF_LOADER_WAITING_FOR_SYNC_0,
+    ELF_LOADER_WAITING_FOR_SYNC_1,
+    ELF_LOADER_RECEIVING_FRAME
+} elf_loader_frame_state;
+
+static uint8_t elf_metadata[ELF_METADATA_BUFFER_SIZE] __attribute__((aligned(8)));
 static uint64_t elf_size = 0;
+static sel4cp_pd elf_default_pd = 0;
+
+// The state of the current (or most recent) upload.
+static bool elf_receiving = false;
+static uint32_t elf_upload_id = 0;
+static uint32_t elf_image_crc32 = 0;
+static uint32_t elf_received_crc32 = 0; // the CRC-32 of the image bytes received so far.
+static uint8_t elf_target_pd = 0;
+static uint16_t elf_num_frames = 0;
+static uint16_t elf_expected_seq = 0;
+static bool elf_nak_sent = false;
+
+// The state of decompressing the current image, if it is a compressed container.
+static bool elf_compressed = false;
+static lzss_decoder elf_decoder;
+static uint8_t elf_decompressed[ELF_LOADER_FRAME_SIZE];
+static uint64_t elf_decompressed_size = 0;
+static uint32_t elf_decompressed_crc32 = 0;
+static uint32_t elf_decompressed_expected_crc32 = 0;
+
+// The ELF files of the current image, which is either a single ELF file or a bundle of ELF files,
+// see sel4cp_bundle_header. For a bundle, the manifest is collected before the first ELF file arrives.
+static sel4cp_elf_stream elf_streams[SEL4CP_BUNDLE_MAX_PROGRAMS];
+static uint64_t elf_num_streams = 0;
+static uint64_t elf_image_offset = 0; // the number of (decompressed) image bytes loaded so far.
+static bool elf_bundle = false;
+static bool elf_plan = false; // whether the current image is a load plan, which is executed from the image cache.
+static uint8_t elf_bundle_manifest[sizeof(sel4cp_bundle_header) + SEL4CP_BUNDLE_MAX_PROGRAMS * sizeof(sel4cp_bundle_entry)] __attribute__((aligned(8)));
+static uint32_t elf_bundle_crc32s[SEL4CP_BUNDLE_MAX_PROGRAMS];
+static uint64_t elf_bundle_metadata_used = 0; // the bytes of the metadata buffer used by completed ELF files.
+
+// The image cache, which is disabled as long as elf_cache is NULL.
+static uint8_t *elf_cache = NULL;
+static uint64_t elf_cache_slot_size = 0;
+static elf_loader_cache_entry elf_cache_entries[ELF_LOADER_CACHE_NUM_SLOTS];
+static uint64_t elf_cache_clock = 0;
+static uint64_t elf_cache_fill_slot = ELF_LOADER_CACHE_NUM_SLOTS; // the slot the current image is copied into, if any.
+static uint64_t elf_cache_hits = 0;
+static uint64_t elf_cache_misses = 0;
+
+// The frame currently being received, excluding the sync marker.
+static elf_loader_frame_state elf_frame_state = ELF_LOADER_WAITING_FOR_SYNC_0;
+static uint8_t elf_frame[ELF_LOADER_FRAME_SIZE + ELF_LOADER_FRAME_OVERHEAD] __attribute__((aligned(8)));
+static uint64_t elf_frame_idx = 0;
+static uint64_t elf_frame_payload_size = 0;
+
+// Statistics about the ELF file currently being received.
+static uint64_t elf_num_notifications = 0;
+static uint64_t elf_num_received_bytes = 0;
+static uint64_t elf_num_polled_bytes = 0;
+static uint64_t elf_polling_ticks = 0;
+static uint64_t elf_start_ticks = 0;
+
+/**
+ *  Sets the id of the PD that received images are loaded into
+ *  if the sender does not specify one.
+ */
+static void
+elf_loader_init(sel4cp_pd default_pd)
+{
+    elf_default_pd = default_pd;
+}
+
+/**
+ *  Enables the image cache in the given memory region of cache_size bytes,
+ *  which must be page-aligned, such that bundles can be loaded from the cache.
+ */
+static void
+elf_loader_set_cache(uint8_t *cache, uint64_t cache_size)
+{
+    elf_cache = cache;
+    elf_cache_slot_size = (cache_size / ELF_LOADER_CACHE_NUM_SLOTS) & ~((uint64_t)0xfff);
+    for (uint64_t i = 0; i < ELF_LOADER_CACHE_NUM_SLOTS; i++) {
+        elf_cache_entries[i].valid = false;
+    }
+}
+
+/**
+ *  Returns the id of the PD that the most recently received image is loaded into.
+ */
+static sel4cp_pd
+elf_loader_get_target_pd(void)
+{
+    return elf_target_pd != 0 ? elf_target_pd : elf_default_pd;
+}
+
+/**
+ *  Returns true if the given target PD id of an upload header, or the default PD id if it is 0,
+ *  can be the id of a new PD. Whether a PD with the id already exists is checked
+ *  when the PD is created, as the ELF files of a bundle are loaded into the PDs given by its manifest.
+ */
+static bool
+elf_loader_is_valid_target_pd(uint8_t target_pd)
+{
+    sel4cp_pd pd = target_pd != 0 ? target_pd : elf_default_pd;
+    return pd <= SEL4CP_MAX_PDS && pd != sel4cp_current_pd_id;
+}
+
+/**
+ *  Returns the little-endian integer of the given number of bytes (at most 8) at the given address.
+ */
+static uint64_t
+elf_loader_read_le(uint8_t *bytes, uint64_t num_bytes)
+{
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < num_bytes; i++) {
+        value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+/**
+ *  Returns the value of the timer when the header of the most recent upload was received.
+ */
+static uint64_t
+elf_loader_get_start_ticks(void)
+{
+    return elf_start_ticks;
+}
+
+/**
+ *  Sends a reply of the given type carrying the given sequence number to the sender.
+ *  The reply is transmitted ahead of the queued output, see uart_put_reply, such that it is 
+ *  neither dropped when the transmit buffer is full nor split by other output.
+ */
+static void
+elf_loader_reply(uint8_t type, uint16_t seq)
+{
+    uint8_t seq_low = seq & 0xff;
+    uint8_t seq_high = seq >> 8;
+    uint8_t reply[6] = { ELF_LOADER_FRAME_SYNC_0, ELF_LOADER_FRAME_SYNC_1, type, seq_low, seq_high, type ^ seq_low ^ seq_high };
+    uart_put_reply(reply, sizeof(reply));
+}
+
+/**
+ *  Requests a retransmission from the next expected frame,
+ *  unless this has already been requested since the last frame was accepted.
+ */
+static void
+elf_loader_request_retransmission(void)
+{
+    if (!elf_nak_sent) {
+        elf_loader_reply(ELF_LOADER_REPLY_NAK, elf_expected_seq);
+        elf_nak_sent = true;
+    }
+}
+
+/**
+ *  Returns the number of payload bytes in the frame with the given sequence number,
+ *  or 0 if no such frame is part of the current (or most recent) upload.
+ */
+static uint64_t
+elf_loader_get_payload_size(uint16_t seq)
+{
+    if (seq == 0) {
+        return sizeof(elf_loader_upload_header);
+    }
+    if (seq >= elf_num_frames) {
+        return 0;
+    }
+    
+    uint64_t offset = (uint64_t)(seq - 1) * ELF_LOADER_FRAME_SIZE;
+    uint64_t remaining = elf_size - offset;
+    return remaining < ELF_LOADER_FRAME_SIZE ? remaining : ELF_LOADER_FRAME_SIZE;
+}
+
+/**
+ *  Returns the slot of the cached image with the given CRC-32 and size as uploaded,
+ *  or ELF_LOADER_CACHE_NUM_SLOTS if the image is not cached.
+ */
+static uint64_t
+elf_loader_find_cached_image(uint32_t image_crc32, uint64_t image_size)
+{
+    for (uint64_t i = 0; i < ELF_LOADER_CACHE_NUM_SLOTS; i++) {
+        elf_loader_cache_entry *entry = &elf_cache_entries[i];
+        if (entry->valid && entry->image_crc32 == image_crc32 && entry->image_size == image_size) {
+            return i;
+        }
+    }
+    return ELF_LOADER_CACHE_NUM_SLOTS;
+}
+
+/**
+ *  Selects the slot of the image cache that the image of the upload with the given header
+ *  is copied into while it arrives: the slot of the same image if it is cached already,
+ *  an empty slot, or the slot of the least recently used image, in that order.
+ */
+static void
+elf_loader_start_cache_fill(elf_loader_upload_header *header)
+{
+    elf_cache_fill_slot = ELF_LOADER_CACHE_NUM_SLOTS;
+    if (elf_cache == NULL || header->image_size > elf_cache_slot_size) {
+        return;
+    }
+    
+    uint64_t slot = elf_loader_find_cached_image(header->image_crc32, header->image_size);
+    for (uint64_t i = 0; i < ELF_LOADER_CACHE_NUM_SLOTS && slot == ELF_LOADER_CACHE_NUM_SLOTS; i++) {
+        if (!elf_cache_entries[i].valid) {
+            slot = i;
+        }
+    }
+    if (slot == ELF_LOADER_CACHE_NUM_SLOTS) {
+        slot = 0;
+        for (uint64_t i = 1; i < ELF_LOADER_CACHE_NUM_SLOTS; i++) {
+            if (elf_cache_entries[i].last_used < elf_cache_entries[slot].last_used) {
+                slot = i;
+            }
+        }
+    }
+    
+    elf_cache_entries[slot].valid = false;
+    elf_cache_fill_slot = slot;
+}
+
+/**
+ *  Copies the given bytes at the given offset in the current image after decompression
+ *  into the slot selected by elf_loader_start_cache_fill. 
+ *  The image is not cached if it does not fit in the slot.
+ */
+static void
+elf_loader_fill_cache(uint64_t offset, uint8_t *data, uint64_t len)
+{
+    if (elf_cache_fill_slot == ELF_LOADER_CACHE_NUM_SLOTS) {
+        return;
+    }
+    if (len > elf_cache_slot_size - offset) {
+        elf_cache_fill_slot = ELF_LOADER_CACHE_NUM_SLOTS;
+        return;
+    }
+    
+    uint8_t *dst = elf_cache + elf_cache_fill_slot * elf_cache_slot_size + offset;
+    for (uint64_t i = 0; i < len; i++) {
+        dst[i] = data[i];
+    }
+}
+
+/**
+ *  Marks the image copied into the image cache as cached, once the whole image
+ *  of the upload with the given CRC-32 and size has been received and verified.
+ */
+static void
+elf_loader_finish_cache_fill(uint32_t image_crc32, uint64_t image_size, uint64_t size)
+{
+    if (elf_cache_fill_slot == ELF_LOADER_CACHE_NUM_SLOTS) {
+        return;
+    }
+    
+    elf_loader_cache_entry *entry = &elf_cache_entries[elf_cache_fill_slot];
+    entry->valid = true;
+    entry->image_crc32 = image_crc32;
+    entry->image_size = image_size;
+    entry->size = size;
+    entry->last_used = ++elf_cache_clock;
+    elf_cache_fill_slot = ELF_LOADER_CACHE_NUM_SLOTS;
+}
+
+/**
+ *  Prints the number of requests to load a cached image that have hit and missed the image cache so far.
+ */
+static void
+elf_loader_print_cache_statistics(void)
+{
+    if (elf_cache == NULL) {
+        return;
+    }
+    
+    uart_put_str("elf_loader: image cache: ");
+    uart_put_hex64(elf_cache_hits);
+    uart_put_str(" hits, ");
+    uart_put_hex64(elf_cache_misses);
+    uart_put_str(" misses\n");
+}
+
+/**
+ *  Returns true if the PD of the given stream has been created by the current upload.
+ *  sel4cp_pd_stream_init rejects the ids of existing PDs, and a stream only takes objects
+ *  from the pools once it has received bytes, so any other PD with the same id is left alone.
+ */
+static bool
+elf_loader_is_streamed_pd(sel4cp_elf_stream *stream)
+{
+    return stream->num_received != 0;
+}
+
+/**
+ *  Destroys the PDs created by the streams of the current image, see elf_loader_is_streamed_pd,
+ *  such that the objects taken from the pools for them can be used again.
+ */
+static void
+elf_loader_destroy_streamed_pds(void)
+{
+    // Transmit any queued output before the debug output of sel4cp_pd_destroy.
+    uart_tx_drain();
+    for (uint64_t i = 0; i < elf_num_streams; i++) {
+        if (elf_loader_is_streamed_pd(&elf_streams[i])) {
+            sel4cp_pd_destroy(elf_streams[i].pd);
+        }
+    }
+    elf_num_streams = 0;
+}
+
+/**
+ *  Handles a request to load the cached image given by the given header, see ELF_LOADER_CACHED_MAGIC.
+ *  A single ELF file is loaded into the PD given by elf_loader_get_target_pd, 
+ *  and the ELF files of a bundle are loaded into the PDs given by its manifest.
+ *
+ *  Returns ELF_LOADER_PD_STARTED if the image is cached and all of its PDs have been started,
+ *  and ELF_LOADER_PD_FAILED if loading it has failed.
+ *  Returns ELF_LOADER_IN_PROGRESS if the image is not cached.
+ */
+static elf_loader_result
+elf_loader_load_cached_image(elf_loader_upload_header *header)
+{
+    uint64_t slot = elf_loader_find_cached_image(header->image_crc32, header->image_size);
+    if (slot == ELF_LOADER_CACHE_NUM_SLOTS) {
+        elf_cache_misses++;
+        uart_put_str("elf_loader: the requested image is not cached\n");
+        elf_loader_reply(ELF_LOADER_REPLY_MISS, 0);
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    if (elf_receiving) {
+        uart_put_str("elf_loader: loading a cached image replaces the unfinished upload\n");
+        elf_receiving = false;
+        elf_loader_destroy_streamed_pds();
+    }
+    
+    elf_loader_cache_entry *entry = &elf_cache_entries[slot];
+    entry->last_used = ++elf_cache_clock;
+    elf_cache_hits++;
+    elf_upload_id = header->upload_id;
+    elf_target_pd = header->target_pd;
+    elf_num_frames = 1;
+    elf_start_ticks = timer_get_ticks();
+    
+    uart_put_str("elf_loader: loading a cached image of ");
+    uart_put_hex64(entry->size);
+    uart_put_str(" bytes\n");
+    elf_loader_reply(ELF_LOADER_REPLY_ACK, elf_num_frames);
+    elf_loader_print_cache_statistics();
+    
+    // Transmit any queued output before a new PD may take over the UART IRQ.
+    uart_tx_drain();
+    
+    uint8_t *image = elf_cache + slot * elf_cache_slot_size;
+    if (entry->size >= 4 && elf_loader_read_le(image, 4) == SEL4CP_BUNDLE_MAGIC) {
+        sel4cp_bundle_header *bundle_header = (sel4cp_bundle_header *)image;
+        if (sel4cp_pd_create_bundle(image, entry->size) != (int)bundle_header->num_programs) {
+            return ELF_LOADER_PD_FAILED;
+        }
+        return ELF_LOADER_PD_STARTED;
+    }
+    if (entry->size >= 4 && elf_loader_read_le(image, 4) == SEL4CP_PAGED_IMAGE_MAGIC) {
+        if (sel4cp_pd_create_from_image(elf_loader_get_target_pd(), image, entry->size)) {
+            return ELF_LOADER_PD_FAILED;
+        }
+        return ELF_LOADER_PD_STARTED;
+    }
+    if (entry->size >= 4 && elf_loader_read_le(image, 4) == SEL4CP_LOAD_PLAN_MAGIC) {
+        if (sel4cp_pd_create_from_plan(elf_loader_get_target_pd(), image, entry->size)) {
+            return ELF_LOADER_PD_FAILED;
+        }
+        return ELF_LOADER_PD_STARTED;
+    }
+    if (sel4cp_pd_create(elf_loader_get_target_pd(), image, entry->size)) {
+        return ELF_LOADER_PD_FAILED;
+    }
+    return ELF_LOADER_PD_STARTED;
+}
+
+/**
+ *  Handles a received header frame with a valid CRC-32.
+ *
+ *  Returns the result of loading a cached image if the header requests one, see elf_loader_load_cached_image.
+ *  Otherwise, ELF_LOADER_IN_PROGRESS is returned.
+ */
+static elf_loader_result
+elf_loader_handle_header(elf_loader_upload_header *header)
+{
+    if (header->upload_id == elf_upload_id && elf_num_frames != 0) {
+        // A retransmission of the header of the current (or most recent) upload.
+        elf_loader_reply(ELF_LOADER_REPLY_ACK, elf_receiving ? elf_expected_seq : elf_num_frames);
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    if (!elf_loader_is_valid_target_pd(header->target_pd)) {
+        uart_put_str("elf_loader: received an upload header with an invalid target PD id\n");
+        elf_loader_reply(ELF_LOADER_REPLY_ERROR, 0);
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    if (header->magic == ELF_LOADER_CACHED_MAGIC && header->version == ELF_LOADER_VERSION) {
+        return elf_loader_load_cached_image(header);
+    }
+    
+    if (header->magic != ELF_LOADER_MAGIC || header->version != ELF_LOADER_VERSION || header->frame_size != ELF_LOADER_FRAME_SIZE) {
+        uart_put_str("elf_loader: received an upload header with an unsupported format\n");
+        elf_loader_reply(ELF_LOADER_REPLY_ERROR, 0);
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    uint64_t num_data_frames = (header->image_size + ELF_LOADER_FRAME_SIZE - 1) / ELF_LOADER_FRAME_SIZE;
+    if (header->image_size == 0 || num_data_frames >= 0xffff) {
+        uart_put_str("elf_loader: cannot read ELF files larger than ");
+        uart_put_hex64(0xfffe * ELF_LOADER_FRAME_SIZE);
+        uart_put_str(" bytes\n");
+        elf_loader_reply(ELF_LOADER_REPLY_ERROR, 0);
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    if (elf_receiving) {
+        uart_put_str("elf_loader: a new upload replaces the unfinished upload\n");
+        elf_loader_destroy_streamed_pds();
+    }
+    
+    elf_receiving = true;
+    elf_upload_id = header->upload_id;
+    elf_image_crc32 = header->image_crc32;
+    elf_target_pd = header->target_pd;
+    elf_size = header->image_size;
+    elf_received_crc32 = 0;
+    elf_num_frames = num_data_frames + 1;
+    elf_expected_seq = 1;
+    elf_nak_sent = false;
+    elf_start_ticks = timer_get_ticks();
+    elf_image_offset = 0;
+    elf_num_streams = 0;
+    elf_loader_start_cache_fill(header);
+    
+    uart_put_str("elf_loader: receiving an ELF file of ");
+    uart_put_hex64(elf_size);
+    uart_put_str(" bytes\n");
+    
+    elf_loader_reply(ELF_LOADER_REPLY_ACK, elf_expected_seq);
+    return ELF_LOADER_IN_PROGRESS;
+}
+
+/**
+ *  Returns the given number of bytes per the given number of timer ticks
+ *  as bytes per second.
+ */
+static uint64_t
+elf_loader_bytes_per_second(uint64_t num_bytes, uint64_t num_ticks)
+{
+    if (num_ticks == 0) {
+        return 0;
+    }
+    return (num_bytes * timer_get_frequency()) / num_ticks;
+}
 
-static char size_buffer[16];
-static uint8_t size_buffer_idx = 0;
+/**
+ *  Prints statistics about the ELF file that has just been received,
+ *  and resets the statistics for the next ELF file.
+ */
+static void
+elf_loader_print_statistics(void)
+{
+    uint64_t total_ticks = timer_get_ticks() - elf_start_ticks;
+    uint64_t num_interrupt_bytes = elf_num_received_bytes - elf_num_polled_bytes;
+    
+    uart_put_str("elf_loader: received ");
+    uart_put_hex64(elf_num_received_bytes);
+    uart_put_str(" bytes in ");
+    uart_put_hex64(elf_num_notifications);
+    uart_put_str(" notifications\n");
+    
+    uart_put_str("elf_loader: polled mode: ");
+    uart_put_hex64(elf_num_polled_bytes);
+    uart_put_str(" bytes at ");
+    uart_put_hex64(elf_loader_bytes_per_second(elf_num_polled_bytes, elf_polling_ticks));
+    uart_put_str(" bytes/s\n");
+    
+    uart_put_str("elf_loader: interrupt mode: ");
+    uart_put_hex64(num_interrupt_bytes);
+    uart_put_str(" bytes at ");
+    uart_put_hex64(elf_loader_bytes_per_second(num_interrupt_bytes, total_ticks - elf_polling_ticks));
+    uart_put_str(" bytes/s\n");
+    
+    if (elf_compressed) {
+        uart_put_str("elf_loader: decompressed ");
+        uart_put_hex64(elf_size);
+        uart_put_str(" bytes to ");
+        uart_put_hex64(elf_decompressed_size);
+        uart_put_str(" bytes\n");
+    }
+    elf_loader_print_cache_statistics();
+    
+    elf_num_notifications = 0;
+    elf_num_received_bytes = 0;
+    elf_num_polled_bytes = 0;
+    elf_polling_ticks = 0;
+}
 
 /**
- *  Converts the given hexadecimal number with num_digits digits
- *  into a uint64_t.  
- *  
- *  The hexadecimal number is assumed to be stored with the most significant
- *  digit at the lowest index.
+ *  Returns the size of the current image after decompression.
  */
-static uint64_t 
-elf_loader_parse_hex64(char *digits, uint8_t num_digits) 
+static uint64_t
+elf_loader_get_image_size(void)
 {
-    uint64_t result = 0;
-    for (int i = num_digits - 1; i >= 0; i--) {
-        uint64_t value = 0;
+    return elf_compressed ? elf_decompressed_size : elf_size;
+}
+
+/**
+ *  Checks the manifest of the bundle being received, once it is complete, and prepares
+ *  a stream for each ELF file of the bundle. The ELF files must be placed in the bundle
+ *  in the order of the manifest, such that they can be loaded one after the other.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if the manifest is malformed or a new PD cannot be created with one of its PD ids.
+ */
+static int
+elf_loader_parse_bundle_manifest(void)
+{
+    sel4cp_bundle_header *header = (sel4cp_bundle_header *)elf_bundle_manifest;
+    sel4cp_bundle_entry *entries = (sel4cp_bundle_entry *)(elf_bundle_manifest + sizeof(sel4cp_bundle_header));
+    
+    uint64_t end = sizeof(sel4cp_bundle_header) + header->num_programs * sizeof(sel4cp_bundle_entry);
+    for (uint64_t i = 0; i < header->num_programs; i++) {
+        uint64_t image_size = elf_loader_get_image_size();
+        if (entries[i].offset % 0x1000 != 0 || entries[i].offset < end || entries[i].offset > image_size || entries[i].size > image_size - entries[i].offset) {
+            uart_put_str("elf_loader: the ELF files of the bundle must be page-aligned and in the order of the manifest\n");
+            return -1;
+        }
+        for (uint64_t j = 0; j < i; j++) {
+            if (entries[j].pd_id == entries[i].pd_id) {
+                uart_put_str("elf_loader: several ELF files of the bundle are loaded into the same PD\n");
+                return -1;
+            }
+        }
+        // The PD id is only checked here, the metadata buffer of the stream is set once the ELF file arrives, see elf_loader_load_bundle.
+        if (sel4cp_pd_stream_init(&elf_streams[i], entries[i].pd_id, NULL, 0)) {
+            uart_put_str("elf_loader: cannot create a new PD with a PD id of the bundle\n");
+            return -1;
+        }
+        end = entries[i].offset + entries[i].size;
+        elf_bundle_crc32s[i] = 0;
+    }
+    
+    elf_num_streams = header->num_programs;
+    elf_bundle_metadata_used = 0;
+    return 0;
+}
+
+/**
+ *  Passes the given bytes at the given offset in the bundle being received 
+ *  on to the ELF files they belong to. The manifest is collected first.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+elf_loader_load_bundle(uint64_t offset, uint8_t *data, uint64_t len)
+{
+    // Collect the manifest, which precedes all ELF files.
+    uint64_t end = offset + len;
+    for (uint64_t i = offset; i < end && i < sizeof(elf_bundle_manifest); i++) {
+        elf_bundle_manifest[i] = data[i - offset];
+    }
+    sel4cp_bundle_header *header = (sel4cp_bundle_header *)elf_bundle_manifest;
+    if (elf_num_streams == 0 && end >= sizeof(sel4cp_bundle_header)) {
+        if (header->num_programs == 0 || header->num_programs > SEL4CP_BUNDLE_MAX_PROGRAMS) {
+            uart_put_str("elf_loader: a bundle must contain between 1 and ");
+            uart_put_hex64(SEL4CP_BUNDLE_MAX_PROGRAMS);
+            uart_put_str(" ELF files\n");
+            return -1;
+        }
+        if (end >= sizeof(sel4cp_bundle_header) + header->num_programs * sizeof(sel4cp_bundle_entry) && elf_loader_parse_bundle_manifest()) {
+            return -1;
+        }
+    }
+    
+    // Pass the bytes on to the ELF files they belong to.
+    sel4cp_bundle_entry *entries = (sel4cp_bundle_entry *)(elf_bundle_manifest + sizeof(sel4cp_bundle_header));
+    for (uint64_t i = 0; i < elf_num_streams; i++) {
+        uint64_t elf_end = entries[i].offset + entries[i].size;
+        uint64_t start = offset > entries[i].offset ? offset : entries[i].offset;
+        uint64_t stop = end < elf_end ? end : elf_end;
+        if (start >= stop)
+            continue;
+        
+        // Each ELF file uses the part of the metadata buffer following the ELF files before it.
+        // Its stream has been initialized with its PD id by elf_loader_parse_bundle_manifest.
+        if (start == entries[i].offset && 
+            sel4cp_pd_stream_set_metadata(&elf_streams[i], elf_metadata + elf_bundle_metadata_used, sizeof(elf_metadata) - elf_bundle_metadata_used)) 
+        {
+            return -1;
+        }
+        
+        uint8_t *elf_data = data + (start - offset);
+        elf_bundle_crc32s[i] = sel4cp_crc32(elf_bundle_crc32s[i], elf_data, stop - start);
+        if (sel4cp_pd_stream_write(&elf_streams[i], elf_data, stop - start)) {
+            return -1;
+        }
         
-        char digit = digits[i];
-        if (digit >= '0' && digit <= '9') {
-            value = digit - '0';
+        if (stop == elf_end) {
+            elf_bundle_metadata_used += (sel4cp_pd_stream_get_metadata_size(&elf_streams[i]) + 7) & ~((uint64_t)7);
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Passes the given bytes, which follow the bytes already loaded from the current image
+ *  after decompression, on to the PDs being created.
+ *  An image starting with SEL4CP_BUNDLE_MAGIC is a bundle of ELF files, and any other image
+ *  is a single ELF file, which is loaded into the PD given by elf_loader_get_target_pd.
+ *  The stream of a single ELF file also accepts a paged image, see sel4cp_paged_image_header.
+ *  An image starting with SEL4CP_LOAD_PLAN_MAGIC is a load plan, which is only copied into
+ *  the image cache until it has been received, see elf_loader_start_pds.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+elf_loader_load_image(uint8_t *data, uint64_t len)
+{
+    uint64_t offset = elf_image_offset;
+    elf_image_offset += len;
+    elf_loader_fill_cache(offset, data, len);
+    
+    if (offset == 0) {
+        elf_bundle = len >= 4 && elf_loader_read_le(data, 4) == SEL4CP_BUNDLE_MAGIC;
+        elf_plan = len >= 4 && elf_loader_read_le(data, 4) == SEL4CP_LOAD_PLAN_MAGIC;
+        if (!elf_bundle && !elf_plan) {
+            if (sel4cp_pd_stream_init(&elf_streams[0], elf_loader_get_target_pd(), elf_metadata, sizeof(elf_metadata))) {
+                uart_put_str("elf_loader: cannot create a new PD with the target PD id\n");
+                return -1;
+            }
+            elf_num_streams = 1;
+        }
+    }
+    
+    if (elf_bundle) {
+        return elf_loader_load_bundle(offset, data, len);
+    }
+    if (elf_plan) {
+        // The operations of a load plan refer to all of its bytes, so it must fit in the image cache.
+        if (elf_cache_fill_slot == ELF_LOADER_CACHE_NUM_SLOTS) {
+            uart_put_str("elf_loader: a load plan can only be received into the image cache\n");
+            return -1;
+        }
+        return 0;
+    }
+    return sel4cp_pd_stream_write(&elf_streams[0], data, len);
+}
+
+/**
+ *  Starts the PDs of the current image once it has been received and verified.
+ *  A load plan is executed from the image cache, which it has been copied into.
+ *
+ *  Returns 0 if all PDs have been started.
+ *  Returns -1 if an error occurs.
+ */
+static int
+elf_loader_start_pds(void)
+{
+    if (elf_bundle) {
+        sel4cp_bundle_entry *entries = (sel4cp_bundle_entry *)(elf_bundle_manifest + sizeof(sel4cp_bundle_header));
+        for (uint64_t i = 0; i < elf_num_streams; i++) {
+            if (elf_bundle_crc32s[i] != entries[i].crc32) {
+                uart_put_str("elf_loader: an ELF file of the bundle does not match its CRC-32\n");
+                elf_loader_destroy_streamed_pds();
+                return -1;
+            }
+        }
+    }
+    
+    // Transmit any queued output before a new PD may take over the UART IRQ.
+    uart_tx_drain();
+    
+    if (elf_plan) {
+        uint64_t slot = elf_loader_find_cached_image(elf_image_crc32, elf_size);
+        if (slot == ELF_LOADER_CACHE_NUM_SLOTS || 
+            sel4cp_pd_create_from_plan(elf_loader_get_target_pd(), elf_cache + slot * elf_cache_slot_size, elf_cache_entries[slot].size)) 
+        {
+            uart_dbg_puts("elf_loader: failed to execute the load plan\n");
+            return -1;
         }
-        else if (digit >= 'a' && digit <= 'f') {
-            value = digit - 'a' + 10;
+        return 0;
+    }
+    
+    int result = elf_num_streams == 0 ? -1 : 0;
+    for (uint64_t i = 0; i < elf_num_streams; i++) {
+        if (sel4cp_pd_stream_finish(&elf_streams[i])) {
+            uart_dbg_puts("elf_loader: failed to start the ELF file in PD ");
+            uart_dbg_puthex64(elf_streams[i].pd);
+            uart_dbg_puts("\n");
+            if (elf_loader_is_streamed_pd(&elf_streams[i])) {
+                sel4cp_pd_destroy(elf_streams[i].pd);
+            }
+            result = -1;
         }
-        else if (digit >= 'A' && digit <= 'F') {
-            value = digit - 'A' + 10;
+        else if (elf_bundle) {
+            uart_dbg_puts("elf_loader: started the ELF file in PD ");
+            uart_dbg_puthex64(elf_streams[i].pd);
+            uart_dbg_puts("\n");
         }
-        else {
-            sel4cp_dbg_puts("elf_loader: invalid hexadecimal digit encountered!\n");
+    }
+    return result;
+}
+
+/**
+ *  Passes the given payload at the given offset in the current upload on to the PDs being created,
+ *  decompressing it first if the upload is a compressed container.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+elf_loader_load_payload(uint64_t offset, uint8_t *payload, uint64_t payload_size)
+{
+    if (offset == 0) {
+        elf_compressed = payload_size >= ELF_LOADER_COMPRESSED_HEADER_SIZE && 
+                         elf_loader_read_le(payload, 4) == ELF_LOADER_COMPRESSED_MAGIC;
+        if (elf_compressed) {
+            elf_decompressed_expected_crc32 = elf_loader_read_le(payload + 4, 4);
+            elf_decompressed_size = elf_loader_read_le(payload + 8, 8);
+            elf_decompressed_crc32 = 0;
+            lzss_init(&elf_decoder);
+            payload += ELF_LOADER_COMPRESSED_HEADER_SIZE;
+            payload_size -= ELF_LOADER_COMPRESSED_HEADER_SIZE;
+        }
+    }
+    
+    if (!elf_compressed) {
+        return elf_loader_load_image(payload, payload_size);
+    }
+    
+    while (true) {
+        uint64_t num_bytes = lzss_decode(&elf_decoder, &payload, &payload_size, elf_decompressed, sizeof(elf_decompressed));
+        if (elf_decoder.failed) {
+            uart_put_str("elf_loader: the compressed ELF file is malformed\n");
+            return -1;
+        }
+        if (num_bytes == 0) {
             return 0;
         }
         
-        result += value * (1 << (4 * (num_digits - 1 - i)));
+        elf_decompressed_crc32 = sel4cp_crc32(elf_decompressed_crc32, elf_decompressed, num_bytes);
+        if (elf_loader_load_image(elf_decompressed, num_bytes)) {
+            return -1;
+        }
     }
-    return result;
+}
+
+/**
+ *  Handles a received data frame with a valid CRC-32.
+ *  The payload is passed on to the PDs being created as soon as it has been accepted.
+ *
+ *  Returns ELF_LOADER_PD_STARTED once the last frame has been received 
+ *  and the PDs have been started, and ELF_LOADER_PD_FAILED if loading the image fails.
+ */
+static elf_loader_result
+elf_loader_handle_data(uint16_t seq, uint8_t *payload, uint64_t payload_size)
+{
+    if (!elf_receiving || seq < elf_expected_seq) {
+        // A retransmission of an already accepted frame, e.g. because an ACK was lost.
+        elf_loader_reply(ELF_LOADER_REPLY_ACK, elf_receiving ? elf_expected_seq : elf_num_frames);
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    if (seq != elf_expected_seq) {
+        // A frame has been lost.
+        elf_loader_request_retransmission();
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    uint64_t offset = (uint64_t)(seq - 1) * ELF_LOADER_FRAME_SIZE;
+    if (elf_loader_load_payload(offset, payload, payload_size)) {
+        uart_put_str("elf_loader: failed to load the received ELF file\n");
+        elf_receiving = false;
+        elf_loader_destroy_streamed_pds();
+        elf_loader_reply(ELF_LOADER_REPLY_ERROR, seq);
+        return ELF_LOADER_PD_FAILED;
+    }
+    elf_received_crc32 = sel4cp_crc32(elf_received_crc32, payload, payload_size);
+    elf_expected_seq++;
+    elf_nak_sent = false;
+    
+    uint64_t num_bytes_received = offset + payload_size;
+    if (num_bytes_received % ELF_LOADER_PROGRESS_INTERVAL == 0) {
+        uart_put_str("elf_loader: received ");
+        uart_put_hex64(num_bytes_received);
+        uart_put_str(" bytes\n");
+    }
+    
+    if (elf_expected_seq < elf_num_frames) {
+        elf_loader_reply(ELF_LOADER_REPLY_ACK, elf_expected_seq);
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    // The last frame has been received. The PD is only started if the whole image is intact.
+    elf_receiving = false;
+    if (elf_received_crc32 != elf_image_crc32) {
+        uart_put_str("elf_loader: the received ELF file does not match the CRC-32 of the upload header\n");
+        elf_loader_destroy_streamed_pds();
+        elf_loader_reply(ELF_LOADER_REPLY_ERROR, elf_expected_seq);
+        return ELF_LOADER_PD_FAILED;
+    }
+    if (elf_compressed && (elf_decoder.num_decoded != elf_decompressed_size || elf_decompressed_crc32 != elf_decompressed_expected_crc32)) {
+        uart_put_str("elf_loader: the decompressed ELF file does not match the header of the compressed container\n");
+        elf_loader_destroy_streamed_pds();
+        elf_loader_reply(ELF_LOADER_REPLY_ERROR, elf_expected_seq);
+        return ELF_LOADER_PD_FAILED;
+    }
+    elf_loader_reply(ELF_LOADER_REPLY_ACK, elf_expected_seq);
+    elf_loader_finish_cache_fill(elf_image_crc32, elf_size, elf_image_offset);
+    elf_loader_print_statistics();
+    
+    if (elf_loader_start_pds()) {
+        return ELF_LOADER_PD_FAILED;
+    }
+    return ELF_LOADER_PD_STARTED;
+}
+
+/**
+ *  Handles a completely received frame.
+ *
+ *  Returns the result of loading the ELF file, see elf_loader_handle_header and elf_loader_handle_data.
+ */
+static elf_loader_result
+elf_loader_handle_frame(void)
+{
+    uint16_t seq = elf_frame[0] | (elf_frame[1] << 8);
+    uint8_t *payload = elf_frame + 2;
+    uint8_t *crc_bytes = payload + elf_frame_payload_size;
+    uint32_t received_crc = elf_loader_read_le(crc_bytes, 4);
+    
+    uint32_t crc = 0;
+    if (seq != 0) {
+        crc = sel4cp_crc32(crc, (uint8_t *)&elf_upload_id, sizeof(elf_upload_id));
+    }
+    crc = sel4cp_crc32(crc, elf_frame, 2 + elf_frame_payload_size);
+    if (crc != received_crc) {
+        if (elf_receiving) {
+            elf_loader_request_retransmission();
+        }
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    if (seq == 0) {
+        elf_loader_upload_header header;
+        uint8_t *header_bytes = (uint8_t *)&header;
+        for (uint64_t i = 0; i < sizeof(header); i++) {
+            header_bytes[i] = payload[i];
+        }
+        return elf_loader_handle_header(&header);
+    }
+    return elf_loader_handle_data(seq, payload, elf_frame_payload_size);
 }
 
 /**
  *  Handles the given input character in the process of loading an ELF file.
  *
- *  If the ELF file has been loaded successfully, a pointer to the loaded ELF
- *  file is returned.
- *  Otherwise, NULL is returned.
+ *  Returns the result of loading the ELF file, see elf_loader_handle_data.
  */
-static uint8_t *
+static elf_loader_result
 elf_loader_handle_input(char c)
 {
-    if (elf_size == 0) { // We are still reading the size of the ELF file to load.
-        if (c == '\n') {
-            elf_size = elf_loader_parse_hex64(size_buffer, size_buffer_idx);
-            
-            size_buffer_idx = 0;
-            
-            if (elf_size > ELF_BUFFER_SIZE) {
-                sel4cp_dbg_puts("elf_loader: cannot read ELF files larger than ");
-                sel4cp_dbg_puthex64(ELF_BUFFER_SIZE);
-                sel4cp_dbg_puts(" bytes\n");
-                return NULL; 
+    switch (elf_frame_state) {
+        case ELF_LOADER_WAITING_FOR_SYNC_0:
+            if ((uint8_t)c == ELF_LOADER_FRAME_SYNC_0) {
+                elf_frame_state = ELF_LOADER_WAITING_FOR_SYNC_1;
+            }
+            return ELF_LOADER_IN_PROGRESS;
+        case ELF_LOADER_WAITING_FOR_SYNC_1:
+            if ((uint8_t)c == ELF_LOADER_FRAME_SYNC_1) {
+                elf_frame_state = ELF_LOADER_RECEIVING_FRAME;
+                elf_frame_idx = 0;
+            }
+            else if ((uint8_t)c != ELF_LOADER_FRAME_SYNC_0) {
+                elf_frame_state = ELF_LOADER_WAITING_FOR_SYNC_0;
+            }
+            return ELF_LOADER_IN_PROGRESS;
+        case ELF_LOADER_RECEIVING_FRAME:
+            break;
+    }
+    
+    elf_frame[elf_frame_idx++] = c;
+    
+    // The payload size is known once the sequence number has been received.
+    if (elf_frame_idx == 2) {
+        uint16_t seq = elf_frame[0] | (elf_frame[1] << 8);
+        elf_frame_payload_size = elf_loader_get_payload_size(seq);
+        if (elf_frame_payload_size == 0) {
+            // Not a valid frame, so the sync marker must have been part of other data.
+            elf_frame_state = ELF_LOADER_WAITING_FOR_SYNC_0;
+            if (elf_receiving) {
+                elf_loader_request_retransmission();
             }
         }
-        else if (size_buffer_idx >= 16) {
-            sel4cp_dbg_puts("elf_loader: the size of an ELF file can not be larger than 64 bytes (16 hexadecimal digits)\n");
-            return NULL;
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    if (elf_frame_idx < elf_frame_payload_size + ELF_LOADER_FRAME_OVERHEAD) {
+        return ELF_LOADER_IN_PROGRESS;
+    }
+    
+    elf_frame_state = ELF_LOADER_WAITING_FOR_SYNC_0;
+    return elf_loader_handle_frame();
+}
+
+/**
+ *  Busy-polls the UART for the rest of the ELF file currently being received.
+ *  Polling stops when the ELF file has been received, when no character has been
+ *  received within the idle timeout, or when the polling time slice is used up.
+ *
+ *  Returns the result of loading the ELF file, see elf_loader_handle_data.
+ */
+static elf_loader_result
+elf_loader_poll_uart(void)
+{
+    uint64_t idle_timeout_ticks = timer_us_to_ticks(ELF_LOADER_POLL_IDLE_TIMEOUT_US);
+    uint64_t slice_ticks = timer_us_to_ticks(ELF_LOADER_POLL_SLICE_US);
+    
+    uint64_t start_ticks = timer_get_ticks();
+    uint64_t last_char_ticks = start_ticks;
+    elf_loader_result result = ELF_LOADER_IN_PROGRESS;
+    while (result == ELF_LOADER_IN_PROGRESS) {
+        uint64_t now_ticks = timer_get_ticks();
+        if (uart_has_char()) {
+            last_char_ticks = now_ticks;
+            elf_num_received_bytes++;
+            elf_num_polled_bytes++;
+            result = elf_loader_handle_input(uart_get_char());
+        }
+        else if (now_ticks - last_char_ticks >= idle_timeout_ticks) {
+            break;
         }
-        else {
-            size_buffer[size_buffer_idx] = c;
-            size_buffer_idx++;
+        
+        // The transmit interrupt cannot be handled while polling,
+        // so keep any queued output moving from here.
+        if (uart_tx_pending()) {
+            uart_tx_flush();
         }
         
-        return NULL;
+        if (now_ticks - start_ticks >= slice_ticks) {
+            break;
+        }
     }
-        
-    // Write to the ELF buffer
-    *elf_current_vaddr = c;
-    elf_current_vaddr++;
     
-    if (elf_current_vaddr - elf_buffer >= elf_size) {
-        elf_current_vaddr = elf_buffer;
-        elf_size = 0;
-        return elf_buffer;
+    // Only count the time until the last received character, 
+    // such that the idle timeout does not skew the polling throughput.
+    elf_polling_ticks += last_char_ticks - start_ticks;
+    return result;
+}
+
+/**
+ *  Handles a UART receive interrupt in the process of loading an ELF file.
+ *  All characters currently available in the receive FIFO are passed to
+ *  elf_loader_handle_input, such that a single notification covers
+ *  as many characters as possible.
+ *
+ *  Once the header of an upload has been received, the loader switches to
+ *  polling the UART, see elf_loader_poll_uart.
+ *
+ *  Returns ELF_LOADER_PD_STARTED once an ELF file has been received and started
+ *  in a new PD, see elf_loader_get_target_pd. Any characters received after the end 
+ *  of the ELF file are left in the receive FIFO.
+ *  Returns ELF_LOADER_PD_FAILED if loading the ELF file has failed.
+ *  Otherwise, ELF_LOADER_IN_PROGRESS is returned.
+ */
+static elf_loader_result
+elf_loader_handle_uart_input(void)
+{
+    elf_num_notifications++;
+    
+    elf_loader_result result = ELF_LOADER_IN_PROGRESS;
+    while (result == ELF_LOADER_IN_PROGRESS && uart_has_char()) {
+        elf_num_received_bytes++;
+        result = elf_loader_handle_input(uart_get_char());
     }
     
-    return NULL;
+    // Switch to polling once an upload is in progress,
+    // as the rest of the upload is expected to arrive back-to-back.
+    if (ELF_LOADER_ENABLE_POLLING && result == ELF_LOADER_IN_PROGRESS && elf_receiving) {
+        result = elf_loader_poll_uart();
+    }
+    return result;
 }
-
-
@@ -0,0 +1,249 @@
+// Tests of the frame parser of elf_loader.h, which is fed the frames of uploads character by character
+// through elf_loader_handle_input, as the receive interrupt of the UART does, with sel4cp.h running on the seL4 model.
+// The replies of the loader are recorded by a stub of uart.h instead of being transmitted.
+//
+// Usage: elf_loader_test <ELF-file> <compressed-container>
+// Both files must be patched with access rights; the container is that of the ELF file, see dynamic_programs/compress_program.py.
+#include "sel4cp_host.h"
+#include "host_root.h"
+
+// The parts of uart.h and timer.h used by elf_loader.h.
+#define MAX_REPLIES 0x1000
+static uint8_t replies[MAX_REPLIES][6];
+static uint64_t num_replies;
+
+int uart_has_char() { return 0; }
+int uart_get_char() { return 0; }
+int uart_tx_pending() { return 0; }
+void uart_tx_flush() {}
+void uart_tx_drain() {}
+int uart_put_str(char *str) { if (verbose) fputs(str, stderr); return 0; }
+void uart_put_hex64(uint64_t val) { if (verbose) fprintf(stderr, "0x%016lx", val); }
+void uart_dbg_puts(const char *str) { if (verbose) fputs(str, stderr); }
+void uart_dbg_puthex64(uint64_t val) { if (verbose) fprintf(stderr, "0x%016lx", val); }
+
+int
+uart_put_reply(uint8_t *bytes, int num_bytes)
+{
+    if (num_bytes != 6 || num_replies == MAX_REPLIES) {
+        abort();
+    }
+    memcpy(replies[num_replies++], bytes, 6);
+    return 1;
+}
+
+static uint64_t ticks;
+uint64_t timer_get_ticks() { return ticks += 1000; }
+uint64_t timer_get_frequency() { return 62500000; }
+uint64_t timer_us_to_ticks(uint64_t us) { return (us * timer_get_frequency()) / 1000000; }
+
+#include "../lzss.h"
+#include "../elf_loader.h"
+
+/**
+ *  Feeds the frame with the given sequence number and payload of the upload with the given id
+ *  to the loader, with a corrupt CRC-32 if corrupt is set, and returns the result of its last character.
+ */
+static elf_loader_result
+send_frame(uint16_t seq, uint32_t upload_id, uint8_t *payload, uint64_t payload_size, bool corrupt)
+{
+    static uint8_t frame[2 + ELF_LOADER_FRAME_SIZE];
+    frame[0] = seq & 0xff;
+    frame[1] = seq >> 8;
+    memcpy(frame + 2, payload, payload_size);
+    uint32_t crc = 0;
+    if (seq != 0) {
+        crc = sel4cp_crc32(crc, (uint8_t *)&upload_id, sizeof(upload_id));
+    }
+    crc = sel4cp_crc32(crc, frame, 2 + payload_size) ^ corrupt;
+
+    elf_loader_handle_input(ELF_LOADER_FRAME_SYNC_0);
+    elf_loader_handle_input(ELF_LOADER_FRAME_SYNC_1);
+    for (uint64_t i = 0; i < 2 + payload_size; i++) {
+        elf_loader_handle_input(frame[i]);
+    }
+    elf_loader_result result = ELF_LOADER_IN_PROGRESS;
+    for (uint64_t i = 0; i < 4; i++) {
+        result = elf_loader_handle_input((crc >> (8 * i)) & 0xff);
+    }
+    return result;
+}
+
+static elf_loader_result
+send_header(uint8_t target_pd, uint32_t upload_id, uint8_t *image, uint64_t image_size)
+{
+    elf_loader_upload_header header = {
+        .magic = ELF_LOADER_MAGIC,
+        .version = ELF_LOADER_VERSION,
+        .target_pd = target_pd,
+        .frame_size = ELF_LOADER_FRAME_SIZE,
+        .upload_id = upload_id,
+        .image_crc32 = sel4cp_crc32(0, image, image_size),
+        .image_size = image_size,
+    };
+    return send_frame(0, upload_id, (uint8_t *)&header, sizeof(header), false);
+}
+
+static elf_loader_result
+send_data_frame(uint16_t seq, uint32_t upload_id, uint8_t *image, uint64_t image_size, bool corrupt)
+{
+    uint64_t offset = (uint64_t)(seq - 1) * ELF_LOADER_FRAME_SIZE;
+    uint64_t payload_size = image_size - offset < ELF_LOADER_FRAME_SIZE ? image_size - offset : ELF_LOADER_FRAME_SIZE;
+    return send_frame(seq, upload_id, image + offset, payload_size, corrupt);
+}
+
+/**
+ *  Returns true if the most recent reply is well-formed and of the given type and sequence number.
+ */
+static bool
+last_reply_is(uint8_t type, uint16_t seq)
+{
+    if (num_replies == 0) {
+        return false;
+    }
+    uint8_t *reply = replies[num_replies - 1];
+    return reply[0] == ELF_LOADER_FRAME_SYNC_0 && reply[1] == ELF_LOADER_FRAME_SYNC_1 && reply[2] == type &&
+           reply[3] == (seq & 0xff) && reply[4] == (seq >> 8) && reply[5] == (reply[2] ^ reply[3] ^ reply[4]);
+}
+
+/**
+ *  Uploads the given image into the given PD without any lost or corrupt frames,
+ *  checking that every frame is acknowledged, and returns the result of the last frame.
+ */
+static elf_loader_result
+upload(uint8_t target_pd, uint32_t upload_id, uint8_t *image, uint64_t image_size)
+{
+    send_header(target_pd, upload_id, image, image_size);
+    if (!last_reply_is(ELF_LOADER_REPLY_ACK, 1)) {
+        return ELF_LOADER_PD_FAILED;
+    }
+    uint16_t num_frames = (image_size + ELF_LOADER_FRAME_SIZE - 1) / ELF_LOADER_FRAME_SIZE + 1;
+    elf_loader_result result = ELF_LOADER_IN_PROGRESS;
+    for (uint16_t seq = 1; seq < num_frames && result == ELF_LOADER_IN_PROGRESS; seq++) {
+        result = send_data_frame(seq, upload_id, image, image_size, false);
+        if (!last_reply_is(ELF_LOADER_REPLY_ACK, seq + 1)) {
+            return ELF_LOADER_PD_FAILED;
+        }
+    }
+    return result;
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <ELF-file> <compressed-container>\n", argv[0]);
+        return 1;
+    }
+    uint64_t elf_file_size, container_size;
+    uint8_t *elf_file = read_file(argv[1], &elf_file_size);
+    uint8_t *container = read_file(argv[2], &container_size);
+    setup();
+    elf_loader_init(1);
+    char *initial = describe();
+
+    // A valid upload is acknowledged frame by frame, and its PD is started.
+    if (upload(1, 1, elf_file, elf_file_size) != ELF_LOADER_PD_STARTED) {
+        printf("elf_loader: a valid upload is not started\n");
+        return 1;
+    }
+
+    // An upload into the id of an existing PD fails with its first data frame, without touching that PD.
+    char *pre = describe();
+    send_header(1, 2, elf_file, elf_file_size);
+    if (!last_reply_is(ELF_LOADER_REPLY_ACK, 1) || send_data_frame(1, 2, elf_file, elf_file_size, false) != ELF_LOADER_PD_FAILED ||
+        !last_reply_is(ELF_LOADER_REPLY_ERROR, 1))
+    {
+        printf("elf_loader: an upload into an existing PD is not answered with an ERROR\n");
+        return 1;
+    }
+    if (strcmp(pre, describe()) != 0) {
+        print_diff(pre, describe());
+        printf("elf_loader: an upload into an existing PD has changed the state\n");
+        return 1;
+    }
+    // The programs have exclusive access rights, such as IRQs or memory regions, so only one PD can run each of them.
+    if (sel4cp_pd_destroy(1) != 0) {
+        printf("elf_loader: the uploaded PD cannot be destroyed\n");
+        return 1;
+    }
+
+    // A frame with a bad CRC-32 is answered with a NAK carrying its sequence number, once until it is received,
+    // and the frames following it are dropped until it is retransmitted.
+    send_header(1, 3, elf_file, elf_file_size);
+    send_data_frame(1, 3, elf_file, elf_file_size, false);
+    send_data_frame(2, 3, elf_file, elf_file_size, true);
+    if (!last_reply_is(ELF_LOADER_REPLY_NAK, 2)) {
+        printf("elf_loader: a frame with a bad CRC-32 is not answered with a NAK\n");
+        return 1;
+    }
+    uint64_t num_nak_replies = num_replies;
+    send_data_frame(3, 3, elf_file, elf_file_size, false);
+    if (num_replies != num_nak_replies) {
+        printf("elf_loader: a frame following a lost frame is not dropped silently\n");
+        return 1;
+    }
+    // A frame of another upload fails the CRC-32, as it covers the upload id.
+    send_data_frame(2, 1, elf_file, elf_file_size, false);
+    if (num_replies != num_nak_replies) {
+        printf("elf_loader: a frame of another upload is accepted\n");
+        return 1;
+    }
+    uint16_t num_frames = (elf_file_size + ELF_LOADER_FRAME_SIZE - 1) / ELF_LOADER_FRAME_SIZE + 1;
+    elf_loader_result result = ELF_LOADER_IN_PROGRESS;
+    for (uint16_t seq = 2; seq < num_frames; seq++) {
+        result = send_data_frame(seq, 3, elf_file, elf_file_size, false);
+    }
+    if (result != ELF_LOADER_PD_STARTED || !last_reply_is(ELF_LOADER_REPLY_ACK, num_frames)) {
+        printf("elf_loader: an upload is not started after retransmitting a frame\n");
+        return 1;
+    }
+
+    // A retransmitted header of the most recent upload, e.g. because its ACK was lost, is acknowledged again.
+    send_header(1, 3, elf_file, elf_file_size);
+    if (!last_reply_is(ELF_LOADER_REPLY_ACK, num_frames)) {
+        printf("elf_loader: a retransmitted header is not acknowledged again\n");
+        return 1;
+    }
+    if (sel4cp_pd_destroy(1) != 0) {
+        printf("elf_loader: the uploaded PD cannot be destroyed\n");
+        return 1;
+    }
+
+    // An upload into an invalid PD id is answered with an ERROR.
+    send_header(SEL4CP_MAX_PDS + 1, 4, elf_file, elf_file_size);
+    if (!last_reply_is(ELF_LOADER_REPLY_ERROR, 0)) {
+        printf("elf_loader: an upload into an invalid PD id is not answered with an ERROR\n");
+        return 1;
+    }
+
+    // An image that is neither an ELF file nor a compressed container fails with its first data frame, which is answered with an ERROR.
+    uint8_t not_elf[ELF_LOADER_FRAME_SIZE * 2];
+    memset(not_elf, 0xff, sizeof(not_elf));
+    send_header(2, 6, not_elf, sizeof(not_elf));
+    if (send_data_frame(1, 6, not_elf, sizeof(not_elf), false) != ELF_LOADER_PD_FAILED || !last_reply_is(ELF_LOADER_REPLY_ERROR, 1)) {
+        printf("elf_loader: an upload of an image that is not an ELF file is not answered with an ERROR\n");
+        return 1;
+    }
+
+    // A compressed upload is decompressed while it arrives.
+    if (upload(1, 5, container, container_size) != ELF_LOADER_PD_STARTED) {
+        printf("elf_loader: a compressed upload is not started\n");
+        return 1;
+    }
+
+    // Destroying the PD returns everything taken for the uploads.
+    if (sel4cp_pd_destroy(1) != 0) {
+        printf("elf_loader: the uploaded PD cannot be destroyed\n");
+        return 1;
+    }
+    char *post = describe();
+    if (strcmp(initial, post) != 0) {
+        print_diff(initial, post);
+        printf("elf_loader: the uploads have not left the state as before\n");
+        return 1;
+    }
+
+    printf("elf_loader: %lu replies to 6 uploads as expected\n", num_replies);
+    return 0;
+}
@@ -0,0 +1,175 @@
+// The parts of the host tests shared by all of them: the symbols of the loading PD that sel4cp.h expects,
+// the set-up of its CSpace in the seL4 model, and a description of the state that a failed or reverted
+// PD creation must leave untouched. Included after sel4cp.h.
+#include <sys/wait.h>
+
+char sel4cp_name[16] = "root";
+sel4cp_pd sel4cp_current_pd_id = 0;
+seL4_IPCBuffer *__sel4_ipc_buffer;
+
+// The debug output of sel4cp.h is only printed with V set in the environment.
+static bool verbose;
+void sel4cp_dbg_putc(int c) { if (verbose) fputc(c, stderr); }
+void sel4cp_dbg_puts(const char *s) { if (verbose) fputs(s, stderr); }
+void sel4cp_dbg_puthex64(uint64_t v) { if (verbose) fprintf(stderr, "%lx", v); }
+
+// Invocations only fail while a PD is created, not while the failed creation is reverted.
+static bool inject_on;
+static bool streaming;
+bool model_inject_enabled(void) { return inject_on && (sel4cp_internal_journal.active || streaming); }
+
+static int root_vs_obj;
+
+static void
+put_root(seL4_CPtr slot, int type, int obj)
+{
+    new_cap(type, obj ? obj : new_obj(type), 0, root_slot(slot));
+}
+
+/**
+ *  Sets up the CSpace and VSpace of the loading PD like the sel4cp tool does:
+ *  its own capabilities, full pools, 4 IRQ handlers, and PDs 2 to 9 of the system with their channels.
+ *  With SEL4CP_NUM_UNTYPED_CAPS > 0, the first untyped capability has UT bytes, if UT is set in the environment,
+ *  the second CSlot is left empty, and the third has UT2 bytes, if UT2 is set.
+ */
+static void
+setup(void)
+{
+    verbose = getenv("V") != NULL;
+    memfd = memfd_create("frames", 0);
+    root_cnode_obj = new_obj(T_CNODE);
+    new_cap(T_CNODE, root_cnode_obj, 0, &objs[root_cnode_obj].slots[BASE_CNODE_CAP + 0]);
+    root_vs_obj = new_obj(T_VSPACE);
+    objs[root_vs_obj].root_vs = 1;
+    put_root(BASE_VSPACE_CAP + 0, T_VSPACE, root_vs_obj);
+    caps[lookup(BASE_VSPACE_CAP)].asid = true;
+    put_root(BASE_TCB_CAP + 0, T_TCB, 0);
+    put_root(INPUT_CAP_IDX, T_EP, 0);
+    put_root(FAULT_EP_CAP_IDX, T_EP, 0);
+    put_root(ASID_POOL_CAP_IDX, T_ASIDPOOL, 0);
+    put_root(SCHED_CONTROL_CAP_IDX, T_SCHEDCTRL, 0);
+    for (int i = 0; i < POOL_NUM_TCBS; i++) put_root(BASE_TCB_POOL + i, T_TCB, 0);
+    for (int i = 0; i < POOL_NUM_NOTIFICATIONS; i++) put_root(BASE_NOTIFICATION_POOL + i, T_NTFN, 0);
+    for (int i = 0; i < POOL_NUM_CNODES; i++) put_root(BASE_CNODE_POOL + i, T_CNODE, 0);
+    for (int i = 0; i < POOL_NUM_SCHEDCONTEXTS; i++) put_root(BASE_SCHEDCONTEXT_POOL + i, T_SC, 0);
+    for (int i = 0; i < POOL_NUM_VSPACES; i++) put_root(BASE_VSPACE_POOL + i, T_VSPACE, 0);
+    for (int i = 0; i < POOL_NUM_PAGE_UPPER_DIRECTORIES; i++) put_root(BASE_PAGE_UPPER_DIRECTORY_POOL + i, T_PUD, 0);
+    for (int i = 0; i < POOL_NUM_PAGE_DIRECTORIES; i++) put_root(BASE_PAGE_DIRECTORY_POOL + i, T_PD, 0);
+    for (int i = 0; i < POOL_NUM_PAGE_TABLES; i++) put_root(BASE_PAGE_TABLE_POOL + i, T_PT, 0);
+    for (int i = 0; i < POOL_NUM_PAGES; i++) put_root(BASE_PAGE_POOL + i, T_FRAME, 0);
+    for (int i = 0; i < 16; i++) put_root(BASE_SHARED_MEMORY_REGION_PAGES + i, T_FRAME, 0);
+    for (int i = 0; i < 4; i++) put_root(BASE_IRQ_CAP + i, T_IRQH, 0);
+#if SEL4CP_NUM_UNTYPED_CAPS > 0
+    if (getenv("UT")) {
+        put_root(BASE_UNTYPED_CAP, T_UNTYPED, 0);
+        objs[caps[lookup(BASE_UNTYPED_CAP)].obj].ut_free = strtoull(getenv("UT"), NULL, 0);
+    }
+    if (getenv("UT2")) {
+        put_root(BASE_UNTYPED_CAP + 2, T_UNTYPED, 0);
+        objs[caps[lookup(BASE_UNTYPED_CAP + 2)].obj].ut_free = strtoull(getenv("UT2"), NULL, 0);
+    }
+#endif
+    for (int p = 2; p <= 9; p++) {
+        put_root(BASE_CNODE_CAP + p, T_CNODE, 0);
+        put_root(BASE_UNBADGED_CHANNEL_CAP + p, T_NTFN, 0);
+        int *slot = &objs[caps[lookup(BASE_CNODE_CAP + p)].obj].slots[BASE_UNBADGED_CHANNEL_CAP + p];
+        derive(lookup(BASE_UNBADGED_CHANNEL_CAP + p), slot, 0);
+    }
+    uint8_t *area = mmap(NULL, 0x1000 * (NUM_TEMP_CAPS + 2), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    __sel4_ipc_buffer = (seL4_IPCBuffer *)(((uint64_t)area + 0xfff) & ~0xfffULL);
+    if (sel4cp_internal_prepare_temp_pages()) {
+        abort();
+    }
+}
+
+/**
+ *  Returns a description of everything a failed or reverted PD creation must restore: every capability outside
+ *  the temp CSlots, the bindings of all objects, the live mappings in the VSpaces of other PDs,
+ *  the contents of the pool pages, and the allocation state of sel4cp.h.
+ */
+static char *
+describe(void)
+{
+    size_t size = 1 << 24;
+    char *buf = malloc(size);
+    FILE *f = fmemopen(buf, size, "w");
+    for (int c = 1; c < ncaps; c++) {
+        if (!caps[c].type) continue;
+        int *w = caps[c].where;
+        if (w >= &objs[root_cnode_obj].slots[BASE_TEMP_CAP] && w < &objs[root_cnode_obj].slots[CNODE_SLOTS]) continue;
+        // A TCB keeps its fault endpoint until it is set again, as seL4 has no invocation to clear it.
+        bool fault_slot = false;
+        for (int o = 1; o < nobjs; o++) if (w == &objs[o].tcb_fault) fault_slot = true;
+        if (fault_slot) continue;
+        fprintf(f, "cap %d type %d obj %d badge %lx mapped %d parent %d where %p\n", c, caps[c].type, caps[c].obj,
+                caps[c].badge, caps[c].mapped, caps[c].parent, (void *)w);
+    }
+    for (int o = 1; o < nobjs; o++) {
+        mobj *m = &objs[o];
+        fprintf(f, "obj %d ntfn %d sc %d ipc %d cs %d vs %d run %d sctcb %d word %lx ntcb %d irq %d\n", o, m->tcb_ntfn, m->tcb_sc,
+                m->tcb_ipc, m->tcb_cspace, m->tcb_vspace, m->running, m->sc_tcb, m->ntfn_word, m->ntfn_tcb, m->irq_ntfn);
+        if (m->type == T_FRAME) {
+            uint8_t *mem = frame_mem(o);
+            for (int i = 0; i < 0x1000; i++) {
+                if (mem[i]) {
+                    fprintf(f, "obj %d dirty\n", o);
+                    break;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < nentries; i++) if (entries[i].live) fprintf(f, "entry %d %lx %d\n", entries[i].container, entries[i].idx, entries[i].cap);
+    fprintf(f, "idx");
+    for (int i = 0; i < NUM_POOLS; i++) fprintf(f, " %lu", sel4cp_pool_get_num_used(i));
+    fprintf(f, " maps %lu segs %lu\n", alloc_state.num_mapped_paging_structures, alloc_state.num_shared_segments);
+    for (int i = 0; i < NUM_OWNED_CAPS; i++) if (alloc_state.cap_owners[i]) fprintf(f, "owner %d %d\n", i, alloc_state.cap_owners[i]);
+    for (int i = 0; i < NUM_OWNED_CAPS; i++) if (alloc_state.moved_pool_caps[i]) fprintf(f, "moved %d %d\n", i, alloc_state.moved_pool_caps[i]);
+    for (int i = 0; i <= SEL4CP_MAX_CHANNELS; i++) if (alloc_state.irq_owners[i]) fprintf(f, "irq %d %d\n", i, alloc_state.irq_owners[i]);
+    for (int i = 0; i <= SEL4CP_MAX_PDS; i++) if (alloc_state.pd_shared_segments[i]) fprintf(f, "pdsegs %d %lx\n", i, alloc_state.pd_shared_segments[i]);
+    for (int p = 0; p <= SEL4CP_MAX_PDS; p++) if (sel4cp_internal_lazy_pds[p].src) fprintf(f, "lazy %d\n", p);
+    fclose(f);
+    return buf;
+}
+
+/**
+ *  Prints the first lines in which the given descriptions differ.
+ */
+static void
+print_diff(const char *expected, const char *actual)
+{
+    int num_printed = 0;
+    while (*expected && *actual && num_printed < 10) {
+        size_t expected_len = strcspn(expected, "\n"), actual_len = strcspn(actual, "\n");
+        if (expected_len != actual_len || strncmp(expected, actual, expected_len) != 0) {
+            fprintf(stderr, "< %.*s\n> %.*s\n", (int)expected_len, expected, (int)actual_len, actual);
+            num_printed++;
+        }
+        expected += expected_len + (expected[expected_len] == '\n');
+        actual += actual_len + (actual[actual_len] == '\n');
+    }
+    if (num_printed < 10 && (*expected || *actual)) {
+        fprintf(stderr, "< %.40s\n> %.40s\n", expected, actual);
+    }
+}
+
+/**
+ *  Returns the contents of the given file in a page-aligned buffer, and its size in *size.
+ */
+static uint8_t *
+read_file(const char *path, uint64_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = aligned_alloc(0x1000, (*size + 0xfff) & ~0xfffULL);
+    if (fread(buf, 1, *size, f) != *size) {
+        abort();
+    }
+    fclose(f);
+    return buf;
+}
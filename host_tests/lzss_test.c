@@ -0,0 +1,117 @@
+// Tests of the LZSS decoder of lzss.h against the compressed containers of dynamic_programs/compress_program.py.
+//
+// Usage: lzss_test <file> <compressed-container>
+// The container is decoded with its input and output split into pieces of varying sizes,
+// as elf_loader.h passes it on frame by frame, and the result must be the file.
+// Decoding a container whose first match refers to bytes before the start of the data must fail.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lzss.h"
+
+#define CONTAINER_HEADER_SIZE 16
+
+static uint8_t *
+read_file(const char *path, uint64_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(*size);
+    if (fread(buf, 1, *size, f) != *size) {
+        abort();
+    }
+    fclose(f);
+    return buf;
+}
+
+/**
+ *  Decodes the given compressed bytes, passing at most max_in bytes of input and
+ *  at most max_out bytes of output at a time, and returns the number of decoded bytes.
+ *  The sizes of the pieces vary between 1 and the maximum.
+ */
+static uint64_t
+decode(lzss_decoder *dec, uint8_t *in, uint64_t in_size, uint8_t *out, uint64_t out_size, uint64_t max_in, uint64_t max_out)
+{
+    uint64_t num_decoded = 0, seed = max_in * 31 + max_out;
+    lzss_init(dec);
+    while (in_size > 0 && !dec->failed) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t in_len = 1 + (seed >> 33) % max_in;
+        if (in_len > in_size) {
+            in_len = in_size;
+        }
+        uint8_t *piece = in;
+        uint64_t piece_len = in_len;
+        while (!dec->failed) {
+            uint64_t out_len = 1 + (seed >> 17) % max_out;
+            if (out_len > out_size - num_decoded) {
+                out_len = out_size - num_decoded;
+            }
+            uint64_t num_bytes = lzss_decode(dec, &piece, &piece_len, out + num_decoded, out_len);
+            num_decoded += num_bytes;
+            if (num_bytes == 0 || num_decoded == out_size) {
+                break;
+            }
+        }
+        in += in_len - piece_len;
+        in_size -= in_len - piece_len;
+        if (num_decoded == out_size) {
+            break;
+        }
+    }
+    return num_decoded;
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <file> <compressed-container>\n", argv[0]);
+        return 1;
+    }
+    uint64_t size, container_size;
+    uint8_t *expected = read_file(argv[1], &size);
+    uint8_t *container = read_file(argv[2], &container_size);
+    uint64_t decompressed_size;
+    memcpy(&decompressed_size, container + 8, sizeof(decompressed_size));
+    if (container_size < CONTAINER_HEADER_SIZE || decompressed_size != size) {
+        printf("lzss: the header of the container does not match the file\n");
+        return 1;
+    }
+
+    static lzss_decoder dec;
+    uint8_t *out = malloc(size);
+    uint64_t piece_sizes[][2] = { { container_size, size }, { 1, 1 }, { 7, 3 }, { 256, 256 }, { 256, 4096 }, { 4096, 17 } };
+    for (uint64_t i = 0; i < sizeof(piece_sizes) / sizeof(piece_sizes[0]); i++) {
+        memset(out, 0, size);
+        uint64_t num_decoded = decode(&dec, container + CONTAINER_HEADER_SIZE, container_size - CONTAINER_HEADER_SIZE, out, size,
+                                      piece_sizes[i][0], piece_sizes[i][1]);
+        if (dec.failed || num_decoded != size || dec.num_decoded != size || memcmp(out, expected, size) != 0) {
+            printf("lzss: decoding in pieces of at most %lu and %lu bytes does not yield the file\n", piece_sizes[i][0], piece_sizes[i][1]);
+            return 1;
+        }
+    }
+
+    // A group of tokens that starts with a match of offset 1, which refers to the byte before the data.
+    uint8_t malformed[] = { 0x01, 0x00, 0x00 };
+    decode(&dec, malformed, sizeof(malformed), out, size, sizeof(malformed), size);
+    if (!dec.failed) {
+        printf("lzss: a match before the start of the data is not rejected\n");
+        return 1;
+    }
+
+    free(out);
+    free(container);
+    free(expected);
+    printf("lzss: %lu bytes decoded from %lu bytes in pieces of varying sizes\n", size, container_size);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#!/bin/sh
+if [ $# -ne 1 ]
+    then
+        echo "Usage: sh run_tests.sh <build-directory>"
+        exit 1
+fi
+
+BUILD_DIR=$1
+NUM_FAILED=0
+
+# Runs the given command, which may start with environment variables, and counts it as failed if it exits with an error.
+run() {
+    echo "$*"
+    env "$@" || NUM_FAILED=$((NUM_FAILED + 1))
+}
+
+for PROGRAM in child memory_reader
+    do
+        # Fail every invocation of each way of creating a PD in turn.
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.elf 0
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.elf 1
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.img 2
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.plan 3
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.elf 4
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.img 4
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.elf 4 evict
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.elf 0 churn
+        run $BUILD_DIR/sel4cp_test $BUILD_DIR/$PROGRAM.elf 0 ids
+        # Retype objects from untyped memory, with objects in the pools and with all pools exhausted.
+        run UT=0x4000000 WARM=1 $BUILD_DIR/sel4cp_test_untyped $BUILD_DIR/$PROGRAM.elf 0
+        run UT=0x4000000 WARM=1 FULL=1 $BUILD_DIR/sel4cp_test_untyped $BUILD_DIR/$PROGRAM.elf 0 churn
+        run $BUILD_DIR/lzss_test $BUILD_DIR/$PROGRAM.elf $BUILD_DIR/$PROGRAM.elf.lz
+        run $BUILD_DIR/elf_loader_test $BUILD_DIR/$PROGRAM.elf $BUILD_DIR/$PROGRAM.elf.lz
+    done
+
+run UT=0x4000000 FULL=1 $BUILD_DIR/sel4cp_test_untyped $BUILD_DIR/memory_reader.elf 0 utcap
+# Without its memory region, a second PD can run memory_reader at the same time and share its read-only segments.
+run NOMR=1 $BUILD_DIR/sel4cp_test $BUILD_DIR/memory_reader.elf 0 churn
+run NOMR=1 $BUILD_DIR/sel4cp_test $BUILD_DIR/memory_reader.elf 0
+
+# The programs in dynamic_programs have a table of access rights in the old format.
+run ASAN_OPTIONS=detect_leaks=0 $BUILD_DIR/sel4cp_test_asan ../dynamic_programs/child.elf 0 trunc
+run ASAN_OPTIONS=detect_leaks=0 $BUILD_DIR/sel4cp_test_asan $BUILD_DIR/child.elf 0 trunc
+
+if [ $NUM_FAILED -ne 0 ]
+    then
+        echo "$NUM_FAILED host tests failed"
+        exit 1
+fi
+echo "All host tests passed"
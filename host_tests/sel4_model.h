@@ -0,0 +1,350 @@
+// A host model of the seL4 invocations used by sel4cp.h, which the host tests include in place of <sel4/sel4.h>.
+// It models capabilities with a derivation tree, CNodes, the paging-structure hierarchy, ASIDs,
+// the bindings of TCBs, SchedContexts, notifications and IRQ handlers, and untyped memory.
+// Frames are backed by a memfd, such that mapping one into the root VSpace at the temp page
+// addresses aliases real host memory.
+//
+// Every invocation that can fail calls inject(), which fails the invocation numbered inject_at
+// while model_inject_enabled() returns true, such that the tests can fail each invocation in turn.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef uint64_t seL4_Word;
+typedef uint64_t seL4_CPtr;
+typedef uint64_t seL4_Time;
+typedef int seL4_Error;
+enum { seL4_NoError = 0, seL4_InvalidArgument, seL4_InvalidCapability, seL4_IllegalOperation, seL4_RangeError,
+       seL4_AlignmentError, seL4_FailedLookup, seL4_TruncatedMessage, seL4_DeleteFirst, seL4_RevokeFirst, seL4_NotEnoughMemory };
+typedef struct { uint64_t words[1]; } seL4_CapRights_t;
+typedef struct { uint64_t words[1]; } seL4_MessageInfo_t;
+typedef int seL4_ARM_VMAttributes;
+typedef struct { uint64_t pc, sp, spsr, x[31]; } seL4_UserContext;
+typedef struct { uint64_t tag; uint64_t msg[120]; } seL4_IPCBuffer;
+#define seL4_AllRights ((seL4_CapRights_t){{15}})
+#define seL4_ReadWrite ((seL4_CapRights_t){{3}})
+#define seL4_CanRead ((seL4_CapRights_t){{2}})
+#define seL4_Fault_VMFault 5
+#define seL4_VMFault_Addr 1
+#define seL4_VMFault_FSR 3
+
+enum { T_NULL, T_TCB, T_NTFN, T_CNODE, T_SC, T_VSPACE, T_PUD, T_PD, T_PT, T_FRAME, T_LFRAME, T_EP, T_ASIDPOOL, T_SCHEDCTRL, T_IRQH, T_UNTYPED };
+enum { seL4_UntypedObject, seL4_TCBObject, seL4_EndpointObject, seL4_NotificationObject, seL4_CapTableObject, seL4_SchedContextObject, seL4_ReplyObject,
+       seL4_ARM_PageUpperDirectoryObject, seL4_ARM_PageGlobalDirectoryObject, seL4_ARM_SmallPageObject, seL4_ARM_LargePageObject, seL4_ARM_HugePageObject,
+       seL4_ARM_PageTableObject, seL4_ARM_PageDirectoryObject };
+#define seL4_ARM_VSpaceObject seL4_ARM_PageGlobalDirectoryObject
+#define seL4_MinSchedContextBits 8
+
+#define CNODE_SLOTS 2048
+#define MAXCAPS 200000
+#define MAXOBJS 4096
+typedef struct { int type, obj, parent; uint64_t badge; bool mapped; int map_container; uint64_t map_idx; bool asid; int *where; } mcap;
+typedef struct {
+    int type; int *slots;
+    int tcb_ntfn, tcb_sc, tcb_ipc, tcb_cspace, tcb_vspace, tcb_fault; bool running;
+    int sc_tcb; bool sc_configured;
+    uint64_t ntfn_word; int ntfn_tcb;
+    int irq_ntfn;
+    uint64_t frame_off; uint64_t frame_size;
+    int root_vs; // 1 for the VSpace of the current PD
+    uint64_t ut_free; // the bytes left in an untyped object
+} mobj;
+static mcap caps[MAXCAPS]; static int ncaps = 1;
+static mobj objs[MAXOBJS]; static int nobjs = 1;
+// The entries of the paging structures: container object, index (vaddr >> bits), child object, child cap.
+typedef struct { int container; uint64_t idx; int child; int cap; bool live; } mentry;
+static mentry entries[100000]; static int nentries;
+static int memfd; static uint64_t memfd_size;
+static int root_cnode_obj;
+static long long n_invocations, inject_at = -1, n_destroyed;
+extern bool model_inject_enabled(void);
+
+static int new_obj(int type) {
+    int o = nobjs++; memset(&objs[o], 0, sizeof(mobj)); objs[o].type = type;
+    if (type == T_CNODE) objs[o].slots = calloc(CNODE_SLOTS, sizeof(int));
+    if (type == T_FRAME || type == T_LFRAME) {
+        uint64_t size = type == T_FRAME ? 0x1000 : 0x200000;
+        memfd_size = (memfd_size + size - 1) & ~(size - 1);
+        objs[o].frame_off = memfd_size; objs[o].frame_size = size; memfd_size += size;
+        if (ftruncate(memfd, memfd_size)) abort();
+    }
+    return o;
+}
+static int new_cap(int type, int obj, int parent, int *where) {
+    int c = ncaps++; memset(&caps[c], 0, sizeof(mcap));
+    caps[c].type = type; caps[c].obj = obj; caps[c].parent = parent; caps[c].where = where; *where = c; return c;
+}
+static int *root_slot(seL4_CPtr cptr) { return cptr < CNODE_SLOTS ? &objs[root_cnode_obj].slots[cptr] : NULL; }
+static int lookup(seL4_CPtr cptr) { int *s = root_slot(cptr); return s ? *s : 0; }
+static int *cnode_slot(seL4_CPtr cnode, seL4_Word idx) {
+    int c = lookup(cnode); if (!c || caps[c].type != T_CNODE || idx >= CNODE_SLOTS) return NULL;
+    return &objs[caps[c].obj].slots[idx];
+}
+static uint8_t *all; static uint64_t all_size;
+// Gives a forked process its own copy of the frames, which must not be mapped into the current PD.
+static void model_private_frames(void) {
+    int fd = memfd_create("frames", 0);
+    if (ftruncate(fd, memfd_size)) abort();
+    uint8_t *src = mmap(NULL, memfd_size, PROT_READ, MAP_SHARED, memfd, 0), *dst = mmap(NULL, memfd_size, PROT_WRITE, MAP_SHARED, fd, 0);
+    memcpy(dst, src, memfd_size); munmap(src, memfd_size); munmap(dst, memfd_size);
+    if (all) munmap(all, all_size);
+    all = NULL; all_size = 0; close(memfd); memfd = fd;
+}
+static uint8_t *frame_mem(int obj) {
+    if (all_size != memfd_size) { if (all) munmap(all, all_size); all = mmap(NULL, memfd_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0); all_size = memfd_size; }
+    return all + objs[obj].frame_off;
+}
+static int count_caps(int obj) { int n = 0; for (int c = 1; c < ncaps; c++) if (caps[c].type && caps[c].obj == obj) n++; return n; }
+static bool inject(void) {
+    if (!model_inject_enabled()) return false;
+    return n_invocations++ == inject_at;
+}
+static void remove_entry_of_cap(int c);
+static void unmap_root_page(int c);
+static void delete_cap(int c) {
+    if (!caps[c].type) return;
+    if ((caps[c].type == T_FRAME || caps[c].type == T_LFRAME) && caps[c].mapped) { unmap_root_page(c); remove_entry_of_cap(c); }
+    for (int d = 1; d < ncaps; d++) if (caps[d].type && caps[d].parent == c) caps[d].parent = caps[c].parent;
+    int obj = caps[c].obj;
+    *caps[c].where = 0; caps[c].type = T_NULL;
+    if (count_caps(obj) == 0) n_destroyed++;
+}
+static bool is_descendant(int d, int c) { for (int p = caps[d].parent; p; p = caps[p].parent) if (p == c) return true; return false; }
+static int derive(int src, int *where, uint64_t badge) {
+    mcap s = caps[src];
+    if (s.type == T_VSPACE && !s.asid) return -1;
+    int c = new_cap(s.type, s.obj, src, where);
+    caps[c].badge = badge ? badge : s.badge; caps[c].asid = s.asid;
+    return c;
+}
+
+static seL4_Error seL4_CNode_Copy(seL4_CPtr dr, seL4_Word di, uint8_t dd, seL4_CPtr sr, seL4_Word si, uint8_t sd, seL4_CapRights_t r) {
+    if (inject()) return seL4_IllegalOperation;
+    int *d = cnode_slot(dr, di), *s = cnode_slot(sr, si);
+    if (!d || !s || !*s) return seL4_FailedLookup;
+    if (*d) return seL4_DeleteFirst;
+    return derive(*s, d, 0) < 0 ? seL4_IllegalOperation : seL4_NoError;
+}
+static seL4_Error seL4_CNode_Mint(seL4_CPtr dr, seL4_Word di, uint8_t dd, seL4_CPtr sr, seL4_Word si, uint8_t sd, seL4_CapRights_t r, seL4_Word badge) {
+    if (inject()) return seL4_IllegalOperation;
+    int *d = cnode_slot(dr, di), *s = cnode_slot(sr, si);
+    if (!d || !s || !*s) return seL4_FailedLookup;
+    if (*d) return seL4_DeleteFirst;
+    return derive(*s, d, badge) < 0 ? seL4_IllegalOperation : seL4_NoError;
+}
+static seL4_Error seL4_CNode_Move(seL4_CPtr dr, seL4_Word di, uint8_t dd, seL4_CPtr sr, seL4_Word si, uint8_t sd) {
+    if (inject()) return seL4_IllegalOperation;
+    int *d = cnode_slot(dr, di), *s = cnode_slot(sr, si);
+    if (!d || !s || !*s) return seL4_FailedLookup;
+    if (*d) return seL4_DeleteFirst;
+    int c = *s; *s = 0; *d = c; caps[c].where = d; return seL4_NoError;
+}
+static long long n_retyped;
+static seL4_Error seL4_Untyped_Retype(seL4_CPtr ut, seL4_Word type, seL4_Word size_bits, seL4_CPtr root, seL4_Word node_index, seL4_Word node_depth, seL4_Word node_offset, seL4_Word num) {
+    if (inject()) return seL4_IllegalOperation;
+    int u = lookup(ut); if (!u || caps[u].type != T_UNTYPED) return seL4_InvalidCapability;
+    if (node_depth != 0 || num != 1) return seL4_InvalidArgument;
+    int *d = cnode_slot(root, node_offset); if (!d) return seL4_FailedLookup;
+    if (*d) return seL4_DeleteFirst;
+    static const int types[] = { [seL4_TCBObject] = T_TCB, [seL4_NotificationObject] = T_NTFN, [seL4_CapTableObject] = T_CNODE, [seL4_SchedContextObject] = T_SC,
+        [seL4_ARM_PageGlobalDirectoryObject] = T_VSPACE, [seL4_ARM_PageUpperDirectoryObject] = T_PUD, [seL4_ARM_PageDirectoryObject] = T_PD,
+        [seL4_ARM_PageTableObject] = T_PT, [seL4_ARM_SmallPageObject] = T_FRAME, [seL4_ARM_LargePageObject] = T_LFRAME };
+    if (type >= sizeof(types) / sizeof(types[0]) || !types[type]) return seL4_InvalidArgument;
+    if (type == seL4_CapTableObject && size_bits != 11) return seL4_InvalidArgument;
+    if (type == seL4_SchedContextObject && size_bits < seL4_MinSchedContextBits) return seL4_InvalidArgument;
+    uint64_t size = type == seL4_TCBObject ? 1 << 11 : type == seL4_NotificationObject ? 32 : type == seL4_CapTableObject ? 1ULL << (size_bits + 5) :
+        type == seL4_SchedContextObject ? 1ULL << size_bits : type == seL4_ARM_LargePageObject ? 0x200000 : 0x1000;
+    mobj *m = &objs[caps[u].obj];
+    if (m->ut_free < size) return seL4_NotEnoughMemory;
+    m->ut_free -= size; n_retyped++;
+    new_cap(types[type], new_obj(types[type]), u, d);
+    return seL4_NoError;
+}
+static seL4_Error seL4_CNode_Delete(seL4_CPtr r, seL4_Word i, uint8_t d) {
+    // Emptying a CSlot for temporary capabilities (the last 8) is fatal by design, so no failure is injected there.
+    if (i < CNODE_SLOTS - 8 && inject()) return seL4_IllegalOperation;
+    int *s = cnode_slot(r, i); if (!s) return seL4_FailedLookup;
+    if (*s) delete_cap(*s);
+    return seL4_NoError;
+}
+static seL4_Error seL4_CNode_Revoke(seL4_CPtr r, seL4_Word i, uint8_t d) {
+    if (inject()) return seL4_IllegalOperation;
+    int *s = cnode_slot(r, i); if (!s) return seL4_FailedLookup;
+    int c = *s; if (!c) return seL4_NoError;
+    bool again = true;
+    while (again) { again = false; for (int x = 1; x < ncaps; x++) if (caps[x].type && is_descendant(x, c)) { delete_cap(x); again = true; } }
+    return seL4_NoError;
+}
+static seL4_Error seL4_ARM_ASIDPool_Assign(seL4_CPtr pool, seL4_CPtr vs) {
+    if (inject()) return seL4_IllegalOperation;
+    int c = lookup(vs); if (!c || caps[c].type != T_VSPACE) return seL4_InvalidCapability;
+    if (caps[c].asid) return seL4_InvalidCapability;
+    caps[c].asid = true; return seL4_NoError;
+}
+// Paging structures. Levels: vspace (39), PUD (30), PD (21), PT (12).
+static int find_entry(int container, uint64_t idx) { for (int i = 0; i < nentries; i++) if (entries[i].live && entries[i].container == container && entries[i].idx == idx) return i; return -1; }
+static int walk(int vs_obj, uint64_t vaddr, int levels) { // returns the container object at the given depth, or 0.
+    int o = vs_obj; int bits[] = {39, 30, 21};
+    for (int l = 0; l < levels; l++) { int e = find_entry(o, (vaddr >> bits[l]) & 511); if (e < 0) return 0; o = entries[e].child; }
+    return o;
+}
+static void remove_entry_of_cap(int c) {
+    if (!caps[c].mapped) return;
+    int e = find_entry(caps[c].map_container, caps[c].map_idx);
+    if (e >= 0 && entries[e].cap == c) entries[e].live = false;
+}
+static bool is_root_vs(int vs_obj) { return objs[vs_obj].root_vs; }
+static seL4_Error map_structure(seL4_CPtr cptr, seL4_CPtr vs, uint64_t vaddr, int type, int levels, int bits) {
+    if (inject()) return seL4_IllegalOperation;
+    int c = lookup(cptr), v = lookup(vs);
+    if (!c || caps[c].type != type || !v || caps[v].type != T_VSPACE) return seL4_InvalidCapability;
+    if (!caps[v].asid) return seL4_FailedLookup;
+    if (is_root_vs(caps[v].obj)) return seL4_DeleteFirst; // the current PD has all its paging structures
+    if (caps[c].mapped) return seL4_InvalidCapability;
+    int container = walk(caps[v].obj, vaddr, levels); if (!container) return seL4_FailedLookup;
+    uint64_t idx = (vaddr >> bits) & 511;
+    if (find_entry(container, idx) >= 0) return seL4_DeleteFirst;
+    entries[nentries++] = (mentry){container, idx, caps[c].obj, c, true};
+    caps[c].mapped = true; caps[c].map_container = container; caps[c].map_idx = idx;
+    return seL4_NoError;
+}
+static seL4_Error seL4_ARM_PageUpperDirectory_Map(seL4_CPtr c, seL4_CPtr vs, seL4_Word v, seL4_ARM_VMAttributes a) { return map_structure(c, vs, v, T_PUD, 0, 39); }
+static seL4_Error seL4_ARM_PageDirectory_Map(seL4_CPtr c, seL4_CPtr vs, seL4_Word v, seL4_ARM_VMAttributes a) { return map_structure(c, vs, v, T_PD, 1, 30); }
+static seL4_Error seL4_ARM_PageTable_Map(seL4_CPtr c, seL4_CPtr vs, seL4_Word v, seL4_ARM_VMAttributes a) { return map_structure(c, vs, v, T_PT, 2, 21); }
+static seL4_Error unmap_structure(seL4_CPtr cptr, int type) {
+    if (inject()) return seL4_IllegalOperation;
+    int c = lookup(cptr); if (!c || caps[c].type != type) return seL4_InvalidCapability;
+    if (caps[c].mapped) {
+        remove_entry_of_cap(c);
+        for (int i = 0; i < nentries; i++) if (entries[i].live && entries[i].container == caps[c].obj) entries[i].live = false; // cleared
+        caps[c].mapped = false;
+    }
+    return seL4_NoError;
+}
+static seL4_Error seL4_ARM_PageUpperDirectory_Unmap(seL4_CPtr c) { return unmap_structure(c, T_PUD); }
+static seL4_Error seL4_ARM_PageDirectory_Unmap(seL4_CPtr c) { return unmap_structure(c, T_PD); }
+static seL4_Error seL4_ARM_PageTable_Unmap(seL4_CPtr c) { return unmap_structure(c, T_PT); }
+static uint64_t root_map_vaddr[MAXCAPS];
+static seL4_Error seL4_ARM_Page_Map(seL4_CPtr cptr, seL4_CPtr vs, seL4_Word vaddr, seL4_CapRights_t r, seL4_ARM_VMAttributes a) {
+    if (inject()) return seL4_IllegalOperation;
+    int c = lookup(cptr), v = lookup(vs);
+    if (!c || (caps[c].type != T_FRAME && caps[c].type != T_LFRAME) || !v || caps[v].type != T_VSPACE) return seL4_InvalidCapability;
+    if (!caps[v].asid) return seL4_FailedLookup;
+    if (caps[c].mapped) return seL4_InvalidCapability;
+    bool large = caps[c].type == T_LFRAME;
+    if (vaddr % objs[caps[c].obj].frame_size) return seL4_AlignmentError;
+    if (is_root_vs(caps[v].obj)) {
+        if (large) return seL4_IllegalOperation;
+        void *p = mmap((void *)vaddr, 0x1000, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd, objs[caps[c].obj].frame_off);
+        if (p == MAP_FAILED) abort();
+        caps[c].mapped = true; caps[c].map_container = -1; root_map_vaddr[c] = vaddr;
+        return seL4_NoError;
+    }
+    int container = walk(caps[v].obj, vaddr, large ? 2 : 3); if (!container) return seL4_FailedLookup;
+    uint64_t idx = (vaddr >> (large ? 21 : 12)) & 511;
+    if (find_entry(container, idx) >= 0) return seL4_DeleteFirst;
+    entries[nentries++] = (mentry){container, idx, caps[c].obj, c, true};
+    caps[c].mapped = true; caps[c].map_container = container; caps[c].map_idx = idx;
+    return seL4_NoError;
+}
+static void unmap_root_page(int c) {
+    if (caps[c].mapped && caps[c].map_container == -1) {
+        mmap((void *)root_map_vaddr[c], 0x1000, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    }
+}
+static seL4_Error seL4_ARM_Page_Unmap(seL4_CPtr cptr) {
+    if (inject()) return seL4_IllegalOperation;
+    int c = lookup(cptr); if (!c || (caps[c].type != T_FRAME && caps[c].type != T_LFRAME)) return seL4_InvalidCapability;
+    if (caps[c].mapped) { unmap_root_page(c); remove_entry_of_cap(c); caps[c].mapped = false; }
+    return seL4_NoError;
+}
+static int tcb_of(seL4_CPtr cptr) { int c = lookup(cptr); return c && caps[c].type == T_TCB ? caps[c].obj : 0; }
+static void tcb_set_slot(int *slot, int src) { if (*slot) delete_cap(*slot); if (src) derive(src, slot, 0); }
+static seL4_Error seL4_TCB_SetSpace(seL4_CPtr tcb, seL4_CPtr fault_ep, seL4_CPtr cspace, seL4_Word guard, seL4_CPtr vspace, seL4_Word vdata) {
+    if (inject()) return seL4_IllegalOperation;
+    int t = tcb_of(tcb), f = lookup(fault_ep), cs = lookup(cspace), vs = lookup(vspace);
+    if (!t || !f || !cs || caps[cs].type != T_CNODE || !vs || caps[vs].type != T_VSPACE) return seL4_InvalidCapability;
+    tcb_set_slot(&objs[t].tcb_fault, f); tcb_set_slot(&objs[t].tcb_cspace, cs); tcb_set_slot(&objs[t].tcb_vspace, vs);
+    return seL4_NoError;
+}
+static seL4_Error seL4_TCB_BindNotification(seL4_CPtr tcb, seL4_CPtr ntfn) {
+    if (inject()) return seL4_IllegalOperation;
+    int t = tcb_of(tcb), n = lookup(ntfn); if (!t || !n || caps[n].type != T_NTFN) return seL4_InvalidCapability;
+    if (objs[t].tcb_ntfn || objs[caps[n].obj].ntfn_tcb) return seL4_IllegalOperation;
+    objs[t].tcb_ntfn = caps[n].obj; objs[caps[n].obj].ntfn_tcb = t; return seL4_NoError;
+}
+static seL4_Error seL4_TCB_UnbindNotification(seL4_CPtr tcb) {
+    if (inject()) return seL4_IllegalOperation;
+    int t = tcb_of(tcb); if (!t) return seL4_InvalidCapability;
+    if (!objs[t].tcb_ntfn) return seL4_IllegalOperation;
+    objs[objs[t].tcb_ntfn].ntfn_tcb = 0; objs[t].tcb_ntfn = 0; return seL4_NoError;
+}
+static seL4_Error seL4_TCB_SetSchedParams(seL4_CPtr tcb, seL4_CPtr auth, seL4_Word mcp, seL4_Word prio, seL4_CPtr sc, seL4_CPtr fault_ep) {
+    if (inject()) return seL4_IllegalOperation;
+    int t = tcb_of(tcb), s = lookup(sc), f = lookup(fault_ep);
+    if (!t || (s && caps[s].type != T_SC) || !f) return seL4_InvalidCapability;
+    // Like seL4, an empty CSlot for the SchedContext unbinds the one of the TCB.
+    if (!s) {
+        if (objs[t].tcb_sc) { objs[objs[t].tcb_sc].sc_tcb = 0; objs[t].tcb_sc = 0; }
+        tcb_set_slot(&objs[t].tcb_fault, f); return seL4_NoError;
+    }
+    int so = caps[s].obj;
+    if (objs[t].tcb_sc && objs[t].tcb_sc != so) return seL4_IllegalOperation;
+    if (objs[so].sc_tcb && objs[so].sc_tcb != t) return seL4_IllegalOperation;
+    objs[t].tcb_sc = so; objs[so].sc_tcb = t; tcb_set_slot(&objs[t].tcb_fault, f); return seL4_NoError;
+}
+static seL4_Error seL4_SchedContext_Unbind(seL4_CPtr sc) {
+    if (inject()) return seL4_IllegalOperation;
+    int s = lookup(sc); if (!s || caps[s].type != T_SC) return seL4_InvalidCapability;
+    int so = caps[s].obj; if (objs[so].sc_tcb) { objs[objs[so].sc_tcb].tcb_sc = 0; objs[so].sc_tcb = 0; }
+    return seL4_NoError;
+}
+static seL4_Error seL4_SchedControl_ConfigureFlags(seL4_CPtr ctrl, seL4_CPtr sc, seL4_Time b, seL4_Time p, seL4_Word e, seL4_Word badge, seL4_Word flags) {
+    if (inject()) return seL4_IllegalOperation;
+    int s = lookup(sc); if (!s || caps[s].type != T_SC) return seL4_InvalidCapability;
+    objs[caps[s].obj].sc_configured = true; return seL4_NoError;
+}
+static seL4_Error seL4_TCB_SetIPCBuffer(seL4_CPtr tcb, seL4_Word vaddr, seL4_CPtr frame) {
+    if (inject()) return seL4_IllegalOperation;
+    int t = tcb_of(tcb), f = lookup(frame); if (!t || !f || caps[f].type != T_FRAME) return seL4_InvalidCapability;
+    tcb_set_slot(&objs[t].tcb_ipc, f); return seL4_NoError;
+}
+static seL4_Error seL4_TCB_WriteRegisters(seL4_CPtr tcb, bool resume, uint8_t flags, seL4_Word n, seL4_UserContext *ctx) {
+    if (inject()) return seL4_IllegalOperation;
+    int t = tcb_of(tcb); if (!t) return seL4_InvalidCapability;
+    if (resume) objs[t].running = true;
+    return seL4_NoError;
+}
+static seL4_Error seL4_TCB_Suspend(seL4_CPtr tcb) {
+    if (inject()) return seL4_IllegalOperation;
+    int t = tcb_of(tcb); if (!t) return seL4_InvalidCapability;
+    objs[t].running = false; return seL4_NoError;
+}
+static seL4_Error seL4_IRQHandler_SetNotification(seL4_CPtr irq, seL4_CPtr ntfn) {
+    if (inject()) return seL4_IllegalOperation;
+    int i = lookup(irq), n = lookup(ntfn); if (!i || caps[i].type != T_IRQH || !n || caps[n].type != T_NTFN) return seL4_InvalidCapability;
+    tcb_set_slot(&objs[caps[i].obj].irq_ntfn, n); return seL4_NoError;
+}
+static seL4_Error seL4_IRQHandler_Clear(seL4_CPtr irq) {
+    if (inject()) return seL4_IllegalOperation;
+    int i = lookup(irq); if (!i || caps[i].type != T_IRQH) return seL4_InvalidCapability;
+    tcb_set_slot(&objs[caps[i].obj].irq_ntfn, 0); return seL4_NoError;
+}
+static seL4_Error seL4_IRQHandler_Ack(seL4_CPtr irq) { return seL4_NoError; }
+static seL4_MessageInfo_t seL4_Poll(seL4_CPtr src, seL4_Word *sender) {
+    int n = lookup(src); if (n && caps[n].type == T_NTFN) { if (sender) *sender = objs[caps[n].obj].ntfn_word; objs[caps[n].obj].ntfn_word = 0; }
+    return (seL4_MessageInfo_t){{0}};
+}
+static void seL4_Signal(seL4_CPtr c) { int n = lookup(c); if (n && caps[n].type == T_NTFN) objs[caps[n].obj].ntfn_word |= caps[n].badge; }
+static seL4_MessageInfo_t seL4_MessageInfo_new(seL4_Word l, seL4_Word u, seL4_Word e, seL4_Word len) { return (seL4_MessageInfo_t){{l << 12 | len}}; }
+static seL4_Word seL4_MessageInfo_get_label(seL4_MessageInfo_t m) { return m.words[0] >> 12; }
+static seL4_MessageInfo_t seL4_Call(seL4_CPtr c, seL4_MessageInfo_t m) { return m; }
+static void seL4_Send(seL4_CPtr c, seL4_MessageInfo_t m) {}
+static seL4_Word model_mrs[64];
+static seL4_Word seL4_GetMR(int i) { return model_mrs[i]; }
+static void seL4_SetMR(int i, seL4_Word v) { model_mrs[i] = v; }
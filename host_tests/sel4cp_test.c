@@ -0,0 +1,433 @@
+// Tests of the PD creation and destruction of sel4cp.h against the seL4 model.
+//
+// Usage: sel4cp_test <file> <mode> [<test>]
+// The mode selects how the file is loaded: 0 sel4cp_pd_create, 1 sel4cp_pd_create_lazy,
+// 2 sel4cp_pd_create_from_image, 3 sel4cp_pd_create_from_plan, 4 streaming it like elf_loader.h.
+// The tests are:
+//     - rollback (the default): fails every invocation of the creation of a PD in turn, and checks that each
+//       failed creation is reverted completely, see pd_create_journal, and that the PD can be created afterwards.
+//     - churn: creates and destroys PDs repeatedly, checking that everything is returned each time.
+//     - evict: checks that the bytes of the loadable segments end up in the pages of the PD when streaming,
+//       even if the temp pages are reused between two writes.
+//     - trunc: checks that the access rights of a truncated file, or of one with a corrupt table, are rejected.
+//     - ids: checks that creating a PD with an invalid id or the id of an existing PD fails without any effect.
+//     - utcap: checks how pools are refilled from untyped memory, see sel4cp_internal_retype_pool_cap.
+// Set in the environment:
+//     - NOMR to drop the memory regions of the program, such that two PDs can run it at the same time.
+//     - WARM to create and destroy the PD once first, such that the objects retyped for it are in the pools.
+//     - FULL to hand out all objects of the pools first, such that every object is retyped from untyped memory.
+//     - V to print the debug output of sel4cp.h.
+//     - UT and UT2 to give the loading PD untyped memory, see setup.
+#include "sel4cp_host.h"
+#include "host_root.h"
+
+#define NUM_CHURN_CYCLES 5
+
+static int mode;
+static uint8_t *prog;
+static uint64_t prog_size;
+
+/**
+ *  Creates the given PD from the file in the given mode.
+ */
+static int
+create(sel4cp_pd pd)
+{
+    switch (mode) {
+        case 0: return sel4cp_pd_create(pd, prog, prog_size);
+        case 1: return sel4cp_pd_create_lazy(pd, prog, prog_size);
+        case 2: return sel4cp_pd_create_from_image(pd, prog, prog_size);
+        case 3: return sel4cp_pd_create_from_plan(pd, prog, prog_size);
+        default: break;
+    }
+
+    // Stream the file in chunks like the ELF loader, which destroys the PD if the stream fails.
+    static uint8_t metadata[0x200000] __attribute__((aligned(8)));
+    sel4cp_elf_stream stream;
+    streaming = true;
+    int err = sel4cp_pd_stream_init(&stream, pd, metadata, sizeof(metadata));
+    for (uint64_t offset = 0; offset < prog_size && !err; offset += 1000) {
+        // Reuse all temp pages between two writes, like loading pages on demand does.
+        if (getenv("EVICT")) {
+            for (int i = 0; i < NUM_TEMP_CAPS; i++) sel4cp_internal_allocate_temp_cap();
+        }
+        err = sel4cp_pd_stream_write(&stream, prog + offset, prog_size - offset < 1000 ? prog_size - offset : 1000);
+    }
+    if (!err) {
+        err = sel4cp_pd_stream_finish(&stream);
+    }
+    streaming = false;
+    if (err && stream.num_received != 0) {
+        sel4cp_pd_destroy(pd);
+    }
+    return err ? -1 : 0;
+}
+
+/**
+ *  Returns the line with the pool occupancy of the given description.
+ */
+static char *
+get_occupancy(const char *description)
+{
+    char *line = strdup(strstr(description, "\nidx ") + 1);
+    *strchr(line, '\n') = 0;
+    return line;
+}
+
+static int
+test_rollback(char *pre)
+{
+    // The expected state once no invocation fails, which is reached in a child process
+    // with its own copy of the frames, such that every injection starts from the state before it.
+    int pipefd[2];
+    if (pipe(pipefd)) {
+        abort();
+    }
+    if (fork() == 0) {
+        model_private_frames();
+        int result = create(1);
+        char *occupancy = get_occupancy(describe());
+        if (write(pipefd[1], &result, sizeof(result)) < 0 || write(pipefd[1], occupancy, strlen(occupancy)) < 0) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    int clean_result = -1;
+    static char clean_occupancy[256];
+    if (read(pipefd[0], &clean_result, sizeof(clean_result)) < 0 || read(pipefd[0], clean_occupancy, sizeof(clean_occupancy) - 1) < 0) {
+        abort();
+    }
+    wait(NULL);
+    if (clean_result != 0) {
+        printf("rollback: the creation of PD 1 fails without injected failures\n");
+        return 1;
+    }
+
+    int num_failures = 0, num_injected = 0;
+    for (long long k = 0;; k++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            model_private_frames();
+            inject_on = true;
+            inject_at = k;
+            n_invocations = 0;
+            int result = create(1);
+            inject_on = false;
+            if (n_invocations <= k) _exit(2);
+            // An injected failure of an invocation whose failure is expected does not fail the creation.
+            if (result == 0) _exit(3);
+            char *post = describe();
+            if (strcmp(pre, post) != 0) {
+                fprintf(stderr, "k=%lld: state not restored\n", k);
+                print_diff(pre, post);
+                _exit(1);
+            }
+            int result_again = create(1);
+            char *occupancy = get_occupancy(describe());
+            if (result_again != 0 || strcmp(occupancy, clean_occupancy) != 0) {
+                fprintf(stderr, "k=%lld: create after rollback %d %s vs %s\n", k, result_again, occupancy, clean_occupancy);
+                _exit(1);
+            }
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 2) break;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 3) continue;
+        num_injected++;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            num_failures++;
+            if (!WIFEXITED(status)) fprintf(stderr, "k=%lld: crashed, signal %d\n", k, WTERMSIG(status));
+        }
+    }
+    printf("rollback: %d injected failures, %d not rolled back\n", num_injected, num_failures);
+    return num_failures != 0;
+}
+
+/**
+ *  Returns 0 if the list of returned objects of every pool holds as many distinct objects of the pool
+ *  as it counts, all of which have been handed out or retyped before.
+ */
+static int
+check_free_lists(void)
+{
+    static bool listed[NUM_OWNED_CAPS];
+    memset(listed, 0, sizeof(listed));
+    for (uint64_t pool = 0; pool < NUM_POOLS; pool++) {
+        pool_allocator *allocator = &alloc_state.pools[pool];
+        uint64_t num_listed = 0;
+        for (uint64_t c = allocator->free_cap; c != 0; c = alloc_state.next_free_pool_caps[c - BASE_TCB_POOL]) {
+            bool handed_out = c >= sel4cp_internal_pool_bases[pool] && c < sel4cp_internal_pool_bases[pool] + allocator->num_handed_out;
+            bool retyped = c >= BASE_RETYPED_CAP && c < BASE_RETYPED_CAP + alloc_state.num_retyped_caps &&
+                           alloc_state.retyped_cap_pools[c - BASE_RETYPED_CAP] == pool;
+            if ((!handed_out && !retyped) || listed[c - BASE_TCB_POOL] || num_listed == allocator->num_free) {
+                return -1;
+            }
+            listed[c - BASE_TCB_POOL] = true;
+            num_listed++;
+        }
+        if (num_listed != allocator->num_free) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+test_churn(char *pre)
+{
+    // A second PD running the same program shares its read-only segments, unless the program has memory regions.
+    int num_shared = 0;
+    for (int i = 0; i < NUM_CHURN_CYCLES; i++) {
+        if (create(11) != 0) {
+            printf("churn %d: create 11 failed\n", i);
+            return 1;
+        }
+        if (create(12) == 0) {
+            num_shared++;
+            // Dirty the pages of the second PD, as if it had run.
+            for (uint64_t c = sel4cp_internal_next_pool_cap(PAGE_POOL_ID, 0); c != 0; c = sel4cp_internal_next_pool_cap(PAGE_POOL_ID, c)) {
+                if (alloc_state.cap_owners[c - BASE_TCB_POOL] == 13) frame_mem(caps[lookup(c)].obj)[100] = 1;
+            }
+            if (sel4cp_pd_destroy(11) != 0) {
+                printf("churn %d: destroy 11 failed\n", i);
+                return 1;
+            }
+            if (create(11) != 0) {
+                printf("churn %d: create 11 again failed\n", i);
+                return 1;
+            }
+            if (sel4cp_pd_destroy(12) != 0) {
+                printf("churn %d: destroy 12 failed\n", i);
+                return 1;
+            }
+        }
+        if (sel4cp_pd_destroy(11) != 0) {
+            printf("churn %d: destroy failed\n", i);
+            return 1;
+        }
+        if (sel4cp_pd_destroy(11) != -1) {
+            printf("churn %d: destroyed twice\n", i);
+            return 1;
+        }
+        if (check_free_lists() != 0) {
+            printf("churn %d: the list of returned objects of a pool is corrupt\n", i);
+            return 1;
+        }
+        char *post = describe();
+        // With untyped memory, the first cycle retypes the objects for the second PD, which stay in the pools.
+        if (i == 0 && getenv("WARM")) {
+            pre = post;
+            continue;
+        }
+        if (strcmp(pre, post) != 0) {
+            print_diff(pre, post);
+            printf("churn %d: state not restored\n", i);
+            return 1;
+        }
+        free(post);
+    }
+    printf("churn: %d cycles (%d with a second PD), state restored\n", NUM_CHURN_CYCLES, num_shared);
+    return 0;
+}
+
+static int
+test_evict(void)
+{
+    setenv("EVICT", "1", 1);
+    if (create(1) != 0) {
+        printf("evict: create failed\n");
+        return 1;
+    }
+    elf_header *elf_hdr = (elf_header *)prog;
+    uint64_t num_checked = 0;
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(prog + elf_hdr->e_phoff + i * elf_hdr->e_phentsize);
+        if (prog_hdr->p_type != PT_LOAD) continue;
+        for (uint64_t j = 0; j < prog_hdr->p_filesz; j++) {
+            uint64_t vaddr = prog_hdr->p_vaddr + j;
+            uint64_t cap_idx = sel4cp_internal_find_page(2, vaddr);
+            for (uint64_t k = 0; cap_idx == 0 && k < alloc_state.num_shared_segments; k++) {
+                cap_idx = sel4cp_internal_find_page(SHARED_SEGMENT_OWNER + k, vaddr);
+            }
+            if (cap_idx == 0) {
+                printf("evict: no page at %lx\n", vaddr);
+                return 1;
+            }
+            if (frame_mem(caps[lookup(cap_idx)].obj)[vaddr % 0x1000] != prog[prog_hdr->p_offset + j]) {
+                printf("evict: wrong byte at %lx\n", vaddr);
+                return 1;
+            }
+            num_checked++;
+        }
+    }
+    printf("evict: %lu bytes loaded correctly\n", num_checked);
+    return 0;
+}
+
+static int
+test_trunc(void)
+{
+    uint64_t offset = *((uint64_t *)(prog + EI_ACCESS_RIGHT_TABLE_OFFSET_IDX - 1)) >> 8;
+    access_right_table table;
+    if (sel4cp_internal_decode_access_rights(prog, prog_size, &table) != 0) {
+        printf("trunc: full file rejected\n");
+        return 1;
+    }
+    // Each copy is allocated with its exact size, such that reading past it is caught with AddressSanitizer.
+    int num_accepted = 0;
+    for (uint64_t n = offset; n < prog_size; n++) {
+        uint8_t *copy = malloc(n);
+        memcpy(copy, prog, n);
+        num_accepted += sel4cp_internal_decode_access_rights(copy, n, &table) == 0;
+        free(copy);
+    }
+    bool v1 = ((access_right_table_header *)(prog + offset))->magic != ACCESS_RIGHT_TABLE_MAGIC;
+    uint8_t *copy = malloc(prog_size);
+    memcpy(copy, prog, prog_size);
+    if (v1) {
+        memset(copy + offset, 0xff, 8);
+    }
+    else {
+        ((access_right_table_header *)(copy + offset))->size = 0xffffffff;
+    }
+    if (sel4cp_internal_decode_access_rights(copy, prog_size, &table) != -1) {
+        printf("trunc: corrupt table accepted\n");
+        return 1;
+    }
+    printf("trunc: %s table, %d truncated files accepted\n", v1 ? "v1" : "v2", num_accepted);
+    return num_accepted != 0;
+}
+
+static int
+test_ids(void)
+{
+    // PD 2 exists in the system.
+    put_root(BASE_TCB_CAP + 2, T_TCB, 0);
+    char *pre = describe();
+    int invalid_pds[] = { 0, 2, SEL4CP_MAX_PDS + 1, 255 };
+    for (int i = 0; i < 4; i++) {
+        if (create(invalid_pds[i]) != -1) {
+            printf("ids: create %d succeeded\n", invalid_pds[i]);
+            return 1;
+        }
+    }
+    if (strcmp(pre, describe()) != 0) {
+        printf("ids: state changed\n");
+        return 1;
+    }
+    // The check for an existing PD does not keep the copy of its TCB capability in a temp CSlot.
+    for (int i = 0; i < NUM_TEMP_CAPS; i++) {
+        if (lookup(BASE_TEMP_CAP + i) != 0 && caps[lookup(BASE_TEMP_CAP + i)].type == T_TCB) {
+            printf("ids: the TCB capability of PD 2 is left in a temp CSlot\n");
+            return 1;
+        }
+    }
+    if (create(1) != 0) {
+        printf("ids: create 1 failed\n");
+        return 1;
+    }
+    char *mid = describe();
+    if (create(1) != -1) {
+        printf("ids: create 1 twice succeeded\n");
+        return 1;
+    }
+    if (strcmp(mid, describe()) != 0) {
+        print_diff(mid, describe());
+        printf("ids: second create changed the state\n");
+        return 1;
+    }
+    sel4cp_elf_stream stream;
+    if (sel4cp_pd_stream_init(&stream, 1, NULL, 0) != -1 || sel4cp_pd_stream_init(&stream, SEL4CP_MAX_PDS + 1, NULL, 0) != -1) {
+        printf("ids: stream init succeeded\n");
+        return 1;
+    }
+    if (sel4cp_pd_destroy(1) != 0 || strcmp(pre, describe()) != 0) {
+        printf("ids: destroy did not restore\n");
+        return 1;
+    }
+    printf("ids: invalid ids rejected\n");
+    return 0;
+}
+
+static int
+test_utcap(void)
+{
+#if SEL4CP_NUM_UNTYPED_CAPS > 0
+    // The CSlots for retyped objects are shared by all pools, so a creation needing more than are left is rejected up front.
+    alloc_state.num_retyped_caps = NUM_RETYPED_CAPS - 4;
+    char *pre = describe();
+    long long num_retyped = n_retyped;
+    if (create(1) != -1 || n_retyped != num_retyped || strcmp(pre, describe()) != 0) {
+        printf("utcap: creation with too few CSlots not rejected up front\n");
+        return 1;
+    }
+    // An untyped capability without room for a page is still used for smaller objects.
+    alloc_state.num_retyped_caps = 0;
+    objs[caps[lookup(BASE_UNTYPED_CAP)].obj].ut_free = 0x800 + 0x20;
+    if (sel4cp_internal_retype_pool_cap(PAGE_POOL_ID) != 0 || alloc_state.exhausted_untyped_caps & 1) {
+        printf("utcap: page retyped or untyped exhausted\n");
+        return 1;
+    }
+    if (sel4cp_internal_retype_pool_cap(TCB_POOL_ID) == 0 || sel4cp_internal_retype_pool_cap(NOTIFICATION_POOL_ID) == 0) {
+        printf("utcap: small objects not retyped\n");
+        return 1;
+    }
+    if (sel4cp_internal_retype_pool_cap(NOTIFICATION_POOL_ID) != 0 || !(alloc_state.exhausted_untyped_caps & 1)) {
+        printf("utcap: full untyped not exhausted\n");
+        return 1;
+    }
+    printf("utcap: shared CSlots counted once, untyped exhausted by the smallest object\n");
+    return 0;
+#else
+    printf("utcap: requires SEL4CP_NUM_UNTYPED_CAPS > 0\n");
+    return 1;
+#endif
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: %s <file> <mode> [rollback|churn|evict|trunc|ids|utcap]\n", argv[0]);
+        return 1;
+    }
+    prog = read_file(argv[1], &prog_size);
+    mode = atoi(argv[2]);
+    const char *test = argc == 4 ? argv[3] : "rollback";
+    setup();
+
+    if (strcmp(test, "trunc") == 0) {
+        return test_trunc();
+    }
+    if (getenv("FULL")) {
+        for (int p = 0; p < NUM_POOLS; p++) alloc_state.pools[p].num_handed_out = sel4cp_internal_pool_sizes[p];
+    }
+    if (getenv("NOMR") && mode == 0) {
+        access_right_table table;
+        if (sel4cp_internal_decode_access_rights(prog, prog_size, &table)) {
+            abort();
+        }
+        access_right_header *hdr = sel4cp_internal_get_access_rights(&table, MEMORY_REGION_ID);
+        for (uint64_t i = 0; i < table.index[MEMORY_REGION_ID].num_access_rights; i++) {
+            ((memory_region_access_right *)hdr)->size = 0;
+            hdr = (access_right_header *)((uint8_t *)hdr + hdr->size);
+        }
+    }
+
+    if (getenv("WARM")) {
+        if (create(1) != 0 || sel4cp_pd_destroy(1) != 0) {
+            printf("warm-up failed\n");
+            return 1;
+        }
+    }
+
+    char *pre = describe();
+    if (strcmp(test, "rollback") == 0) return test_rollback(pre);
+    if (strcmp(test, "churn") == 0) return test_churn(pre);
+    if (strcmp(test, "evict") == 0) return test_evict();
+    if (strcmp(test, "ids") == 0) return test_ids();
+    if (strcmp(test, "utcap") == 0) return test_utcap();
+    fprintf(stderr, "%s: unknown test %s\n", argv[0], test);
+    return 1;
+}
@@ -0,0 +1,126 @@
+// A streaming decoder for the LZSS format produced by dynamic_programs/compress_program.py.
+// The decoder keeps the most recently decoded LZSS_WINDOW_SIZE bytes in a fixed window,
+// such that input can be passed in pieces of any size and no heap is required.
+//
+// A flag byte precedes every group of 8 tokens, where bit i (starting from the least significant bit)
+// is set if token i is a match and clear if it is a literal byte.
+// A match is encoded in 2 bytes: the low byte of (offset - 1), followed by a byte holding
+// the high 4 bits of (offset - 1) and (length - LZSS_MIN_MATCH) in the high 4 bits.
+// If the latter is 15, an extra byte with the remaining length follows.
+
+// The size must be a power of two.
+#define LZSS_WINDOW_SIZE 0x1000
+#define LZSS_MIN_MATCH 3
+#define LZSS_EXTENDED_LENGTH_CODE 15
+
+typedef enum {
+    LZSS_READING_FLAGS,
+    LZSS_READING_TOKEN,
+    LZSS_READING_MATCH_HIGH,
+    LZSS_READING_MATCH_EXTRA,
+    LZSS_COPYING_MATCH
+} lzss_decoder_state;
+
+typedef struct {
+    uint8_t window[LZSS_WINDOW_SIZE];
+    uint64_t num_decoded; // the total number of decoded bytes.
+    lzss_decoder_state state;
+    uint8_t flags;
+    uint8_t num_tokens_left; // the number of tokens left in the current group.
+    uint8_t match_low;
+    uint64_t match_offset;
+    uint64_t match_length; // the number of bytes left to copy of the current match.
+    bool failed;
+} lzss_decoder;
+
+void lzss_init(lzss_decoder *dec) {
+    dec->num_decoded = 0;
+    dec->state = LZSS_READING_FLAGS;
+    dec->num_tokens_left = 0;
+    dec->match_length = 0;
+    dec->failed = false;
+}
+
+void lzss_emit(lzss_decoder *dec, uint8_t byte, uint8_t *out, uint64_t *out_idx) {
+    dec->window[dec->num_decoded % LZSS_WINDOW_SIZE] = byte;
+    dec->num_decoded++;
+    out[(*out_idx)++] = byte;
+}
+
+// Marks the current token as decoded.
+void lzss_end_token(lzss_decoder *dec) {
+    dec->num_tokens_left--;
+    dec->flags >>= 1;
+    dec->state = dec->num_tokens_left == 0 ? LZSS_READING_FLAGS : LZSS_READING_TOKEN;
+}
+
+// Starts copying a match once its offset and length are known.
+void lzss_start_match(lzss_decoder *dec) {
+    if (dec->match_offset > dec->num_decoded || dec->match_offset > LZSS_WINDOW_SIZE) {
+        // The match refers to bytes before the start of the data.
+        dec->failed = true;
+        return;
+    }
+    dec->state = LZSS_COPYING_MATCH;
+}
+
+// Decodes bytes from *in, advancing *in and decreasing *in_len by the number of bytes consumed.
+// The decoded bytes are written to out, until either out_size bytes have been written or
+// all input has been consumed and no bytes of a match are left to copy.
+// Returns the number of bytes written to out.
+// If the input is malformed, decoding stops and dec->failed is set.
+uint64_t lzss_decode(lzss_decoder *dec, uint8_t **in, uint64_t *in_len, uint8_t *out, uint64_t out_size) {
+    uint64_t out_idx = 0;
+    while (out_idx < out_size && !dec->failed) {
+        if (dec->state == LZSS_COPYING_MATCH) {
+            uint8_t byte = dec->window[(dec->num_decoded - dec->match_offset) % LZSS_WINDOW_SIZE];
+            lzss_emit(dec, byte, out, &out_idx);
+            if (--dec->match_length == 0) {
+                lzss_end_token(dec);
+            }
+            continue;
+        }
+
+        if (*in_len == 0) {
+            break;
+        }
+        uint8_t byte = **in;
+        (*in)++;
+        (*in_len)--;
+
+        switch (dec->state) {
+            case LZSS_READING_FLAGS:
+                dec->flags = byte;
+                dec->num_tokens_left = 8;
+                dec->state = LZSS_READING_TOKEN;
+                break;
+            case LZSS_READING_TOKEN:
+                if (dec->flags & 1) {
+                    dec->match_low = byte;
+                    dec->state = LZSS_READING_MATCH_HIGH;
+                }
+                else {
+                    lzss_emit(dec, byte, out, &out_idx);
+                    lzss_end_token(dec);
+                }
+                break;
+            case LZSS_READING_MATCH_HIGH:
+                dec->match_offset = (dec->match_low | ((uint64_t)(byte & 0x0f) << 8)) + 1;
+                dec->match_length = (byte >> 4) + LZSS_MIN_MATCH;
+                if ((byte >> 4) == LZSS_EXTENDED_LENGTH_CODE) {
+                    dec->state = LZSS_READING_MATCH_EXTRA;
+                }
+                else {
+                    lzss_start_match(dec);
+                }
+                break;
+            case LZSS_READING_MATCH_EXTRA:
+                dec->match_length += byte;
+                lzss_start_match(dec);
+                break;
+            case LZSS_COPYING_MATCH:
+                break;
+        }
+    }
+    return out_idx;
+}
@@ -0,0 +1,82 @@
+import base64
+import hashlib
+import sys
+import zipfile
+from pathlib import Path
+
+# Builds the `protection_model` wheel from the package source next to this script.
+# VERSION must be increased whenever the source changes, such that installing the new wheel
+# replaces an installed older one without forcing a reinstallation.
+NAME = "protection_model"
+VERSION = "1.0.4"
+SUMMARY = "This library contains protection models for different operating systems and utilities for patching ELF files with access rights."
+AUTHOR_EMAIL = "Tobias Thornfeldt Nissen <tobias.nissen@gmail.com>"
+REQUIREMENTS = ["pathlib", "typing", "dataclasses"]
+ENTRY_POINTS = {
+    "linux_set_up_access_rights": "protection_model.linux.utilities.set_up_access_rights:set_up_access_rights",
+    "sel4cp_set_up_access_rights": "protection_model.sel4cp.utilities.set_up_access_rights:set_up_access_rights",
+}
+TAG = "py2.py3-none-any"
+
+# The timestamp of all files in the wheel, such that building the same source yields the same wheel.
+TIMESTAMP = (2016, 1, 1, 0, 0, 0)
+
+
+def get_metadata() -> str:
+    lines = [
+        "Metadata-Version: 2.1",
+        f"Name: {NAME}",
+        f"Version: {VERSION}",
+        f"Summary: {SUMMARY}",
+        f"Author-email: {AUTHOR_EMAIL}",
+        "Classifier: License :: OSI Approved :: MIT License",
+    ]
+    lines += [f"Requires-Dist: {requirement}" for requirement in REQUIREMENTS]
+    return "\n".join(lines) + "\n\n"
+
+
+def get_wheel_info() -> str:
+    lines = ["Wheel-Version: 1.0", "Generator: build_wheel.py", "Root-Is-Purelib: true", "Tag: py2-none-any", "Tag: py3-none-any"]
+    return "\n".join(lines) + "\n"
+
+
+def get_entry_points() -> str:
+    lines = ["[console_scripts]"] + [f"{name}={target}" for name, target in ENTRY_POINTS.items()]
+    return "\n".join(lines) + "\n\n"
+
+
+def get_record_line(path: str, contents: bytes) -> str:
+    digest = base64.urlsafe_b64encode(hashlib.sha256(contents).digest()).rstrip(b"=").decode()
+    return f"{path},sha256={digest},{len(contents)}"
+
+
+def build_wheel():
+    if len(sys.argv) != 2:
+        sys.exit("Usage: python3 build_wheel.py <output-directory>")
+
+    source_dir = Path(__file__).resolve().parent
+    dist_info = f"{NAME}-{VERSION}.dist-info"
+    files = {}
+    for source_file in sorted((source_dir / NAME).rglob("*.py")):
+        files[source_file.relative_to(source_dir).as_posix()] = source_file.read_bytes()
+    files[f"{dist_info}/entry_points.txt"] = get_entry_points().encode()
+    files[f"{dist_info}/LICENSE"] = (source_dir / "LICENSE").read_bytes()
+    files[f"{dist_info}/WHEEL"] = get_wheel_info().encode()
+    files[f"{dist_info}/METADATA"] = get_metadata().encode()
+
+    record_path = f"{dist_info}/RECORD"
+    record = [get_record_line(path, contents) for path, contents in files.items()] + [f"{record_path},,"]
+    files[record_path] = ("\n".join(record) + "\n").encode()
+
+    wheel_path = Path(sys.argv[1]) / f"{NAME}-{VERSION}-{TAG}.whl"
+    with zipfile.ZipFile(wheel_path, "w", zipfile.ZIP_DEFLATED) as wheel:
+        for path, contents in files.items():
+            info = zipfile.ZipInfo(path, TIMESTAMP)
+            info.external_attr = 0o644 << 16
+            info.compress_type = zipfile.ZIP_DEFLATED
+            wheel.writestr(info, contents)
+    print(f"Built {wheel_path}")
+
+
+if __name__ == "__main__":
+    build_wheel()
@@ -0,0 +1,114 @@
+from ..base.access_right import AccessRight
+from ..utilities.serialization import serialize_8_bit_int, serialize_32_bit_int, serialize_64_bit_int
+from .constants import SCHEDULING_TYPE_ID, CHANNEL_TYPE_ID, MEMORY_REGION_TYPE_ID, IRQ_TYPE_ID, PROTECTION_DOMAIN_CONTROL_TYPE_ID, LARGE_PAGE_MEMORY_REGION_TYPE_ID, LOADER_SYMBOLS_TYPE_ID, IMAGE_HASH_TYPE_ID
+from .constants import PAGE_SIZE, LARGE_PAGE_SIZE, ACCESS_RIGHT_HEADER_SIZE, ACCESS_RIGHT_TABLE_ALIGNMENT
+
+
+class SeL4CPAccessRight(AccessRight):
+    """
+        An access right in the v2 access right table, which starts with a header holding
+        the type id and the size of the access right, and is padded to a multiple of 8 bytes.
+        The fields of the metadata must be naturally aligned, counting from the start of the header.
+    """
+    def serialize(self) -> bytes:
+        metadata = self.serialize_metadata() or b""
+        padding = -len(metadata) % ACCESS_RIGHT_TABLE_ALIGNMENT
+        size = ACCESS_RIGHT_HEADER_SIZE + len(metadata) + padding
+        return self.serialize_type_id() + serialize_32_bit_int(size) + metadata + bytes(padding)
+    
+    def serialize_type_id(self) -> bytes:
+        return serialize_32_bit_int(self.type_id)
+    
+    
+class SchedulingAccessRight(SeL4CPAccessRight):
+    def __init__(self, priority: int, mcp: int, budget: int, period: int):
+        self.type_id = SCHEDULING_TYPE_ID
+        self.priority = priority
+        self.mcp = mcp
+        self.budget = budget
+        self.period = period
+        
+    def serialize_metadata(self) -> bytes | None:
+        return serialize_8_bit_int(self.priority) + \
+               serialize_8_bit_int(self.mcp) + \
+               bytes(6) + \
+               serialize_64_bit_int(self.budget) + \
+               serialize_64_bit_int(self.period)
+    
+    
+class ChannelAccessRight(SeL4CPAccessRight):    
+    def __init__(self, target_pd_id: int, target_pd_channel_id: int, own_channel_id: int):
+        self.type_id = CHANNEL_TYPE_ID
+        self.target_pd_id = target_pd_id # the id of the targeted PD.
+        self.target_pd_channel_id = target_pd_channel_id # the ID used by the targeted PD for the channel.
+        self.own_channel_id = own_channel_id # the ID used by the current PD for the channel.
+        
+    def serialize_metadata(self) -> bytes | None:
+        return serialize_8_bit_int(self.target_pd_id) + \
+               serialize_8_bit_int(self.target_pd_channel_id) + \
+               serialize_8_bit_int(self.own_channel_id)
+
+
+class MemoryRegionAccessRight(SeL4CPAccessRight):
+    def __init__(self, memory_region_page_cap_index: int, vaddr: int, size: int, perms: int, cached: bool, page_size: int = PAGE_SIZE):
+        # A memory region with large pages has its own type id, such that the loader maps the pages as large pages.
+        self.type_id = LARGE_PAGE_MEMORY_REGION_TYPE_ID if page_size == LARGE_PAGE_SIZE else MEMORY_REGION_TYPE_ID
+        self.memory_region_page_cap_index = memory_region_page_cap_index
+        self.vaddr = vaddr
+        self.size = size
+        self.perms = perms
+        self.cached = cached
+    
+    def serialize_metadata(self) -> bytes | None:
+        return serialize_64_bit_int(self.memory_region_page_cap_index) + \
+               serialize_64_bit_int(self.vaddr) + \
+               serialize_64_bit_int(self.size) + \
+               serialize_8_bit_int(self.perms) + \
+               serialize_8_bit_int(self.cached)
+
+
+class IrqAccessRight(SeL4CPAccessRight):
+    def __init__(self, parent_irq_channel_id: int, own_irq_channel_id: int):
+        self.type_id = IRQ_TYPE_ID
+        self.parent_irq_channel_id = parent_irq_channel_id
+        self.own_irq_channel_id = own_irq_channel_id
+        
+    def serialize_metadata(self) -> bytes | None:
+        return serialize_8_bit_int(self.parent_irq_channel_id) + \
+               serialize_8_bit_int(self.own_irq_channel_id)
+
+
+class ProtectionDomainControlAccessRight(SeL4CPAccessRight):
+    def __init__(self):
+        self.type_id = PROTECTION_DOMAIN_CONTROL_TYPE_ID
+       
+    def serialize_metadata(self) -> bytes | None:
+        return None
+
+
+class LoaderSymbolsAccessRight(SeL4CPAccessRight):
+    """
+        Carries the virtual addresses of the symbols needed by the loader,
+        such that the loader does not have to search the symbol table of the ELF file.
+    """
+    def __init__(self, ipc_buffer_vaddr: int, pd_id_vaddr: int):
+        self.type_id = LOADER_SYMBOLS_TYPE_ID
+        self.ipc_buffer_vaddr = ipc_buffer_vaddr # the virtual address of the IPC buffer.
+        self.pd_id_vaddr = pd_id_vaddr # the virtual address of the PD id variable.
+        
+    def serialize_metadata(self) -> bytes | None:
+        return serialize_64_bit_int(self.ipc_buffer_vaddr) + \
+               serialize_64_bit_int(self.pd_id_vaddr)
+
+
+class ImageHashAccessRight(SeL4CPAccessRight):
+    """
+        Carries a hash of the read-only loadable segments of the ELF file, such that the loader
+        can map the pages of these segments of an ELF file it has already loaded instead of copying them.
+    """
+    def __init__(self, image_hash: int):
+        self.type_id = IMAGE_HASH_TYPE_ID
+        self.image_hash = image_hash
+        
+    def serialize_metadata(self) -> bytes | None:
+        return serialize_64_bit_int(self.image_hash)
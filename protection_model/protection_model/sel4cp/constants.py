@@ -0,0 +1,29 @@
+PAGE_SIZE = 0x1000 # 4 KiB
+LARGE_PAGE_SIZE = 0x200000 # 2 MiB
+
+# Bit flags used to indicate how a page should be mapped.
+EXECUTABLE_FLAG = 1
+WRITABLE_FLAG = 2
+READABLE_FLAG = 4
+
+# Access right type_ids for the available access right types.
+SCHEDULING_TYPE_ID = 0
+CHANNEL_TYPE_ID = 1
+MEMORY_REGION_TYPE_ID = 2
+IRQ_TYPE_ID = 3
+PROTECTION_DOMAIN_CONTROL_TYPE_ID = 4
+LARGE_PAGE_MEMORY_REGION_TYPE_ID = 5
+LOADER_SYMBOLS_TYPE_ID = 6
+IMAGE_HASH_TYPE_ID = 7
+NUM_ACCESS_RIGHT_TYPES = 8
+
+# The access right table format (v2): a header, an index with an entry for each access right type,
+# and the access rights grouped by type, each starting with its type id and size and aligned to 8 bytes.
+ACCESS_RIGHT_TABLE_MAGIC = 0x54524153 # "SART" in little-endian.
+ACCESS_RIGHT_TABLE_VERSION = 2
+ACCESS_RIGHT_TABLE_ALIGNMENT = 8
+ACCESS_RIGHT_HEADER_SIZE = 8
+
+# The symbols whose virtual addresses are needed by the loader, which are resolved when patching an ELF file.
+IPC_BUFFER_SYMBOL = "__sel4_ipc_buffer_obj"
+PD_ID_SYMBOL = "sel4cp_current_pd_id"
@@ -0,0 +1,33 @@
+import struct
+
+from ..access_rights import SeL4CPAccessRight
+from ..constants import ACCESS_RIGHT_TABLE_MAGIC, ACCESS_RIGHT_TABLE_VERSION, NUM_ACCESS_RIGHT_TYPES
+
+# The header of the table: the magic number, the version, the number of index entries,
+# the number of access rights, and the size of the table in bytes.
+HEADER_FORMAT = "<IHHII"
+# An index entry: the offset from the start of the table of the first access right of the type,
+# and the number of access rights of the type.
+INDEX_ENTRY_FORMAT = "<II"
+
+
+def serialize_access_right_table(access_rights: list[SeL4CPAccessRight]) -> bytes:
+    """
+        Serializes the given access rights into a v2 access right table,
+        such that the loader can look up the access rights of each type through the index.
+    """
+    records_by_type = [[access_right.serialize() for access_right in access_rights if access_right.type_id == type_id] 
+                       for type_id in range(NUM_ACCESS_RIGHT_TYPES)]
+    if sum(len(records) for records in records_by_type) != len(access_rights):
+        raise ValueError("unknown access right type")
+    
+    index = b""
+    body = b""
+    offset = struct.calcsize(HEADER_FORMAT) + NUM_ACCESS_RIGHT_TYPES * struct.calcsize(INDEX_ENTRY_FORMAT)
+    for records in records_by_type:
+        index += struct.pack(INDEX_ENTRY_FORMAT, offset + len(body) if records else 0, len(records))
+        body += b"".join(records)
+    
+    header = struct.pack(HEADER_FORMAT, ACCESS_RIGHT_TABLE_MAGIC, ACCESS_RIGHT_TABLE_VERSION, NUM_ACCESS_RIGHT_TYPES, 
+                         len(access_rights), offset + len(body))
+    return header + index + body
@@ -0,0 +1,48 @@
+import sys
+from pathlib import Path
+
+from .system_parser import parse_system
+from .access_rights_parser import parse_access_rights
+from .access_rights_prompter import get_access_rights
+from .access_right_table import serialize_access_right_table
+from ..access_rights import LoaderSymbolsAccessRight, ImageHashAccessRight
+from ..constants import IPC_BUFFER_SYMBOL, PD_ID_SYMBOL, ACCESS_RIGHT_TABLE_ALIGNMENT
+from ...utilities.elf_patcher import write_access_right_table, get_symbol_vaddrs, strip_elf, hash_read_only_segments
+
+def set_up_access_rights():
+    args = sys.argv[1:]
+    # Stripping removes the section headers and the symbol table, which the loader does not need
+    # when the addresses of its symbols are part of the access rights.
+    strip = len(args) > 0 and args[0] == "--strip"
+    if strip:
+        args = args[1:]
+    num_args = len(args)
+    if num_args != 2 and num_args != 3:
+        sys.exit(f"Usage: python3 set_up_access_rights.py [--strip] <target_ELF_file> <system_configuration_file> [<ELF_access_rights_file>]")
+    
+    target_elf = Path(args[0])
+    system_file = Path(args[1])
+    
+    symbol_vaddrs = get_symbol_vaddrs(target_elf, [IPC_BUFFER_SYMBOL, PD_ID_SYMBOL])
+    for symbol in (IPC_BUFFER_SYMBOL, PD_ID_SYMBOL):
+        if symbol not in symbol_vaddrs:
+            sys.exit(f"Failed to find the symbol {symbol} in {target_elf}, which must not have been stripped")
+    
+    system_description = parse_system(system_file)
+    
+    if num_args == 3: # read the access rights from the provided file.
+        elf_access_rights_file = Path(args[2])
+        access_rights = parse_access_rights(elf_access_rights_file, system_description)
+    else: # get the access rights interactively from the user.
+        access_rights = get_access_rights(system_description)
+    
+    access_rights.append(LoaderSymbolsAccessRight(symbol_vaddrs[IPC_BUFFER_SYMBOL], symbol_vaddrs[PD_ID_SYMBOL]))
+    access_rights.append(ImageHashAccessRight(hash_read_only_segments(target_elf)))
+    
+    if strip:
+        strip_elf(target_elf)
+    write_access_right_table(target_elf, serialize_access_right_table(access_rights), ACCESS_RIGHT_TABLE_ALIGNMENT)
+    
+    
+    
+    
@@ -0,0 +1,136 @@
+import hashlib
+import os
+import struct
+from pathlib import Path
+from ..base.access_right import AccessRight
+from ..base.constants import EI_ACCESS_RIGHTS_OFFSET_IDX
+
+# The layouts of the structures of a 64-bit little-endian ELF file.
+ELF_HEADER_FORMAT = "<16sHHIQQQIHHHHHH"
+PROGRAM_HEADER_FORMAT = "<IIQQQQQQ"
+SECTION_HEADER_FORMAT = "<IIQQQQIIQQ"
+SYMBOL_FORMAT = "<IBBHQQ"
+SHT_SYMTAB = 2
+PT_LOAD = 1
+PF_W = 2
+
+
+def patch_elf(target_elf: Path, access_rights: list[AccessRight]) -> None:
+    """
+        Patches the given ELF file with the given access rights.
+    """
+    # Write the total number of access rights, followed by the serialized access rights.
+    table = struct.pack("<Q", len(access_rights))
+    for access_right in access_rights:
+        table += access_right.serialize()
+    
+    write_access_right_table(target_elf, table)
+
+
+def write_access_right_table(target_elf: Path, table: bytes, alignment: int = 1) -> None:
+    """
+        Patches the given ELF file with the given serialized access right table,
+        which is placed at an offset that is a multiple of the given alignment.
+    """
+    with open(target_elf, "rb+") as elf:
+        # Read the offset of the access rights in the given ELF file,
+        # taking into account that the offset is only 7 bytes long.
+        elf.seek(EI_ACCESS_RIGHTS_OFFSET_IDX - 1)
+        access_rights_offset_str = elf.read(8)
+        (access_rights_offset, ) = struct.unpack("<Q" , access_rights_offset_str)
+        access_rights_offset >>= 8
+        
+        # Any old access rights are replaced, so the table is placed where they start or at the end of the ELF file.
+        if access_rights_offset == 0:
+            access_rights_offset = elf.seek(0, os.SEEK_END)
+        padding = -access_rights_offset % alignment
+        
+        # Write the offset of the access rights section to the ELF file.
+        elf.seek(EI_ACCESS_RIGHTS_OFFSET_IDX)
+        elf.write(struct.pack("<Q", access_rights_offset + padding)[0:7])
+        
+        elf.seek(access_rights_offset)
+        elf.write(bytes(padding))
+        elf.write(table)
+        
+        # Ensure that any old access rights are deleted.
+        elf.truncate()
+
+
+def get_symbol_vaddrs(target_elf: Path, symbol_names: list[str]) -> dict[str, int]:
+    """
+        Returns the virtual addresses of the given symbols in the symbol table of the given ELF file.
+        Symbols that are not found are left out.
+    """
+    data = Path(target_elf).read_bytes()
+    elf_header = struct.unpack_from(ELF_HEADER_FORMAT, data)
+    e_shoff, e_shentsize, e_shnum = elf_header[6], elf_header[11], elf_header[12]
+    
+    section_headers = [struct.unpack_from(SECTION_HEADER_FORMAT, data, e_shoff + i * e_shentsize) for i in range(e_shnum)]
+    symbol_vaddrs = {}
+    for section_header in section_headers:
+        if section_header[1] != SHT_SYMTAB:
+            continue
+        sh_offset, sh_size, sh_link, sh_entsize = section_header[4], section_header[5], section_header[6], section_header[9]
+        string_table_offset = section_headers[sh_link][4]
+        for offset in range(sh_offset, sh_offset + sh_size, sh_entsize):
+            st_name, _, _, _, st_value, _ = struct.unpack_from(SYMBOL_FORMAT, data, offset)
+            name_start = string_table_offset + st_name
+            name = data[name_start:data.index(b"\0", name_start)].decode()
+            if name in symbol_names:
+                symbol_vaddrs[name] = st_value
+    
+    return symbol_vaddrs
+
+
+def strip_elf(target_elf: Path) -> None:
+    """
+        Removes the section headers and everything following the loadable segments from the given ELF file,
+        including the symbol table and any access rights, such that only what is needed to load the ELF file is kept.
+    """
+    with open(target_elf, "rb+") as elf:
+        data = elf.read()
+        elf_header = list(struct.unpack_from(ELF_HEADER_FORMAT, data))
+        e_phoff, e_phentsize, e_phnum = elf_header[5], elf_header[9], elf_header[10]
+        
+        # Keep the headers and the bytes of all segments.
+        end = e_phoff + e_phnum * e_phentsize
+        for i in range(e_phnum):
+            program_header = struct.unpack_from(PROGRAM_HEADER_FORMAT, data, e_phoff + i * e_phentsize)
+            p_offset, p_filesz = program_header[2], program_header[5]
+            end = max(end, p_offset + p_filesz)
+        
+        # Clear the offset of the access rights, the offset of the section headers, 
+        # the number of section headers, and the index of the section name string table.
+        e_ident = bytearray(elf_header[0])
+        e_ident[EI_ACCESS_RIGHTS_OFFSET_IDX:EI_ACCESS_RIGHTS_OFFSET_IDX + 7] = bytes(7)
+        elf_header[0] = bytes(e_ident)
+        elf_header[6] = 0
+        elf_header[12] = 0
+        elf_header[13] = 0
+        
+        elf.seek(0)
+        elf.write(struct.pack(ELF_HEADER_FORMAT, *elf_header))
+        elf.truncate(end)
+
+
+def hash_read_only_segments(target_elf: Path) -> int:
+    """
+        Returns a 64-bit hash of the read-only loadable segments of the given ELF file,
+        covering the virtual address, the sizes, the flags, and the bytes of each segment.
+    """
+    data = Path(target_elf).read_bytes()
+    elf_header = struct.unpack_from(ELF_HEADER_FORMAT, data)
+    e_phoff, e_phentsize, e_phnum = elf_header[5], elf_header[9], elf_header[10]
+    
+    sha256 = hashlib.sha256()
+    for i in range(e_phnum):
+        program_header = struct.unpack_from(PROGRAM_HEADER_FORMAT, data, e_phoff + i * e_phentsize)
+        p_type, p_flags, p_offset, p_vaddr, _, p_filesz, p_memsz, _ = program_header
+        if p_type != PT_LOAD or p_flags & PF_W:
+            continue
+        sha256.update(struct.pack("<QQQI", p_vaddr, p_filesz, p_memsz, p_flags))
+        sha256.update(data[p_offset:p_offset + p_filesz])
+    
+    return int.from_bytes(sha256.digest()[0:8], "little")
+
@@ -2,60 +2,191 @@
 #include <sel4cp.h>
 
 #include "uart.h"
+#include "timer.h"
+#include "lzss.h"
 #include "elf_loader.h"
 
 #define UART_IRQ_CHANNEL_ID 0
 #define CHILD_PD_ID 1
 
+// The size of the staged_images memory region in configuration.system.
+#define STAGED_IMAGES_SIZE 0x200000
+// The size of the image_cache memory region in configuration.system.
+#define IMAGE_CACHE_SIZE 0x200000
+
+// Set to 1 by `make LAZY_STAGED=1` to load the pages of the staged programs when they are first accessed.
+#ifndef LAZY_STAGED
+#define LAZY_STAGED 0
+#endif
+// Set by `make CHURN_STAGED=<n>` to destroy and create the staged programs again n times after starting them.
+#ifndef CHURN_STAGED
+#define CHURN_STAGED 0
+#endif
+
 uint8_t *test_region_vaddr;
 uint8_t *uart_base_vaddr;
+uint8_t *staged_images_vaddr;
+uint8_t *image_cache_vaddr;
+
+static void
+print_start_time(uint64_t start_ticks)
+{
+    uart_dbg_puts("root: time to start the program: ");
+    uart_dbg_puthex64(timer_ticks_to_us(timer_get_ticks() - start_ticks));
+    uart_dbg_puts(" us\n");
+}
+
+/**
+ *  Starts the programs that have been staged in the staged_images memory region
+ *  by `make run-staged`, loading them directly from the region.
+ *  With LAZY_STAGED, only the pages needed to start the programs are loaded,
+ *  and the remaining pages are loaded from the region in fault().
+ */
+static void
+load_staged_programs(void)
+{
+    sel4cp_bundle_header *header = (sel4cp_bundle_header *)staged_images_vaddr;
+    if (header->magic != SEL4CP_BUNDLE_MAGIC) {
+        return;
+    }
+    
+    uint64_t start_ticks = timer_get_ticks();
+    int num_started = LAZY_STAGED ? sel4cp_pd_create_bundle_lazy(staged_images_vaddr, STAGED_IMAGES_SIZE) 
+                                  : sel4cp_pd_create_bundle(staged_images_vaddr, STAGED_IMAGES_SIZE);
+    if (num_started < 0) {
+        uart_dbg_puts("root: the staged programs are malformed\n");
+        return;
+    }
+    uart_dbg_puts("root: started ");
+    uart_dbg_puthex64(num_started);
+    uart_dbg_puts(" of ");
+    uart_dbg_puthex64(header->num_programs);
+    uart_dbg_puts(" staged programs\n");
+    print_start_time(start_ticks);
+}
+
+/**
+ *  Prints the number of objects in use in each pool of root_domain, in the order of the pool indices.
+ */
+static void
+print_pool_occupancy(void)
+{
+    uart_dbg_puts("root: objects in use in the pools:");
+    for (uint64_t i = 0; i < NUM_POOLS; i++) {
+        uart_dbg_puts(" ");
+        uart_dbg_puthex64(sel4cp_pool_get_num_used(i));
+    }
+    uart_dbg_puts("\n");
+}
+
+/**
+ *  Destroys the PDs of the staged programs and creates them again CHURN_STAGED times,
+ *  which only succeeds if the objects of the destroyed PDs are returned to the pools,
+ *  and reports the average time of a cycle and the objects in use in the pools before and after.
+ */
+static void
+churn_staged_programs(void)
+{
+    sel4cp_bundle_header *header = (sel4cp_bundle_header *)staged_images_vaddr;
+    if (CHURN_STAGED == 0 || header->magic != SEL4CP_BUNDLE_MAGIC) {
+        return;
+    }
+    
+    sel4cp_bundle_entry *entries = (sel4cp_bundle_entry *)(staged_images_vaddr + sizeof(sel4cp_bundle_header));
+    print_pool_occupancy();
+    uint64_t num_cycles = 0;
+    uint64_t start_ticks = timer_get_ticks();
+    for (uint64_t i = 0; i < CHURN_STAGED; i++) {
+        for (uint64_t j = 0; j < header->num_programs; j++) {
+            sel4cp_pd_destroy(entries[j].pd_id);
+        }
+        int num_started = LAZY_STAGED ? sel4cp_pd_create_bundle_lazy(staged_images_vaddr, STAGED_IMAGES_SIZE) 
+                                      : sel4cp_pd_create_bundle(staged_images_vaddr, STAGED_IMAGES_SIZE);
+        if (num_started != (int)header->num_programs) {
+            uart_dbg_puts("root: failed to create the staged programs again in cycle ");
+            uart_dbg_puthex64(i);
+            uart_dbg_puts("\n");
+            break;
+        }
+        num_cycles++;
+    }
+    uint64_t num_us = timer_ticks_to_us(timer_get_ticks() - start_ticks);
+    
+    uart_dbg_puts("root: destroyed and created the staged programs ");
+    uart_dbg_puthex64(num_cycles);
+    uart_dbg_puts(" of ");
+    uart_dbg_puthex64(CHURN_STAGED);
+    uart_dbg_puts(" times, average time per cycle: ");
+    uart_dbg_puthex64(num_cycles == 0 ? 0 : num_us / num_cycles);
+    uart_dbg_puts(" us\n");
+    print_pool_occupancy();
+}
 
 void
 init(void)
 {
     uart_init();
-    sel4cp_dbg_puts("root: initialized!\n");
-    sel4cp_dbg_puts("root: writing 42 (0x2a) to shared memory region!\n");
+    elf_loader_init(CHILD_PD_ID);
+    elf_loader_set_cache(image_cache_vaddr, IMAGE_CACHE_SIZE);
+    uart_dbg_puts("root: initialized!\n");
+    uart_dbg_puts("root: writing 42 (0x2a) to shared memory region!\n");
     *test_region_vaddr = 42;
     
-    sel4cp_dbg_puts("root: ready to receive ELF file to load dynamically!\n");
+    load_staged_programs();
+    churn_staged_programs();
+    
+    uart_dbg_puts("root: ready to receive ELF file to load dynamically!\n");
 }
 
 void
 notified(sel4cp_channel channel)
 {
     if (channel != UART_IRQ_CHANNEL_ID) {
-        sel4cp_dbg_puts("root: got notified by unknown channel!\n");
+        uart_dbg_puts("root: got notified by unknown channel!\n");
         return;
     }
     
     uart_handle_irq();
-    char c = uart_get_char();
+    elf_loader_result result = elf_loader_handle_uart_input();
     sel4cp_irq_ack(channel);
     
-    uint8_t *elf_vaddr = elf_loader_handle_input(c);
-    if (elf_vaddr) {
-        if (sel4cp_pd_create(CHILD_PD_ID, elf_vaddr)) {
-            sel4cp_dbg_puts("root: failed to create a new PD with id ");
-            sel4cp_dbg_puthex64(CHILD_PD_ID);
-            sel4cp_dbg_puts(" and load the provided ELF file\n");
-            return;
-        }
-        sel4cp_dbg_puts("root: successfully started the program in a new child PD\n");
+    if (result == ELF_LOADER_PD_FAILED) {
+        uart_dbg_puts("root: failed to create a new PD with id ");
+        uart_dbg_puthex64(elf_loader_get_target_pd());
+        uart_dbg_puts(" and load the provided ELF file\n");
+    }
+    else if (result == ELF_LOADER_PD_STARTED) {
+        uart_dbg_puts("root: successfully started the program in a new child PD\n");
+        print_start_time(elf_loader_get_start_ticks());
     }
 }
 
 void
 fault(sel4cp_pd pd, sel4cp_msginfo msginfo)
 {
-    sel4cp_dbg_puts("root: received fault message for pd: ");
-    sel4cp_dbg_puthex64(pd);
-    sel4cp_dbg_puts("\n");
-    sel4cp_dbg_puts("root: label = ");
-    sel4cp_dbg_puthex64(sel4cp_msginfo_get_label(msginfo));
-    sel4cp_dbg_puts("\n");
-    sel4cp_dbg_puts("root: fault_addr = ");
-    sel4cp_dbg_puthex64(seL4_GetMR(seL4_CapFault_Addr));
-    sel4cp_dbg_puts("\n");
+    // Transmit any queued output before the debug output of sel4cp_pd_handle_fault.
+    uart_tx_drain();
+    if (sel4cp_pd_handle_fault(pd, msginfo)) {
+        // Only report powers of two, such that printing does not dominate the time spent on loading pages.
+        uint64_t num_pages = sel4cp_pd_get_num_demand_faulted_pages(pd);
+        if ((num_pages & (num_pages - 1)) == 0) {
+            uart_dbg_puts("root: demand-faulted pages of pd ");
+            uart_dbg_puthex64(pd);
+            uart_dbg_puts(": ");
+            uart_dbg_puthex64(num_pages);
+            uart_dbg_puts("\n");
+        }
+        return;
+    }
+    
+    uart_dbg_puts("root: received fault message for pd: ");
+    uart_dbg_puthex64(pd);
+    uart_dbg_puts("\n");
+    uart_dbg_puts("root: label = ");
+    uart_dbg_puthex64(sel4cp_msginfo_get_label(msginfo));
+    uart_dbg_puts("\n");
+    uart_dbg_puts("root: fault_addr = ");
+    uart_dbg_puthex64(seL4_GetMR(seL4_CapFault_Addr));
+    uart_dbg_puts("\n");
 }
 
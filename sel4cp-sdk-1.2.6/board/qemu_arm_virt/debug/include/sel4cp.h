@@ -30,6 +30,20 @@
 #define MEMORY_REGION_ID 2
 #define IRQ_ID 3
 #define PROTECTION_DOMAIN_CONTROL_ID 4
+#define LARGE_PAGE_MEMORY_REGION_ID 5 // a memory region with large pages (2 MiB), which is otherwise the same as MEMORY_REGION_ID.
+#define LOADER_SYMBOLS_ID 6 // the virtual addresses of the IPC buffer and the PD id variable, resolved when patching the ELF file.
+#define LOADER_SYMBOL_IPC_BUFFER_IDX 0 // the index of the address of __sel4_ipc_buffer_obj in the loader symbols access right.
+#define LOADER_SYMBOL_PD_ID_IDX 1 // the index of the address of sel4cp_current_pd_id in the loader symbols access right.
+#define IMAGE_HASH_ID 7 // a hash of the read-only loadable segments, such that their pages can be shared between PDs running the same ELF file.
+#define NUM_ACCESS_RIGHT_TYPES 8
+
+// The access right table format (v2), see protection_model/sel4cp/utilities/access_right_table.py in the wheel.
+// The table starts with a header and an index with an entry for each access right type,
+// followed by the access rights grouped by type, each of which is aligned to 8 bytes.
+// Tables in the original format (v1), i.e. a count followed by packed access rights, are converted to v2 when loaded.
+#define ACCESS_RIGHT_TABLE_MAGIC 0x54524153 // "SART" in little-endian.
+#define ACCESS_RIGHT_TABLE_VERSION 2
+#define MAX_CONVERTED_ACCESS_RIGHT_TABLE_SIZE 0x1000 // the maximum size of a v1 table once converted to v2.
 
 // Constants related to the organization of the CSpace in a PD.
 #define PD_CAP_BITS 11
@@ -45,13 +59,25 @@
 #define POOL_NUM_PAGE_TABLES (POOL_NUM_PD_TARGETS * 6)
 #define POOL_NUM_PAGES (POOL_NUM_PD_TARGETS * 30)
 
+// The maximum number of paging structures that are recorded as mapped: all paging structures in the pools, 
+// and those that were already mapped by the sel4cp tool when the current PD maps a page into its own VSpace.
+#define MAX_MAPPED_PAGING_STRUCTURES (POOL_NUM_PAGE_UPPER_DIRECTORIES + POOL_NUM_PAGE_DIRECTORIES + POOL_NUM_PAGE_TABLES + 16)
+
+// The maximum number of read-only segments that are recorded such that their pages can be shared,
+// i.e. a text and a read-only data segment for each PD in the pools.
+#define MAX_SHARED_SEGMENTS (POOL_NUM_PD_TARGETS * 2)
+
+// The number of pools, i.e. TCBs, notifications, CNodes, SchedContexts, VSpaces, the three kinds of paging structures and pages.
+#define NUM_POOLS 9
+
 // Constants used for addressing specific capabilities in a PD.
 #define INPUT_CAP_IDX 1
 #define FAULT_EP_CAP_IDX 2
 #define REPLY_CAP_IDX 4
 #define ASID_POOL_CAP_IDX 5
 #define SCHED_CONTROL_CAP_IDX 6
-#define TEMP_CAP 8
+// The badge of a fault message received on the input endpoint has this bit set and the id of the faulting PD in its lowest bits.
+#define FAULT_BADGE (1ULL << 62)
 #define BASE_OUTPUT_NOTIFICATION_CAP 10
 #define BASE_OUTPUT_ENDPOINT_CAP (BASE_OUTPUT_NOTIFICATION_CAP + 64)
 #define BASE_IRQ_CAP (BASE_OUTPUT_ENDPOINT_CAP + 64)
@@ -71,14 +97,87 @@
 #define BASE_PAGE_POOL (BASE_PAGE_TABLE_POOL + POOL_NUM_PAGE_TABLES)
 #define BASE_SHARED_MEMORY_REGION_PAGES (BASE_PAGE_POOL + POOL_NUM_PAGES)
 
+// The CSlots for temporary capabilities are the last CSlots of the CNode of a PD, 
+// such that they are not used by the capabilities for shared memory region pages.
+#define NUM_TEMP_CAPS 8
+#define BASE_TEMP_CAP ((1 << PD_CAP_BITS) - NUM_TEMP_CAPS)
+// The CSlots preceding them hold the copies of the pages of read-only segments
+// that are shared with another PD running the same ELF file.
+#define NUM_SHARED_FRAME_CAPS 64
+#define BASE_SHARED_FRAME_CAP (BASE_TEMP_CAP - NUM_SHARED_FRAME_CAPS)
+// The CSlots preceding them hold the objects retyped from untyped memory when the pools run out,
+// see sel4cp_internal_retype_pool_cap, preceded by the untyped capabilities given to the PD, if any.
+// The shared memory region pages end at the first CSlot of the untyped capabilities.
+// At most 64 untyped capabilities can be given to a PD.
+// The sel4cp tool of this SDK does not give untyped capabilities to PDs, so this path is host-only:
+// it is only exercised by the host tests (host_tests/sel4cp_test.c), and systems keep the default of 0.
+#ifndef SEL4CP_NUM_UNTYPED_CAPS
+#define SEL4CP_NUM_UNTYPED_CAPS 0
+#endif
+// No CSlots are set aside for retyped objects unless untyped capabilities are given, i.e. outside of the host tests.
+#define NUM_RETYPED_CAPS (SEL4CP_NUM_UNTYPED_CAPS > 0 ? 512 : 0)
+#define BASE_RETYPED_CAP (BASE_SHARED_FRAME_CAP - NUM_RETYPED_CAPS)
+#define BASE_UNTYPED_CAP (BASE_RETYPED_CAP - SEL4CP_NUM_UNTYPED_CAPS)
+
+// The CSlots whose objects are recorded with the PD they have been given to,
+// i.e. the pools, the shared memory region pages and the retyped objects, see allocation_state.
+#define NUM_OWNED_CAPS (BASE_SHARED_FRAME_CAP - BASE_TCB_POOL)
+// The maximum number of pages handed out by the page pool, including the pages retyped from untyped memory.
+#define MAX_POOL_PAGES (POOL_NUM_PAGES + NUM_RETYPED_CAPS)
+// The pages of the shared segment with index i are recorded with the owner SHARED_SEGMENT_OWNER + i instead of a PD.
+#define SHARED_SEGMENT_OWNER 0x80
+
+// The indices of the pools, in the order of their CSlots.
+#define TCB_POOL_ID 0
+#define NOTIFICATION_POOL_ID 1
+#define CNODE_POOL_ID 2
+#define SCHEDCONTEXT_POOL_ID 3
+#define VSPACE_POOL_ID 4
+#define PAGE_UPPER_DIRECTORY_POOL_ID 5
+#define PAGE_DIRECTORY_POOL_ID 6
+#define PAGE_TABLE_POOL_ID 7
+#define PAGE_POOL_ID 8
+
 // General settings.
 #define SEL4CP_MAX_CHANNELS 63
+#define SEL4CP_MAX_PDS 63
+
+// Limits for ELF files loaded with the streaming interface.
+#define SEL4CP_STREAM_MAX_PROGRAM_HEADERS 16
+
+// The magic number of a bundle of ELF files, see dynamic_programs/bundle_programs.py.
+#define SEL4CP_BUNDLE_MAGIC 0x4c444253 // "SBDL" in little-endian.
+#define SEL4CP_BUNDLE_MAX_PROGRAMS 16
+
+// The magic number of a paged image, see dynamic_programs/page_program.py.
+#define SEL4CP_PAGED_IMAGE_MAGIC 0x49475053 // "SPGI" in little-endian.
+// The kinds of runs of pages in a paged image.
+#define SEL4CP_PAGED_IMAGE_DATA 0 // pages whose contents are part of the image.
+#define SEL4CP_PAGED_IMAGE_ZERO 1 // 0-initialized pages, whose contents are not part of the image.
+#define SEL4CP_PAGED_IMAGE_SHARED 2 // read-only pages whose contents are part of the image, which are shared between PDs running the same program.
+
+// The magic number of a load plan, see dynamic_programs/plan_program.py.
+#define SEL4CP_LOAD_PLAN_MAGIC 0x4e4c5053 // "SPLN" in little-endian.
+// The types of the operations of a load plan, see sel4cp_load_op.
+#define SEL4CP_LOAD_OP_MAP_PAGE_UPPER_DIRECTORY 0 // maps the next page upper directory of the pool covering vaddr.
+#define SEL4CP_LOAD_OP_MAP_PAGE_DIRECTORY 1 // maps the next page directory of the pool covering vaddr.
+#define SEL4CP_LOAD_OP_MAP_PAGE_TABLE 2 // maps the next page table of the pool covering vaddr.
+#define SEL4CP_LOAD_OP_MAP_DATA_PAGES 3 // maps num_pages pages at vaddr, copying their contents from the plan starting at page arg.
+#define SEL4CP_LOAD_OP_MAP_ZERO_PAGES 4 // maps num_pages 0-initialized pages at vaddr.
+#define SEL4CP_LOAD_OP_MAP_SHARED_PAGES 5 // like SEL4CP_LOAD_OP_MAP_DATA_PAGES, but the pages are shared between PDs running the same program.
+#define SEL4CP_LOAD_OP_WRITE_PD_ID 6 // writes the PD id to vaddr, which is part of the pages mapped by the previous operation.
+#define SEL4CP_LOAD_OP_SET_IPC_BUFFER 7 // maps the IPC buffer at vaddr.
+#define SEL4CP_LOAD_OP_SET_UP_ACCESS_RIGHT 8 // sets up the access right at offset arg in the access right table.
 
 // Constants related to paging on ARM
 #define SEL4_ARM_PAGE_CACHEABLE 1
 #define SEL4_ARM_PARITY_ENABLED 2
 #define SEL4_ARM_EXECUTE_NEVER 4
 #define SEL4_ARM_DEFAULT_VMATTRIBUTES 3 // By default, map pages as cacheable and with parity enabled.
+// The bits of the fault status in the FSR of a VM fault, and their value for a translation fault (at any level),
+// i.e. a fault caused by accessing a virtual address without a mapping.
+#define ARM_FSR_STATUS_MASK 0x3c
+#define ARM_FSR_TRANSLATION_FAULT 0x04
 
 
 typedef unsigned int sel4cp_channel;
@@ -131,32 +230,342 @@ typedef struct {
     uint64_t st_value;
     uint64_t st_size;
 } elf_symbol_table_entry;
+/**
+ *  A bundle of ELF files starts with a sel4cp_bundle_header, directly followed by
+ *  a sel4cp_bundle_entry for each ELF file in the bundle.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t num_programs;
+} sel4cp_bundle_header;
+typedef struct {
+    uint32_t pd_id; // the id of the PD to load the ELF file into.
+    uint32_t crc32; // the CRC-32 of the ELF file.
+    uint64_t offset; // the offset of the ELF file from the start of the bundle, which is page-aligned.
+    uint64_t size;
+} sel4cp_bundle_entry;
+/**
+ *  A paged image starts with a sel4cp_paged_image_header, directly followed by a sel4cp_paged_image_run
+ *  for each run of consecutive pages with the same kind and flags, in the order of their virtual addresses.
+ *  The access right table follows at access_rights_offset, and the contents of the pages of the data 
+ *  and shared runs follow at data_offset, one page (4 KiB) after the other in the order of the runs.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t num_runs;
+    uint64_t entry_point;
+    uint32_t access_rights_offset; // the offset of the v2 access right table, which is 8-byte aligned.
+    uint32_t access_rights_size;
+    uint64_t data_offset; // the offset of the contents of the first page, which is page-aligned.
+} sel4cp_paged_image_header;
+typedef struct {
+    uint64_t vaddr; // the virtual address of the first page of the run, which is page-aligned.
+    uint32_t num_pages;
+    uint8_t p_flags; // the ELF program header flags to map the pages with.
+    uint8_t kind; // SEL4CP_PAGED_IMAGE_DATA, SEL4CP_PAGED_IMAGE_ZERO, or SEL4CP_PAGED_IMAGE_SHARED.
+    uint16_t padding;
+} sel4cp_paged_image_run;
+/**
+ *  A load plan starts with a sel4cp_load_plan_header, directly followed by num_ops operations, 
+ *  which load the program when they are executed in order, without interpreting any program headers.
+ *  The access right table follows at access_rights_offset, and the contents of the pages mapped by
+ *  the operations follow at data_offset, one page (4 KiB) after the other.
+ *  The header holds the number of objects the operations take from each pool, 
+ *  such that the pools can be checked before any operation is executed.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t num_ops;
+    uint64_t entry_point;
+    uint32_t access_rights_offset; // the offset of the v2 access right table, which is 8-byte aligned.
+    uint32_t access_rights_size;
+    uint64_t data_offset; // the offset of the contents of the first page, which is page-aligned.
+    uint32_t num_page_upper_directories;
+    uint32_t num_page_directories;
+    uint32_t num_page_tables;
+    uint32_t num_pages; // including the IPC buffer, and the shared pages which are only taken if they have not been loaded before.
+} sel4cp_load_plan_header;
+typedef struct {
+    uint8_t type; // one of the SEL4CP_LOAD_OP_* types.
+    uint8_t p_flags; // the ELF program header flags to map pages with.
+    uint16_t num_pages; // the number of consecutive pages to map.
+    uint32_t arg; // the index of the first page in the contents of the plan, or the offset of an access right.
+    uint64_t vaddr;
+} sel4cp_load_op;
+/**
+ *  A paging structure that is known to be mapped in a VSpace, identified by
+ *  the first virtual address it covers and the number of bits of the virtual addresses it covers,
+ *  i.e. 12 + 9 + 9 + 9 for a page upper directory, 12 + 9 + 9 for a page directory, and 12 + 9 for a page table.
+ */
+typedef struct {
+    uint64_t vspace_cap;
+    uint64_t vaddr;
+    uint8_t num_bits;
+} mapped_paging_structure;
+/**
+ *  A read-only loadable segment that has been loaded, identified by the image hash of its ELF file 
+ *  and its program header. The pages of the segment are recorded with the owner SHARED_SEGMENT_OWNER + i,
+ *  where i is the index of the segment, such that they can be mapped into other PDs running the same ELF file.
+ *  The pages are returned to the page pool once no PD maps them anymore.
+ */
+typedef struct {
+    uint64_t image_hash;
+    uint64_t vaddr;
+    uint64_t memsz;
+    uint32_t p_flags;
+    uint64_t num_pages;
+    sel4cp_pd pd; // the PD the segment has been loaded into, whose VSpace maps the pages themselves.
+    uint64_t num_pds; // the number of PDs mapping the pages, 0 if the segment is no longer recorded.
+} shared_segment;
+/**
+ *  The state of a PD whose pages are loaded on demand, see sel4cp_pd_create_lazy.
+ */
 typedef struct {
-    uint64_t tcb_idx;
-    uint64_t notification_idx;    
-    uint64_t cnode_idx;
-    uint64_t schedcontext_idx;
-    uint64_t vspace_idx;    
-    uint64_t page_upper_directory_idx;
-    uint64_t page_directory_idx;
-    uint64_t page_table_idx;
-    uint64_t page_idx;
-    bool temp_page_prepared;
+    uint8_t *src; // the ELF file the pages are loaded from, NULL if the PD is not loaded on demand.
+    uint64_t num_demand_faulted_pages; // the number of pages loaded when the PD first accessed them.
+} lazy_pd;
+/**
+ *  The allocator of a pool of objects retyped by the sel4cp tool, whose capabilities are in consecutive CSlots
+ *  of the current PD. The objects are handed out in the order of their CSlots, and the objects
+ *  returned to the pool are kept in a list and handed out again first, see sel4cp_internal_allocate_pool_cap.
+ *  Once all of them have been handed out, objects are retyped from the untyped memory of the current PD, if any,
+ *  and become part of the pool.
+ */
+typedef struct {
+    uint64_t num_handed_out; // the number of objects from the start of the pool that have been handed out at least once.
+    uint64_t num_retyped; // the number of objects retyped from untyped memory for the pool.
+    uint64_t free_cap; // the CSlot of the first object in the list of returned objects, 0 if the list is empty.
+    uint64_t num_free; // the number of objects in the list of returned objects.
+} pool_allocator;
+/**
+ *  The journal of the PD being created, see sel4cp_internal_begin_pd_create.
+ *  Everything taken from the pools and set up for the PD is recorded in the allocation state with the PD,
+ *  and in the journal as well, such that reverting the creation only touches what the creation has set up.
+ *  The pages that may no longer be 0-initialized are journaled too.
+ */
+typedef struct {
+    bool active; // true while a PD is being created.
+    sel4cp_pd pd;
+    // The CSlots recorded with the PD by the creation, one bit per CSlot minus BASE_TCB_POOL, 
+    // and the IRQs, one bit per channel id of the current PD, see allocation_state.
+    uint64_t owned_caps[(NUM_OWNED_CAPS + 63) / 64];
+    uint64_t owned_irqs;
+    // The pages of the page pool the current PD has written to, one bit per page index, see sel4cp_internal_get_page_idx,
+    // as all other pages are still 0-initialized.
+    uint64_t written_pages[(MAX_POOL_PAGES + 63) / 64];
+} pd_create_journal;
+typedef struct {
+    // The allocators of the pools, indexed by the pool index, and the lists of objects returned to them,
+    // in which the CSlot following each CSlot is next_free_pool_caps[CSlot - BASE_TCB_POOL], ending with 0.
+    pool_allocator pools[NUM_POOLS];
+    uint16_t next_free_pool_caps[NUM_OWNED_CAPS];
+    // The PD each pool object and shared memory region page has been given to, as pd + 1, 0 if none,
+    // indexed by the CSlot minus BASE_TCB_POOL, see sel4cp_internal_reclaim_pd.
+    uint8_t cap_owners[NUM_OWNED_CAPS];
+    // For each pool object whose capability has been moved to the CNode of its PD, the index 
+    // of the capability among those moved from its pool plus 1, 0 if the capability has not been moved.
+    uint8_t moved_pool_caps[NUM_OWNED_CAPS];
+    // The virtual address each page of the page pool is mapped at in the VSpace of its PD, indexed by the page index.
+    uint64_t page_vaddrs[MAX_POOL_PAGES];
+    // The number of CSlots from BASE_RETYPED_CAP holding objects retyped from untyped memory, and the pool of each object.
+    uint64_t num_retyped_caps;
+    uint8_t retyped_cap_pools[NUM_RETYPED_CAPS];
+    // The untyped capabilities that are not used anymore, one bit per capability, see sel4cp_internal_retype_pool_cap.
+    uint64_t exhausted_untyped_caps;
+    // The PD notified of the IRQ of each channel of the current PD, as pd + 1, 0 if none,
+    // and the channel of that PD the IRQHandler capability has been moved to.
+    uint8_t irq_owners[SEL4CP_MAX_CHANNELS + 1];
+    uint8_t irq_child_channel_ids[SEL4CP_MAX_CHANNELS + 1];
+    bool temp_pages_prepared;
+    uint64_t temp_cap_idx; // the number of CSlots for temporary capabilities allocated so far.
+    bool temp_cap_used[NUM_TEMP_CAPS]; // true if the CSlot for temporary capabilities may hold a capability.
+    uint64_t temp_cap_pages[NUM_TEMP_CAPS]; // the index of the page copied into the CSlot for temporary capabilities, 0 if none.
+    // The paging structures mapped so far, such that each paging structure is only mapped once.
+    uint64_t num_mapped_paging_structures;
+    mapped_paging_structure mapped_paging_structures[MAX_MAPPED_PAGING_STRUCTURES];
+    // The read-only segments loaded so far, such that their pages can be shared.
+    uint64_t num_shared_segments;
+    shared_segment shared_segments[MAX_SHARED_SEGMENTS];
+    // The shared segments mapped into each PD, one bit per segment.
+    uint64_t pd_shared_segments[SEL4CP_MAX_PDS + 1];
 } allocation_state;
 
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_types; // the number of entries in the index, which may include types unknown to the loader.
+    uint32_t num_access_rights;
+    uint32_t size; // the size of the table in bytes, including the header and the index.
+} access_right_table_header;
+
+typedef struct {
+    uint32_t offset; // the offset from the start of the table of the first access right of the type, if any.
+    uint32_t num_access_rights;
+} access_right_index_entry;
+
+typedef struct {
+    uint32_t type_id;
+    uint32_t size; // the size of the access right in bytes, including this header.
+} access_right_header;
+
+typedef struct {
+    access_right_header hdr;
+    uint8_t priority;
+    uint8_t mcp;
+    uint8_t padding[6];
+    uint64_t budget;
+    uint64_t period;
+} scheduling_access_right;
+
+typedef struct {
+    access_right_header hdr;
+    uint8_t target_pd;
+    uint8_t target_id; // the id used by the targeted PD for the channel.
+    uint8_t own_id; // the id used by the PD itself for the channel.
+    uint8_t padding[5];
+} channel_access_right;
+
+typedef struct {
+    access_right_header hdr;
+    uint64_t id; // the index of the first page of the memory region among the shared memory region pages.
+    uint64_t vaddr;
+    uint64_t size;
+    uint8_t perms;
+    uint8_t cached;
+    uint8_t padding[6];
+} memory_region_access_right;
+
+typedef struct {
+    access_right_header hdr;
+    uint8_t parent_irq_channel_id;
+    uint8_t child_irq_channel_id;
+    uint8_t padding[6];
+} irq_access_right;
+
+typedef struct {
+    access_right_header hdr;
+    uint64_t ipc_buffer_vaddr;
+    uint64_t pd_id_vaddr;
+} loader_symbols_access_right;
+
+typedef struct {
+    access_right_header hdr;
+    uint64_t image_hash;
+} image_hash_access_right;
+
+/**
+ *  The access right table of an ELF file, decoded and validated in a single pass
+ *  before it is used to set up a PD, see sel4cp_internal_decode_access_rights.
+ */
+typedef struct {
+    uint8_t *access_rights; // the start of the v2 access right table.
+    access_right_index_entry index[NUM_ACCESS_RIGHT_TYPES]; // the index entries for the types known to the loader.
+    uint64_t num_shared_pages; // the number of memory region pages to copy into the CSpace of the PD.
+    bool has_protection_domain_control;
+    uint64_t ipc_buffer_vaddr;
+    uint64_t pd_id_vaddr;
+    uint64_t image_hash; // only valid if the table has an image hash access right.
+} access_right_table;
+
+/**
+ *  The state of loading an ELF file into a PD while the bytes of the file
+ *  arrive, see sel4cp_pd_stream_init.
+ *  The loadable segments are written directly into the pages of the PD, such that only
+ *  the ELF header, the program headers, and the bytes following the last loadable segment
+ *  (section headers, symbol table, access rights, ...) are kept in the metadata buffer.
+ *  A paged image can be streamed in place of an ELF file, see sel4cp_paged_image_header.
+ */
+typedef struct {
+    sel4cp_pd pd;
+    uint8_t *metadata; // the buffer holding the parts of the ELF file that are not loaded directly.
+    uint64_t metadata_size;
+    uint64_t num_received; // the number of bytes of the ELF file received so far.
+    uint64_t headers_size; // the number of bytes of the ELF header and the program headers, 0 until known.
+    uint64_t tail_offset; // the offset in the ELF file of the first byte following the loadable segments.
+    uint64_t tail_base; // the index in the metadata buffer where the byte at tail_offset is kept.
+    bool headers_loaded; // true once the PD has been created from the headers.
+    bool failed;
+    // The page holding the next byte of the current segment or of the current page of a paged image, 0 if none. 
+    // The write handle for the page is derived again for every write, as the temp page it is mapped at
+    // may be reused in between, e.g. by sel4cp_pd_handle_fault.
+    uint64_t write_page_cap;
+    // The state of loading a paged image, whose headers, access right table and padding are kept in the metadata buffer.
+    bool paged_image; // true if the stream is a paged image rather than an ELF file.
+    access_right_table table; // the decoded access right table of the paged image, which precedes its pages.
+    uint64_t run_idx; // the run the next page of the paged image belongs to.
+    uint64_t run_page_idx; // the number of pages of the run that have been loaded or skipped so far.
+    bool run_mapped; // true if the run has been mapped from a shared segment, in which case its contents are skipped.
+    uint64_t shared_frame_idx; // the CSlot in the CNode of the PD for the next copy of a shared page.
+    uint64_t pd_id_page_cap; // the page holding the PD id variable, 0 until it has been allocated.
+} sel4cp_elf_stream;
+
 static allocation_state alloc_state = { 
-    .tcb_idx = 0,
-    .notification_idx = 0,
-    .cnode_idx = 0,
-    .schedcontext_idx = 0,
-    .vspace_idx = 0,
-    .page_upper_directory_idx = 0,
-    .page_directory_idx = 0,
-    .page_table_idx = 0,
-    .page_idx = 0,
-    .temp_page_prepared = false
+    .pools = {{0}},
+    .temp_pages_prepared = false,
+    .temp_cap_idx = 0,
+    .temp_cap_used = {false},
+    .temp_cap_pages = {0},
+    .num_mapped_paging_structures = 0,
+    .num_shared_segments = 0
+};
+
+// The first CSlot of each pool, followed by the first CSlot after the pools, indexed by the pool index.
+static const uint64_t sel4cp_internal_pool_bases[NUM_POOLS + 1] = {
+    BASE_TCB_POOL,
+    BASE_NOTIFICATION_POOL,
+    BASE_CNODE_POOL,
+    BASE_SCHEDCONTEXT_POOL,
+    BASE_VSPACE_POOL,
+    BASE_PAGE_UPPER_DIRECTORY_POOL,
+    BASE_PAGE_DIRECTORY_POOL,
+    BASE_PAGE_TABLE_POOL,
+    BASE_PAGE_POOL,
+    BASE_SHARED_MEMORY_REGION_PAGES
+};
+
+// The number of objects in each pool, indexed by the pool index.
+static const uint64_t sel4cp_internal_pool_sizes[NUM_POOLS] = {
+    POOL_NUM_TCBS,
+    POOL_NUM_NOTIFICATIONS,
+    POOL_NUM_CNODES,
+    POOL_NUM_SCHEDCONTEXTS,
+    POOL_NUM_VSPACES,
+    POOL_NUM_PAGE_UPPER_DIRECTORIES,
+    POOL_NUM_PAGE_DIRECTORIES,
+    POOL_NUM_PAGE_TABLES,
+    POOL_NUM_PAGES
+};
+
+// The type and size of the objects of each pool when they are retyped from untyped memory, indexed by the pool index.
+static const seL4_Word sel4cp_internal_pool_object_types[NUM_POOLS] = {
+    seL4_TCBObject,
+    seL4_NotificationObject,
+    seL4_CapTableObject,
+    seL4_SchedContextObject,
+    seL4_ARM_VSpaceObject,
+    seL4_ARM_PageUpperDirectoryObject,
+    seL4_ARM_PageDirectoryObject,
+    seL4_ARM_PageTableObject,
+    seL4_ARM_SmallPageObject
+};
+static const seL4_Word sel4cp_internal_pool_object_size_bits[NUM_POOLS] = {
+    0,
+    0,
+    PD_CAP_BITS,
+    seL4_MinSchedContextBits,
+    0,
+    0,
+    0,
+    0,
+    0
 };
 
+// The PDs whose pages are loaded on demand, indexed by their PD id.
+static lazy_pd sel4cp_internal_lazy_pds[SEL4CP_MAX_PDS + 1];
+
+// The journal of the PD being created, such that a PD creation that fails costs no objects.
+static pd_create_journal sel4cp_internal_journal;
+
 /* User-provided functions */
 void init(void);
 void notified(sel4cp_channel ch);
@@ -167,6 +576,8 @@ void fault(sel4cp_channel ch, sel4cp_msginfo msginfo);
 extern char sel4cp_name[16];
 extern sel4cp_pd sel4cp_current_pd_id;
 extern seL4_IPCBuffer *__sel4_ipc_buffer;
+// The temp pages are NUM_TEMP_CAPS consecutive pages following the IPC buffer, 
+// where the page copied into the CSlot BASE_TEMP_CAP + i is mapped at __SEL4_TEMP_PAGE_VADDR + i * 0x1000.
 #define __SEL4_TEMP_PAGE_VADDR ((uint8_t *)__sel4_ipc_buffer + 0x1000)
 
 
@@ -204,13 +615,14 @@ sel4cp_internal_crash(seL4_Error err)
 }
 
 /**
- *  Ensures that the CSlot used for temporary capabilities at index TEMP_CAP is empty.
+ *  Ensures that the CSlot for temporary capabilities with the given index is empty.
+ *  If the CSlot holds a copy of a page capability, the page is unmapped from the current PD.
  */
 static void
-sel4cp_internal_delete_temp_cap(void) {
+sel4cp_internal_delete_temp_cap(uint64_t temp_cap) {
     seL4_Error err = seL4_CNode_Delete(
         BASE_CNODE_CAP + sel4cp_current_pd_id,
-        TEMP_CAP,
+        temp_cap,
         PD_CAP_BITS
     );
     if (err != seL4_NoError) {
@@ -222,35 +634,367 @@ sel4cp_internal_delete_temp_cap(void) {
     }
 }
 
+/**
+ *  Allocates one of the CSlots for temporary capabilities, which are used in turn, 
+ *  such that the capabilities in the most recently allocated CSlots are kept as long as possible.
+ *  The CSlot is emptied first if it may hold a capability.
+ *
+ *  Returns the index of the CSlot in the current PD.
+ */
+static uint64_t
+sel4cp_internal_allocate_temp_cap(void)
+{
+    uint64_t temp_idx = alloc_state.temp_cap_idx % NUM_TEMP_CAPS;
+    alloc_state.temp_cap_idx++;
+    
+    if (alloc_state.temp_cap_used[temp_idx]) {
+        sel4cp_internal_delete_temp_cap(BASE_TEMP_CAP + temp_idx);
+    }
+    alloc_state.temp_cap_used[temp_idx] = true;
+    alloc_state.temp_cap_pages[temp_idx] = 0;
+    return BASE_TEMP_CAP + temp_idx;
+}
+
+/**
+ *  Returns true if the CSlot with the given index in the current PD holds an object of a pool,
+ *  i.e. an object retyped by the sel4cp tool or from untyped memory.
+ */
+static bool
+sel4cp_internal_is_pool_cap(uint64_t cap_idx)
+{
+    return (cap_idx >= BASE_TCB_POOL && cap_idx < BASE_SHARED_MEMORY_REGION_PAGES) ||
+        (cap_idx >= BASE_RETYPED_CAP && cap_idx < BASE_RETYPED_CAP + alloc_state.num_retyped_caps);
+}
+
+/**
+ *  Returns the index of the pool that the CSlot with the given index in the current PD belongs to.
+ *  Precondition: BASE_TCB_POOL <= cap_idx < BASE_SHARED_MEMORY_REGION_PAGES, 
+ *  or the CSlot holds an object retyped from untyped memory.
+ */
+static uint64_t
+sel4cp_internal_get_pool(uint64_t cap_idx)
+{
+    if (cap_idx >= BASE_RETYPED_CAP) {
+        return alloc_state.retyped_cap_pools[cap_idx - BASE_RETYPED_CAP];
+    }
+    uint64_t pool = 0;
+    while (pool + 1 < NUM_POOLS && cap_idx >= sel4cp_internal_pool_bases[pool + 1]) {
+        pool++;
+    }
+    return pool;
+}
+
+/**
+ *  Returns the index of the CSlot in the current PD holding the next object of the pool with the given index
+ *  after the object in the CSlot with the given index, or the first object of the pool if cap_idx is 0.
+ *  The objects retyped by the sel4cp tool come first, followed by the objects retyped from untyped memory.
+ *  Returns 0 if there is none.
+ */
+static uint64_t
+sel4cp_internal_next_pool_cap(uint64_t pool, uint64_t cap_idx)
+{
+    cap_idx = cap_idx == 0 ? sel4cp_internal_pool_bases[pool] : cap_idx + 1;
+    if (cap_idx < sel4cp_internal_pool_bases[pool] + sel4cp_internal_pool_sizes[pool]) {
+        return cap_idx;
+    }
+    if (cap_idx < BASE_RETYPED_CAP) {
+        cap_idx = BASE_RETYPED_CAP;
+    }
+    for (; cap_idx < BASE_RETYPED_CAP + alloc_state.num_retyped_caps; cap_idx++) {
+        if (alloc_state.retyped_cap_pools[cap_idx - BASE_RETYPED_CAP] == pool) {
+            return cap_idx;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Returns the index of the page of the page pool in the CSlot with the given index in the current PD
+ *  among all pages of the page pool, where the pages retyped from untyped memory follow those retyped by the sel4cp tool.
+ *  Returns MAX_POOL_PAGES if the CSlot does not hold a page of the page pool.
+ */
+static uint64_t
+sel4cp_internal_get_page_idx(uint64_t cap_idx)
+{
+    if (cap_idx >= BASE_PAGE_POOL && cap_idx < BASE_PAGE_POOL + POOL_NUM_PAGES) {
+        return cap_idx - BASE_PAGE_POOL;
+    }
+    if (sel4cp_internal_is_pool_cap(cap_idx) && cap_idx >= BASE_RETYPED_CAP && sel4cp_internal_get_pool(cap_idx) == PAGE_POOL_ID) {
+        return POOL_NUM_PAGES + cap_idx - BASE_RETYPED_CAP;
+    }
+    return MAX_POOL_PAGES;
+}
+
+/**
+ *  Returns true if objects may still be retyped from the untyped memory of the current PD, 
+ *  i.e. if there is an untyped capability that is still used and a CSlot to retype an object into.
+ */
+static bool
+sel4cp_internal_has_untyped_memory(void)
+{
+    if (alloc_state.num_retyped_caps == NUM_RETYPED_CAPS) {
+        return false;
+    }
+    for (uint64_t i = 0; i < SEL4CP_NUM_UNTYPED_CAPS; i++) {
+        if (!(alloc_state.exhausted_untyped_caps & (1ULL << i))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ *  Returns the number of objects that can still be retyped from the untyped memory of the current PD 
+ *  into a CSlot, shared by all pools, which is an upper bound, as the untyped memory may run out first.
+ */
+static uint64_t
+sel4cp_internal_get_num_retypable_caps(void)
+{
+    return sel4cp_internal_has_untyped_memory() ? NUM_RETYPED_CAPS - alloc_state.num_retyped_caps : 0;
+}
+
+/**
+ *  Returns the number of objects left in the pool with the given index, 
+ *  including the objects that have been returned to the pool, but not the objects that can still be retyped.
+ */
+static uint64_t
+sel4cp_internal_get_num_pooled_caps(uint64_t pool)
+{
+    pool_allocator *allocator = &alloc_state.pools[pool];
+    return sel4cp_internal_pool_sizes[pool] - allocator->num_handed_out + allocator->num_free;
+}
+
+/**
+ *  Returns the number of objects left in the pool with the given index, 
+ *  including the objects that have been returned to the pool.
+ *  While the current PD has untyped memory, the objects that can still be retyped into a CSlot are included as well,
+ *  see sel4cp_internal_get_num_retypable_caps. As these are shared by all pools, the numbers of several pools
+ *  must not be added up, see sel4cp_internal_check_pool_requirements.
+ */
+static uint64_t
+sel4cp_internal_get_num_free_pool_caps(uint64_t pool)
+{
+    return sel4cp_internal_get_num_pooled_caps(pool) + sel4cp_internal_get_num_retypable_caps();
+}
+
+/**
+ *  Retypes an object for the pool with the given index from the untyped memory of the current PD, 
+ *  into the next CSlot for retyped objects. The untyped capabilities are tried in turn, and 
+ *  an untyped capability is not used anymore once it cannot even hold a notification, the smallest
+ *  object of the pools, or once it cannot be used at all, e.g. because its CSlot is empty.
+ *  Like the objects retyped by the sel4cp tool, the objects are cleared by seL4 when they are retyped.
+ *
+ *  Returns the index of the CSlot containing the object in the current PD.
+ *  Returns 0 if no object could be retyped.
+ */
+static uint64_t
+sel4cp_internal_retype_pool_cap(uint64_t pool)
+{
+    if (!sel4cp_internal_has_untyped_memory()) {
+        return 0;
+    }
+    uint64_t cap_idx = BASE_RETYPED_CAP + alloc_state.num_retyped_caps;
+    for (uint64_t i = 0; i < SEL4CP_NUM_UNTYPED_CAPS; i++) {
+        if (alloc_state.exhausted_untyped_caps & (1ULL << i)) {
+            continue;
+        }
+        seL4_Error err = seL4_Untyped_Retype(
+            BASE_UNTYPED_CAP + i,
+            sel4cp_internal_pool_object_types[pool],
+            sel4cp_internal_pool_object_size_bits[pool],
+            BASE_CNODE_CAP + sel4cp_current_pd_id,
+            0,
+            0,
+            cap_idx,
+            1
+        );
+        if (err == seL4_NoError) {
+            alloc_state.retyped_cap_pools[alloc_state.num_retyped_caps] = (uint8_t)pool;
+            alloc_state.num_retyped_caps++;
+            alloc_state.pools[pool].num_retyped++;
+            return cap_idx;
+        }
+        // Smaller objects may still fit into untyped memory that has no room left for the object.
+        if (err != seL4_NotEnoughMemory || pool == NOTIFICATION_POOL_ID) {
+            alloc_state.exhausted_untyped_caps |= 1ULL << i;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Records the object or memory region page in the CSlot with the given index in the current PD
+ *  with the given PD, and journals it if the PD is being created, see pd_create_journal.
+ */
+static void
+sel4cp_internal_set_cap_owner(uint64_t cap_idx, sel4cp_pd pd)
+{
+    uint64_t i = cap_idx - BASE_TCB_POOL;
+    alloc_state.cap_owners[i] = pd + 1;
+    if (sel4cp_internal_journal.active && sel4cp_internal_journal.pd == pd) {
+        sel4cp_internal_journal.owned_caps[i / 64] |= 1ULL << (i % 64);
+    }
+}
+
+/**
+ *  Takes an object for the given PD from the pool with the given index in constant time.
+ *  Objects returned to the pool are handed out first, and the objects that have never been handed out
+ *  are only taken in the order of their CSlots if there are none. Once all of them have been handed out,
+ *  an object is retyped from untyped memory, see sel4cp_internal_retype_pool_cap.
+ *
+ *  Returns the index of the CSlot containing the object in the current PD.
+ *  Returns 0 if the pool is empty.
+ */
+static uint64_t
+sel4cp_internal_allocate_pool_cap(sel4cp_pd pd, uint64_t pool)
+{
+    pool_allocator *allocator = &alloc_state.pools[pool];
+    uint64_t cap_idx = allocator->free_cap;
+    if (cap_idx != 0) {
+        allocator->free_cap = alloc_state.next_free_pool_caps[cap_idx - BASE_TCB_POOL];
+        allocator->num_free--;
+    }
+    else if (allocator->num_handed_out < sel4cp_internal_pool_sizes[pool]) {
+        cap_idx = sel4cp_internal_pool_bases[pool] + allocator->num_handed_out;
+        allocator->num_handed_out++;
+    }
+    else {
+        cap_idx = sel4cp_internal_retype_pool_cap(pool);
+        if (cap_idx == 0) {
+            return 0;
+        }
+    }
+    sel4cp_internal_set_cap_owner(cap_idx, pd);
+    return cap_idx;
+}
+
+/**
+ *  Returns the object in the CSlot with the given index in the current PD to its pool.
+ *  Precondition: The object has been handed out by sel4cp_internal_allocate_pool_cap, and it is
+ *  in the same state as before, i.e. unmapped, unbound, and without any capabilities derived from it.
+ */
 static void
+sel4cp_internal_free_pool_cap(uint64_t cap_idx)
+{
+    uint64_t pool = sel4cp_internal_get_pool(cap_idx);
+    pool_allocator *allocator = &alloc_state.pools[pool];
+    alloc_state.cap_owners[cap_idx - BASE_TCB_POOL] = 0;
+    alloc_state.moved_pool_caps[cap_idx - BASE_TCB_POOL] = 0;
+    if (pool == PAGE_POOL_ID) {
+        alloc_state.page_vaddrs[sel4cp_internal_get_page_idx(cap_idx)] = 0;
+    }
+    alloc_state.next_free_pool_caps[cap_idx - BASE_TCB_POOL] = (uint16_t)allocator->free_cap;
+    allocator->free_cap = cap_idx;
+    allocator->num_free++;
+}
+
+/**
+ *  Returns the index of the CSlot in the current PD containing the page of the page pool 
+ *  recorded with the given owner that is mapped at the given vaddr, see allocation_state.
+ *  Returns 0 if there is none.
+ */
+static uint64_t
+sel4cp_internal_find_page(uint64_t owner, uint64_t vaddr)
+{
+    uint64_t page_vaddr = (vaddr >> 12) << 12;
+    for (uint64_t cap_idx = sel4cp_internal_next_pool_cap(PAGE_POOL_ID, 0); cap_idx != 0; cap_idx = sel4cp_internal_next_pool_cap(PAGE_POOL_ID, cap_idx)) {
+        if (alloc_state.cap_owners[cap_idx - BASE_TCB_POOL] == owner && alloc_state.page_vaddrs[sel4cp_internal_get_page_idx(cap_idx)] == page_vaddr) {
+            return cap_idx;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Returns the index of the CSlot in the current PD with the fault endpoint to give to the given PD.
+ *  The faults of a PD whose pages are loaded on demand are delivered to the current PD, 
+ *  so an endpoint capability badged with the id of the PD is minted from the input endpoint into
+ *  a CSlot for temporary capabilities, from where it is copied into the TCB of the PD.
+ *  The faults of all other PDs are delivered to the fault endpoint of the current PD.
+ *
+ *  Returns 0 if an error occurs.
+ */
+static uint64_t
+sel4cp_internal_get_fault_ep(sel4cp_pd pd)
+{
+    if (sel4cp_internal_lazy_pds[pd].src == NULL) {
+        return FAULT_EP_CAP_IDX;
+    }
+    
+    uint64_t temp_cap = sel4cp_internal_allocate_temp_cap();
+    seL4_Error err = seL4_CNode_Mint(
+        BASE_CNODE_CAP + sel4cp_current_pd_id, 
+        temp_cap,
+        PD_CAP_BITS,
+        BASE_CNODE_CAP + sel4cp_current_pd_id,
+        INPUT_CAP_IDX,
+        PD_CAP_BITS,
+        seL4_AllRights,
+        FAULT_BADGE | pd
+    );
+    if (err != seL4_NoError) {
+        sel4cp_dbg_puts("sel4cp_internal_get_fault_ep: failed to mint a fault endpoint capability for PD ");
+        sel4cp_dbg_puthex64(pd);
+        sel4cp_dbg_puts("\n");
+        return 0;
+    }
+    return temp_cap;
+}
+
+/**
+ *  Sets the priority and the maximum controlled priority of the given PD, binding its SchedContext to its TCB.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
 sel4cp_internal_set_priority(sel4cp_pd pd, uint8_t priority, uint8_t mcp)
 {
+    // The fault endpoint is set again, as it is replaced when setting the scheduling parameters.
+    uint64_t fault_ep_cap = sel4cp_internal_get_fault_ep(pd);
+    if (fault_ep_cap == 0) {
+        return -1;
+    }
     seL4_Error err = seL4_TCB_SetSchedParams(
         BASE_TCB_CAP + pd, 
         BASE_TCB_CAP + sel4cp_current_pd_id, 
         mcp, 
         priority,
-        BASE_SCHEDCONTEXT_POOL + alloc_state.schedcontext_idx - 1,
-        FAULT_EP_CAP_IDX
+        BASE_SCHED_CONTEXT_CAP + pd,
+        fault_ep_cap
     );
     if (err != seL4_NoError) {
         sel4cp_dbg_puts("sel4cp_internal_set_priority: error setting priority\n");
-        sel4cp_internal_crash(err);
+        return -1;
     }
+    return 0;
 }
 
-static void
+/**
+ *  Configures the SchedContext of the given PD with the given budget and period.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
 sel4cp_internal_set_sched_flags(sel4cp_pd pd, sel4cp_time budget, sel4cp_time period)
 {
     seL4_Error err = seL4_SchedControl_ConfigureFlags(SCHED_CONTROL_CAP_IDX, BASE_SCHED_CONTEXT_CAP + pd,
                                            budget, period, 0, 0, 0);
     if (err != seL4_NoError) {
         sel4cp_dbg_puts("sel4cp_internal_set_sched_flags: error setting scheduling flags\n");
-        sel4cp_internal_crash(err);
+        return -1;
     }
+    return 0;
 }
 
-static void
+/**
+ *  Sets up a channel between the given PDs, with the given channel id of each PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
 sel4cp_internal_set_up_channel(sel4cp_pd pd_a, sel4cp_pd pd_b, uint8_t channel_id_a, uint8_t channel_id_b) 
 {
     // Mint a notification capability to PD a, allowing it to notify PD b.
@@ -268,7 +1012,7 @@ sel4cp_internal_set_up_channel(sel4cp_pd pd_a, sel4cp_pd pd_b, uint8_t channel_i
         sel4cp_dbg_puts("sel4cp_internal_set_up_channel: failed set up channel for PD ");
         sel4cp_dbg_puthex64(pd_a);
         sel4cp_dbg_puts("\n");
-        sel4cp_internal_crash(err);
+        return -1;
     }
     
     // Mint a notification capability to PD b, allowing it to notify PD a.
@@ -286,21 +1030,28 @@ sel4cp_internal_set_up_channel(sel4cp_pd pd_a, sel4cp_pd pd_b, uint8_t channel_i
         sel4cp_dbg_puts("sel4cp_internal_set_up_channel: failed set up channel for PD ");
         sel4cp_dbg_puthex64(pd_b);
         sel4cp_dbg_puts("\n");
-        sel4cp_internal_crash(err);
+        return -1;
     }
+    return 0;
 }
 
-static void
-sel4cp_internal_set_up_irq(sel4cp_pd pd, uint8_t parent_irq_channel_id, uint8_t child_irq_channel_id) 
-{
-    // Ensure that the CSlot used for temporary capabilities is empty.
-    sel4cp_internal_delete_temp_cap();
-
-    // Create a badged capability to the channel object of the child PD,
+/**
+ *  Registers the given PD to be notified on its channel child_irq_channel_id for the IRQ the current PD
+ *  handles on its channel parent_irq_channel_id, and moves the IRQHandler capability to the PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_set_up_irq(sel4cp_pd pd, uint8_t parent_irq_channel_id, uint8_t child_irq_channel_id) 
+{
+    uint64_t temp_cap = sel4cp_internal_allocate_temp_cap();
+
+    // Create a badged capability to the channel object of the child PD,
     // ensuring that the child is notified with the correct channel id.
     seL4_Error err = seL4_CNode_Mint(
         BASE_CNODE_CAP + sel4cp_current_pd_id, 
-        TEMP_CAP,
+        temp_cap,
         PD_CAP_BITS,
         BASE_CNODE_CAP + sel4cp_current_pd_id,
         BASE_UNBADGED_CHANNEL_CAP + pd,
@@ -310,19 +1061,24 @@ sel4cp_internal_set_up_irq(sel4cp_pd pd, uint8_t parent_irq_channel_id, uint8_t
     );
     if (err != seL4_NoError) {
         sel4cp_dbg_puts("sel4cp_internal_set_up_irq: failed to create a badged capability to the child PD to be used for IRQ handling\n");
-        sel4cp_internal_crash(err);
+        return -1;
     }
 
     // Register the channel object of the child PD to be notified for the given IRQ,
     // using the badged capability created above.
     err = seL4_IRQHandler_SetNotification(
         BASE_IRQ_CAP + parent_irq_channel_id,
-        TEMP_CAP
+        temp_cap
     );
     if (err != seL4_NoError) {
         sel4cp_dbg_puts("sel4cp_internal_set_up_irq: failed to register child as the handler of irq\n");
-        sel4cp_internal_crash(err);
+        return -1;
     }
+    alloc_state.irq_owners[parent_irq_channel_id] = pd + 1;
+    if (sel4cp_internal_journal.active && sel4cp_internal_journal.pd == pd) {
+        sel4cp_internal_journal.owned_irqs |= 1ULL << parent_irq_channel_id;
+    }
+    alloc_state.irq_child_channel_ids[parent_irq_channel_id] = child_irq_channel_id;
     
     // Move the IRQHandler capability into the CSpace of the child PD.
     err = seL4_CNode_Move(
@@ -335,8 +1091,9 @@ sel4cp_internal_set_up_irq(sel4cp_pd pd, uint8_t parent_irq_channel_id, uint8_t
     );
     if (err != seL4_NoError) {
         sel4cp_dbg_puts("sel4cp_internal_set_up_irq: failed to move the IRQHandler capability to the child PD\n");
-        sel4cp_internal_crash(err);
+        return -1;
     }
+    return 0;
 }
 
 /**
@@ -446,10 +1203,116 @@ sel4cp_internal_get_symbol(uint8_t *src, char *target_symbol_name)
     return NULL;
 }
 
+/**
+ *  Returns true if and only if the paging structure covering the given num_bits bits 
+ *  of the given virtual address in the given VSpace is recorded as mapped.
+ */
+static bool
+sel4cp_internal_is_paging_structure_mapped(uint64_t pd_vspace_cap, uint64_t vaddr, uint8_t num_bits)
+{
+    uint64_t structure_vaddr = sel4cp_internal_mask_bits(vaddr, num_bits);
+    for (uint64_t i = 0; i < alloc_state.num_mapped_paging_structures; i++) {
+        mapped_paging_structure *structure = &alloc_state.mapped_paging_structures[i];
+        if (structure->vspace_cap == pd_vspace_cap && structure->vaddr == structure_vaddr && structure->num_bits == num_bits) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ *  Records that the paging structure covering the given num_bits bits 
+ *  of the given virtual address in the given VSpace is mapped.
+ *  If no more paging structures can be recorded, nothing is done, 
+ *  such that the paging structure is mapped again when it is required.
+ */
+static void
+sel4cp_internal_record_paging_structure(uint64_t pd_vspace_cap, uint64_t vaddr, uint8_t num_bits)
+{
+    if (alloc_state.num_mapped_paging_structures >= MAX_MAPPED_PAGING_STRUCTURES) {
+        return;
+    }
+    mapped_paging_structure *structure = &alloc_state.mapped_paging_structures[alloc_state.num_mapped_paging_structures];
+    structure->vspace_cap = pd_vspace_cap;
+    structure->vaddr = sel4cp_internal_mask_bits(vaddr, num_bits);
+    structure->num_bits = num_bits;
+    alloc_state.num_mapped_paging_structures++;
+}
+
+/**
+ *  Maps a paging structure from the pool of the paging structures covering num_bits bits
+ *  of a virtual address, i.e. 12 + 9 + 9 + 9 for a page upper directory, 12 + 9 + 9 for a page directory,
+ *  and 12 + 9 for a page table, such that it covers the given virtual address in the given VSpace.
+ *  If a paging structure is already mapped there, seL4 reports seL4_DeleteFirst and the paging structure
+ *  is returned to the pool. Either way, the paging structure is recorded as mapped.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_map_paging_structure(uint64_t pd_vspace_cap, uint64_t vaddr, uint8_t num_bits)
+{
+    uint64_t structure_vaddr = sel4cp_internal_mask_bits(vaddr, num_bits);
+    sel4cp_pd pd = pd_vspace_cap - BASE_VSPACE_CAP;
+    uint64_t structure_cap;
+    seL4_Error err;
+    if (num_bits == 12 + 9 + 9 + 9) {
+        structure_cap = sel4cp_internal_allocate_pool_cap(pd, PAGE_UPPER_DIRECTORY_POOL_ID);
+        if (structure_cap == 0) {
+            sel4cp_dbg_puts("sel4cp_internal_map_paging_structure: no page upper directories are available; allocate more and try again\n");
+            return -1;
+        }
+        err = seL4_ARM_PageUpperDirectory_Map(
+            structure_cap,
+            pd_vspace_cap,
+            structure_vaddr,
+            SEL4_ARM_DEFAULT_VMATTRIBUTES 
+        );
+    }
+    else if (num_bits == 12 + 9 + 9) {
+        structure_cap = sel4cp_internal_allocate_pool_cap(pd, PAGE_DIRECTORY_POOL_ID);
+        if (structure_cap == 0) {
+            sel4cp_dbg_puts("sel4cp_internal_map_paging_structure: no page directories are available; allocate more and try again\n");
+            return -1;
+        }
+        err = seL4_ARM_PageDirectory_Map(
+            structure_cap,
+            pd_vspace_cap,
+            structure_vaddr,
+            SEL4_ARM_DEFAULT_VMATTRIBUTES 
+        );
+    }
+    else {
+        structure_cap = sel4cp_internal_allocate_pool_cap(pd, PAGE_TABLE_POOL_ID);
+        if (structure_cap == 0) {
+            sel4cp_dbg_puts("sel4cp_internal_map_paging_structure: no page tables are available; allocate more and try again\n");
+            return -1;
+        }
+        err = seL4_ARM_PageTable_Map(
+            structure_cap,
+            pd_vspace_cap,
+            structure_vaddr,
+            SEL4_ARM_DEFAULT_VMATTRIBUTES 
+        );
+    }
+    if (err != seL4_NoError) {
+        sel4cp_internal_free_pool_cap(structure_cap);
+    }
+    if (err != seL4_NoError && err != seL4_DeleteFirst) {
+        sel4cp_dbg_puts("sel4cp_internal_map_paging_structure: failed to map a paging structure; error code = ");
+        sel4cp_dbg_puthex64(err);
+        sel4cp_dbg_puts("\n");
+        return -1;
+    }
+    sel4cp_internal_record_paging_structure(pd_vspace_cap, vaddr, num_bits);
+    return 0;
+}
+
 /**
  *  Ensures that all higher-level paging structures in the ARM AArch64 four-level
  *  page-table structure required to map a page at the given virtual address in the given
- *  PD VSpace are mapped.
+ *  PD VSpace are mapped. If large_page is true, the page is a large page (2 MiB),
+ *  which is mapped directly by a page directory, such that no page table is required.
  *
  *  The bits in a virtual address are given the following meaning:
  *      -  0-11: offset into a page.
@@ -458,93 +1321,49 @@ sel4cp_internal_get_symbol(uint8_t *src, char *target_symbol_name)
  *      - 30-38: offset into a page upper directory, selecting a specific page directory.
  *      - 39-47: offset into a page global directory, selecting a specific page upper directory. 
  *  Note that the VSpace is a page global directory in seL4 for ARM AArch64.
+ *
+ *  Only the paging structures that are not recorded as mapped are mapped, 
+ *  such that mapping consecutive pages does not require any paging structure invocations.
  */
 static int 
-sel4cp_internal_set_up_required_paging_structures(uint64_t vaddr, uint64_t pd_vspace_cap) 
+sel4cp_internal_set_up_required_paging_structures(uint64_t vaddr, uint64_t pd_vspace_cap, bool large_page) 
 {    
-    // Ensure that the required page upper directory is mapped.
-    uint64_t page_upper_directory_vaddr = sel4cp_internal_mask_bits(vaddr, 12 + 9 + 9 + 9);
-    if (alloc_state.page_upper_directory_idx >= POOL_NUM_PAGE_UPPER_DIRECTORIES) {
-        sel4cp_dbg_puts("sel4cp_internal_set_up_required_paging_structures: no page upper directories are available; allocate more and try again\n");
-        return -1;
-    }
-    seL4_Error err = seL4_ARM_PageUpperDirectory_Map(
-        BASE_PAGE_UPPER_DIRECTORY_POOL + alloc_state.page_upper_directory_idx,
-        pd_vspace_cap,
-        page_upper_directory_vaddr,
-        SEL4_ARM_DEFAULT_VMATTRIBUTES 
-    );
-    if (err == seL4_NoError) {
-        alloc_state.page_upper_directory_idx++;
-    }
-    else if (err != seL4_DeleteFirst) { // if err == seL4_DeleteFirst, the required page upper directory has already been mapped.
-        sel4cp_dbg_puts("sel4cp_internal_set_up_required_paging_structures: failed to allocate a required page upper directory; error code = ");
-        sel4cp_dbg_puthex64(err);
-        sel4cp_dbg_puts("\n");
-        return -1;
+    // All paging structures are already in place if the page table is known to be mapped.
+    if (!large_page && sel4cp_internal_is_paging_structure_mapped(pd_vspace_cap, vaddr, 12 + 9)) {
+        return 0;
     }
     
-    // Ensure that the required page directory is mapped.
-    uint64_t page_directory_vaddr = sel4cp_internal_mask_bits(vaddr, 12 + 9 + 9);
-    if (alloc_state.page_directory_idx >= POOL_NUM_PAGE_DIRECTORIES) {
-        sel4cp_dbg_puts("sel4cp_internal_set_up_required_paging_structures: no page directories are available; allocate more and try again\n");
-        return -1;
-    }
-    err = seL4_ARM_PageDirectory_Map(
-        BASE_PAGE_DIRECTORY_POOL + alloc_state.page_directory_idx,
-        pd_vspace_cap,
-        page_directory_vaddr,
-        SEL4_ARM_DEFAULT_VMATTRIBUTES 
-    );
-    if (err == seL4_NoError) {
-        alloc_state.page_directory_idx++;
-    }
-    else if (err != seL4_DeleteFirst) { // if err == seL4_DeleteFirst, the required page directory has already been mapped.
-        sel4cp_dbg_puts("sel4cp_internal_set_up_required_paging_structures: failed to allocate a required page directory; error code = ");
-        sel4cp_dbg_puthex64(err);
-        sel4cp_dbg_puts("\n");
+    // Ensure that the required page upper directory and page directory are mapped.
+    if (!sel4cp_internal_is_paging_structure_mapped(pd_vspace_cap, vaddr, 12 + 9 + 9 + 9) && 
+        sel4cp_internal_map_paging_structure(pd_vspace_cap, vaddr, 12 + 9 + 9 + 9)) 
+    {
         return -1;
     }
-    
-    // Ensure that the required page table is mapped.
-    uint64_t page_table_vaddr = sel4cp_internal_mask_bits(vaddr, 12 + 9);
-    if (alloc_state.page_table_idx >= POOL_NUM_PAGE_TABLES) {
-        sel4cp_dbg_puts("sel4cp_internal_set_up_required_paging_structures: no page tables are available; allocate more and try again\n");
+    if (!sel4cp_internal_is_paging_structure_mapped(pd_vspace_cap, vaddr, 12 + 9 + 9) && 
+        sel4cp_internal_map_paging_structure(pd_vspace_cap, vaddr, 12 + 9 + 9)) 
+    {
         return -1;
     }
-    err = seL4_ARM_PageTable_Map(
-        BASE_PAGE_TABLE_POOL + alloc_state.page_table_idx,
-        pd_vspace_cap,
-        page_table_vaddr,
-        SEL4_ARM_DEFAULT_VMATTRIBUTES 
-    );
-    if (err == seL4_NoError) {
-        alloc_state.page_table_idx++;
-    }
-    else if (err != seL4_DeleteFirst) { // if err == seL4_DeleteFirst, the required page table has already been mapped.
-        sel4cp_dbg_puts("sel4cp_internal_set_up_required_paging_structures: failed to allocate a required page table; error code = ");
-        sel4cp_dbg_puthex64(err);
-        sel4cp_dbg_puts("\n");
-        return -1;
+    if (large_page) {
+        return 0;
     }
     
-    return 0;
+    // Ensure that the required page table is mapped.
+    return sel4cp_internal_map_paging_structure(pd_vspace_cap, vaddr, 12 + 9);
 }
 
 /**
- *  Allocates a page and maps it at the given virtual address in the given VSpace. 
- *  The page is mapped with the given ELF program header p_flags.
+ *  Maps a page of the page pool at the given virtual address in the given VSpace,
+ *  whose paging structures must already be mapped. The page is mapped with the given ELF program header p_flags.
+ *  The pages of the page pool are retyped by the sel4cp tool, and pages that are returned to the pool
+ *  are 0-initialized again first, so the page is 0-initialized.
  *
- *  Returns the index of the CSlot containing the allocated page in the current PD on success.
+ *  Returns the index of the CSlot containing the page in the current PD on success.
  *  Returns 0 if an error occurs.
  */
 static uint64_t
-sel4cp_internal_allocate_page(uint64_t vaddr, uint64_t pd_vspace_cap, uint32_t p_flags)
+sel4cp_internal_map_next_page(uint64_t vaddr, uint64_t pd_vspace_cap, uint32_t p_flags)
 {
-    if (sel4cp_internal_set_up_required_paging_structures(vaddr, pd_vspace_cap)) {
-        return 0;
-    }
-    
     // Extract the rights and VM attributes to map the required page with 
     // from the given ELF program header flags.
     seL4_CapRights_t rights = sel4cp_internal_parse_cap_rights((uint8_t)p_flags);
@@ -552,602 +1371,1112 @@ sel4cp_internal_allocate_page(uint64_t vaddr, uint64_t pd_vspace_cap, uint32_t p
     
     // Allocate and map the required page.
     uint64_t page_vaddr = sel4cp_internal_mask_bits(vaddr, 12);
-    if (alloc_state.page_idx >= POOL_NUM_PAGES) {
-        sel4cp_dbg_puts("sel4cp_internal_allocate_page: no pages are available; allocate more and try again\n");
+    uint64_t page_cap_idx = sel4cp_internal_allocate_pool_cap(pd_vspace_cap - BASE_VSPACE_CAP, PAGE_POOL_ID);
+    if (page_cap_idx == 0) {
+        sel4cp_dbg_puts("sel4cp_internal_map_next_page: no pages are available; allocate more and try again\n");
         return 0;
     }
     seL4_Error err = seL4_ARM_Page_Map(
-        BASE_PAGE_POOL + alloc_state.page_idx,
+        page_cap_idx,
         pd_vspace_cap,
         page_vaddr,
         rights,
         vm_attributes
     );
-    if (err == seL4_NoError) {
-        alloc_state.page_idx++;
-    }
-    else {
-        sel4cp_dbg_puts("sel4cp_internal_allocate_page: failed to allocate a required page; error code = ");
+    if (err != seL4_NoError) {
+        sel4cp_internal_free_pool_cap(page_cap_idx);
+        sel4cp_dbg_puts("sel4cp_internal_map_next_page: failed to allocate a required page; error code = ");
         sel4cp_dbg_puthex64(err);
         sel4cp_dbg_puts("\n");
         return 0;
     }
     
-    return BASE_PAGE_POOL + alloc_state.page_idx - 1;
+    alloc_state.page_vaddrs[sel4cp_internal_get_page_idx(page_cap_idx)] = page_vaddr;
+    return page_cap_idx;
 }
 
 /**
- *  Returns a virtual address in the current PD which
- *  can be used to write data that will be available at the
- *  given vaddr in the given pd_vspace.
- *  The required paging structures are automatically allocated,
- *  and the page is mapped with the given ELF program header p_flags.
+ *  Allocates a page and maps it at the given virtual address in the given VSpace, 
+ *  mapping the paging structures it requires first, see sel4cp_internal_map_next_page.
  *
- *  Returns NULL if the allocation fails. 
- *  Nothing is done to clean up in this case.
+ *  Returns the index of the CSlot containing the allocated page in the current PD on success.
+ *  Returns 0 if an error occurs.
  */
-static uint8_t *
-sel4cp_internal_allocate_page_with_write_handle(uint8_t *src, uint64_t vaddr, uint64_t pd_vspace_cap, uint32_t p_flags) 
+static uint64_t
+sel4cp_internal_allocate_page(uint64_t vaddr, uint64_t pd_vspace_cap, uint32_t p_flags)
 {
-    uint64_t allocated_page_idx = sel4cp_internal_allocate_page(vaddr, pd_vspace_cap, p_flags);
-    if (allocated_page_idx == 0) {
-        return NULL;
+    if (sel4cp_internal_set_up_required_paging_structures(vaddr, pd_vspace_cap, false)) {
+        return 0;
     }
+    return sel4cp_internal_map_next_page(vaddr, pd_vspace_cap, p_flags);
+}
 
-    // Ensure that the required paging structures are set up for the temp loader page.
-    if (!alloc_state.temp_page_prepared) { 
-        if (sel4cp_internal_set_up_required_paging_structures((uint64_t)__SEL4_TEMP_PAGE_VADDR, BASE_VSPACE_CAP + sel4cp_current_pd_id)) {
-            sel4cp_dbg_puts("sel4cp_internal_allocate_page_with_write_handle: failed to allocate the temp loader page\n");
-            return NULL;
+/**
+ *  Ensures that the required paging structures are set up for all temp pages of the current PD at once.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_prepare_temp_pages(void)
+{
+    if (alloc_state.temp_pages_prepared) {
+        return 0;
+    }
+    for (uint64_t i = 0; i < NUM_TEMP_CAPS; i++) {
+        if (sel4cp_internal_set_up_required_paging_structures((uint64_t)__SEL4_TEMP_PAGE_VADDR + (i * 0x1000), BASE_VSPACE_CAP + sel4cp_current_pd_id, false)) {
+            sel4cp_dbg_puts("sel4cp_internal_prepare_temp_pages: failed to allocate the temp loader pages\n");
+            return -1;
         }
-        alloc_state.temp_page_prepared = true;
+    }
+    alloc_state.temp_pages_prepared = true;
+    return 0;
+}
+
+/**
+ *  Maps the page in the CSlot with the given index in the current PD into one of the 
+ *  temporary pages of the current PD, such that it can be written to.
+ *  A page that is still mapped into one of the temporary pages is not mapped again.
+ *  
+ *  Returns a virtual address in the current PD which can be used to write data
+ *  at the given vaddr in the page.
+ *  Returns NULL if an error occurs.
+ */
+static uint8_t *
+sel4cp_internal_map_page_with_write_handle(uint64_t page_cap_idx, uint64_t vaddr)
+{
+    if (sel4cp_internal_prepare_temp_pages()) {
+        return NULL;
+    }
+    uint64_t page_idx = sel4cp_internal_get_page_idx(page_cap_idx);
+    if (sel4cp_internal_journal.active && page_idx < MAX_POOL_PAGES) {
+        sel4cp_internal_journal.written_pages[page_idx / 64] |= 1ULL << (page_idx % 64);
     }
     
-    // Ensure that the capability slot for the page capability mapped into the current PD's VSpace is empty.
-    sel4cp_internal_delete_temp_cap();
+    for (uint64_t i = 0; i < NUM_TEMP_CAPS; i++) {
+        if (alloc_state.temp_cap_pages[i] == page_cap_idx) {
+            return __SEL4_TEMP_PAGE_VADDR + (i * 0x1000) + ((uint64_t)(vaddr % 0x1000));
+        }
+    }
     
-    // Copy the capability for the allocated page to the temporary page cap CSlot.
+    // Copy the capability for the page to a CSlot for temporary capabilities.
+    uint64_t temp_cap = sel4cp_internal_allocate_temp_cap();
     seL4_Error err = seL4_CNode_Copy(
         BASE_CNODE_CAP + sel4cp_current_pd_id,
-        TEMP_CAP,
+        temp_cap,
         PD_CAP_BITS,
         BASE_CNODE_CAP + sel4cp_current_pd_id,
-        allocated_page_idx,
+        page_cap_idx,
         PD_CAP_BITS,
         seL4_AllRights
     );
     if (err != seL4_NoError) {
-        sel4cp_dbg_puts("sel4cp_internal_allocate_page: failed to copy page capability required to be able to load ELF file, error code = ");
+        sel4cp_dbg_puts("sel4cp_internal_map_page_with_write_handle: failed to copy page capability required to be able to load ELF file, error code = ");
         sel4cp_dbg_puthex64(err);
         sel4cp_dbg_puts("\n");
         return NULL;
     }
     
     // Map the copied page capability into the VSpace of the current PD.
+    uint8_t *temp_page = __SEL4_TEMP_PAGE_VADDR + ((temp_cap - BASE_TEMP_CAP) * 0x1000);
     err = seL4_ARM_Page_Map(
-        TEMP_CAP,
+        temp_cap,
         BASE_VSPACE_CAP + sel4cp_current_pd_id,
-        (uint64_t)__SEL4_TEMP_PAGE_VADDR,
+        (uint64_t)temp_page,
         seL4_ReadWrite,
         SEL4_ARM_DEFAULT_VMATTRIBUTES
     );
     if (err != seL4_NoError) {
-        sel4cp_dbg_puts("sel4cp_internal_allocate_page: failed to map the page via the copied page capability into the current PD's VSpace, error code = ");
+        sel4cp_dbg_puts("sel4cp_internal_map_page_with_write_handle: failed to map the page via the copied page capability into the current PD's VSpace, error code = ");
         sel4cp_dbg_puthex64(err);
         sel4cp_dbg_puts("\n");
         return NULL;
     }
+    alloc_state.temp_cap_pages[temp_cap - BASE_TEMP_CAP] = page_cap_idx;
     
-    return __SEL4_TEMP_PAGE_VADDR + ((uint64_t)(vaddr % 0x1000));
+    return temp_page + ((uint64_t)(vaddr % 0x1000));
 }
 
 /**
- *  Sets up the access rights for the given program in the given PD.
+ *  Returns the page of the page pool in the CSlot with the given index in the current PD to the pool.
+ *  The page is unmapped, and all capabilities derived from it, such as the copies for the temporary pages 
+ *  of the current PD and the copies in the CNodes of other PDs, are deleted.
+ *  If zero is true, the page is 0-initialized again first, as required for all pages in the pool.
+ *  A page that cannot be 0-initialized is not returned to the pool, but is no longer recorded with any PD.
  */
-static int 
-sel4cp_internal_set_up_access_rights(uint8_t *elf_file, sel4cp_pd pd) 
-{   
-    // Get the offset of the access right table, 
-    // taking into account that the offset is only 7 bytes long.
-    uint64_t access_right_table_offset = *((uint64_t *)(elf_file + EI_ACCESS_RIGHT_TABLE_OFFSET_IDX - 1)) >> 8;
+static void
+sel4cp_internal_free_page(uint64_t page_cap_idx, bool zero)
+{
+    if (zero) {
+        uint64_t *page = (uint64_t *)sel4cp_internal_map_page_with_write_handle(page_cap_idx, 0);
+        if (page == NULL) {
+            sel4cp_dbg_puts("sel4cp_internal_free_page: failed to 0-initialize a page, which is not returned to the pool\n");
+            alloc_state.cap_owners[page_cap_idx - BASE_TCB_POOL] = 0;
+            return;
+        }
+        for (uint64_t i = 0; i < 0x1000 / sizeof(uint64_t); i++) {
+            page[i] = 0;
+        }
+    }
+    
+    seL4_ARM_Page_Unmap(page_cap_idx);
+    seL4_CNode_Revoke(BASE_CNODE_CAP + sel4cp_current_pd_id, page_cap_idx, PD_CAP_BITS);
+    for (uint64_t i = 0; i < NUM_TEMP_CAPS; i++) {
+        if (alloc_state.temp_cap_pages[i] == page_cap_idx) {
+            alloc_state.temp_cap_pages[i] = 0;
+        }
+    }
+    sel4cp_internal_free_pool_cap(page_cap_idx);
+}
+
+// The number of bytes following the type id of an access right of each type in a v1 table.
+static const uint8_t sel4cp_internal_v1_access_right_sizes[NUM_ACCESS_RIGHT_TYPES] = {
+    [SCHEDULING_ID] = 18,
+    [CHANNEL_ID] = 3,
+    [MEMORY_REGION_ID] = 26,
+    [IRQ_ID] = 2,
+    [PROTECTION_DOMAIN_CONTROL_ID] = 0,
+    [LARGE_PAGE_MEMORY_REGION_ID] = 26,
+    [LOADER_SYMBOLS_ID] = 16,
+    [IMAGE_HASH_ID] = 8
+};
+
+// The size of an access right of each type in a v2 table.
+static const uint8_t sel4cp_internal_access_right_sizes[NUM_ACCESS_RIGHT_TYPES] = {
+    [SCHEDULING_ID] = sizeof(scheduling_access_right),
+    [CHANNEL_ID] = sizeof(channel_access_right),
+    [MEMORY_REGION_ID] = sizeof(memory_region_access_right),
+    [IRQ_ID] = sizeof(irq_access_right),
+    [PROTECTION_DOMAIN_CONTROL_ID] = sizeof(access_right_header),
+    [LARGE_PAGE_MEMORY_REGION_ID] = sizeof(memory_region_access_right),
+    [LOADER_SYMBOLS_ID] = sizeof(loader_symbols_access_right),
+    [IMAGE_HASH_ID] = sizeof(image_hash_access_right)
+};
+
+// The buffer holding a v1 access right table converted to v2.
+static uint64_t sel4cp_internal_converted_access_rights[MAX_CONVERTED_ACCESS_RIGHT_TABLE_SIZE / 8];
+
+/**
+ *  Reads num_bytes bytes at the given address as a little-endian integer, one byte at a time,
+ *  such that the address does not have to be aligned.
+ */
+static uint64_t
+sel4cp_internal_read_unaligned(uint8_t *src, uint8_t num_bytes)
+{
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < num_bytes; i++) {
+        value |= ((uint64_t)src[i]) << (8 * i);
+    }
+    return value;
+}
+
+/**
+ *  Converts the given v1 access right table, of which v1_size bytes are available,
+ *  to a v2 table in sel4cp_internal_converted_access_rights.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if the v1 table is invalid, extends past the available bytes, or is too large to convert.
+ */
+static int
+sel4cp_internal_convert_v1_access_rights(uint8_t *v1_table, uint64_t v1_size)
+{
+    // Each access right takes at least one byte, which bounds the count before anything else is read.
+    uint64_t num_access_rights = v1_size < 8 ? 0 : sel4cp_internal_read_unaligned(v1_table, 8);
+    if (v1_size < 8 || num_access_rights > v1_size - 8) {
+        sel4cp_dbg_puts("sel4cp_internal_convert_v1_access_rights: the access right table extends past the ELF file\n");
+        return -1;
+    }
     
-    uint8_t *access_right_reader = elf_file + access_right_table_offset;
+    // Find the size of the v2 table, and the offset of the access rights of each type in it.
+    uint64_t num_per_type[NUM_ACCESS_RIGHT_TYPES];
+    for (uint64_t type_id = 0; type_id < NUM_ACCESS_RIGHT_TYPES; type_id++) {
+        num_per_type[type_id] = 0;
+    }
+    uint64_t v1_offset = 8;
+    for (uint64_t i = 0; i < num_access_rights; i++) {
+        if (v1_offset >= v1_size) {
+            sel4cp_dbg_puts("sel4cp_internal_convert_v1_access_rights: the access right table extends past the ELF file\n");
+            return -1;
+        }
+        uint8_t access_right_type_id = v1_table[v1_offset];
+        if (access_right_type_id >= NUM_ACCESS_RIGHT_TYPES) {
+            sel4cp_dbg_puts("sel4cp_internal_convert_v1_access_rights: invalid access right type id: ");
+            sel4cp_dbg_puthex64(access_right_type_id);
+            sel4cp_dbg_puts("\n");
+            return -1;
+        }
+        v1_offset += 1 + sel4cp_internal_v1_access_right_sizes[access_right_type_id];
+        if (v1_offset > v1_size) {
+            sel4cp_dbg_puts("sel4cp_internal_convert_v1_access_rights: the access right table extends past the ELF file\n");
+            return -1;
+        }
+        num_per_type[access_right_type_id]++;
+    }
     
-    uint64_t num_access_rights = *((uint64_t *) access_right_reader);
-    access_right_reader += 8;
+    uint8_t *v2_table = (uint8_t *)sel4cp_internal_converted_access_rights;
+    access_right_table_header *header = (access_right_table_header *)v2_table;
+    access_right_index_entry *index = (access_right_index_entry *)(v2_table + sizeof(access_right_table_header));
+    uint64_t size = sizeof(access_right_table_header) + NUM_ACCESS_RIGHT_TYPES * sizeof(access_right_index_entry);
+    for (uint64_t type_id = 0; type_id < NUM_ACCESS_RIGHT_TYPES; type_id++) {
+        index[type_id].offset = num_per_type[type_id] != 0 ? size : 0;
+        index[type_id].num_access_rights = 0;
+        size += num_per_type[type_id] * sel4cp_internal_access_right_sizes[type_id];
+    }
+    if (size > MAX_CONVERTED_ACCESS_RIGHT_TABLE_SIZE) {
+        sel4cp_dbg_puts("sel4cp_internal_convert_v1_access_rights: the access right table is too large to convert\n");
+        return -1;
+    }
+    header->magic = ACCESS_RIGHT_TABLE_MAGIC;
+    header->version = ACCESS_RIGHT_TABLE_VERSION;
+    header->num_types = NUM_ACCESS_RIGHT_TYPES;
+    header->num_access_rights = num_access_rights;
+    header->size = size;
     
-    // Setup all access rights.
-    uint64_t shared_page_idx = BASE_SHARED_MEMORY_REGION_PAGES;
+    // Convert each access right, placing it after the access rights of the same type converted so far.
+    uint8_t *v1_reader = v1_table + 8;
     for (uint64_t i = 0; i < num_access_rights; i++) {
-        uint8_t access_right_type_id = *access_right_reader++;
+        uint8_t access_right_type_id = *v1_reader++;
+        uint8_t *v1_data = v1_reader;
+        v1_reader += sel4cp_internal_v1_access_right_sizes[access_right_type_id];
+        
+        access_right_index_entry *entry = &index[access_right_type_id];
+        access_right_header *hdr = (access_right_header *)(v2_table + entry->offset + entry->num_access_rights * sel4cp_internal_access_right_sizes[access_right_type_id]);
+        entry->num_access_rights++;
+        hdr->type_id = access_right_type_id;
+        hdr->size = sel4cp_internal_access_right_sizes[access_right_type_id];
         switch (access_right_type_id) {
             case SCHEDULING_ID: {
-                uint8_t priority = *access_right_reader++;
-                uint8_t mcp = *access_right_reader++;
-                uint64_t budget = *((uint64_t *)access_right_reader);
-                access_right_reader += 8;
-                uint64_t period = *((uint64_t *)access_right_reader);
-                access_right_reader += 8;
-                
-                sel4cp_internal_set_priority(pd, priority, mcp);
-                sel4cp_internal_set_sched_flags(pd, budget, period);
+                scheduling_access_right *scheduling = (scheduling_access_right *)hdr;
+                scheduling->priority = v1_data[0];
+                scheduling->mcp = v1_data[1];
+                scheduling->budget = sel4cp_internal_read_unaligned(v1_data + 2, 8);
+                scheduling->period = sel4cp_internal_read_unaligned(v1_data + 10, 8);
                 break;
             }
             case CHANNEL_ID: {
-                uint8_t target_pd = *access_right_reader++;
-                uint8_t target_id = *access_right_reader++;
-                uint8_t own_id = *access_right_reader++;
-                
-                sel4cp_internal_set_up_channel(pd, target_pd, own_id, target_id);
+                channel_access_right *channel = (channel_access_right *)hdr;
+                channel->target_pd = v1_data[0];
+                channel->target_id = v1_data[1];
+                channel->own_id = v1_data[2];
                 break;
             }
-            case MEMORY_REGION_ID: {
-                uint64_t id = *((uint64_t *) access_right_reader);
-                access_right_reader += 8;
-                uint64_t vaddr = *((uint64_t *) access_right_reader);
-                access_right_reader += 8;
-                uint64_t size = *((uint64_t *) access_right_reader);
-                access_right_reader += 8;
-                uint8_t perms = *access_right_reader++;
-                uint8_t cached = *access_right_reader++;
-                
-                // Parse the rights and VM attributes.
-                seL4_CapRights_t rights = sel4cp_internal_parse_cap_rights(perms);
-                seL4_ARM_VMAttributes vm_attributes = sel4cp_internal_parse_vm_attributes(perms, cached); 
-                
-                // Map the memory region into the child PD's VSpace.
-                uint64_t pd_vspace_cap = BASE_VSPACE_CAP + pd;
-                uint64_t num_pages = size / 0x1000; // Assumes that the size is a multiple of the page size 0x1000.
-                for (uint64_t j = 0; j < num_pages; j++) {
-                    uint64_t page_cap = BASE_SHARED_MEMORY_REGION_PAGES + id + j;
-                    uint64_t page_vaddr = vaddr + (j * 0x1000);
-                    
-                    // Ensure that all required higher-level paging structures are mapped before mapping this page.
-                    if (sel4cp_internal_set_up_required_paging_structures(page_vaddr, BASE_VSPACE_CAP + pd)) {
-                        return -1;
-                    }
-                    
-                    // Map the page into the child PD's VSpace.
-                    seL4_Error err = seL4_ARM_Page_Map(
-                        page_cap, 
-                        pd_vspace_cap, 
-                        page_vaddr, 
-                        rights, 
-                        vm_attributes
-                    );
-                    if (err != seL4_NoError) {
-                        sel4cp_dbg_puts("sel4cp_internal_set_up_access_rights: failed to map page for child\n");
-                        sel4cp_dbg_puthex64(err);
-                        sel4cp_dbg_puts("\n");
-                        return -1;
-                    } 
-                    // Copy the page capability into the child PD's CSpace.
-                    err = seL4_CNode_Copy(
-                        BASE_CNODE_CAP + pd,
-                        shared_page_idx,
-                        PD_CAP_BITS,
-                        BASE_CNODE_CAP + sel4cp_current_pd_id,
-                        page_cap,
-                        PD_CAP_BITS,
-                        seL4_AllRights
-                    );
-                    if (err != seL4_NoError) {
-                        return -1;
-                    }
-                    shared_page_idx++;
-                }                
+            case MEMORY_REGION_ID:
+            case LARGE_PAGE_MEMORY_REGION_ID: {
+                memory_region_access_right *memory_region = (memory_region_access_right *)hdr;
+                memory_region->id = sel4cp_internal_read_unaligned(v1_data, 8);
+                memory_region->vaddr = sel4cp_internal_read_unaligned(v1_data + 8, 8);
+                memory_region->size = sel4cp_internal_read_unaligned(v1_data + 16, 8);
+                memory_region->perms = v1_data[24];
+                memory_region->cached = v1_data[25];
                 break;
             }
             case IRQ_ID: {
-                uint8_t parent_irq_channel_id = *access_right_reader++;
-                uint8_t child_irq_channel_id = *access_right_reader++;
-                
-                sel4cp_internal_set_up_irq(pd, parent_irq_channel_id, child_irq_channel_id);
+                irq_access_right *irq = (irq_access_right *)hdr;
+                irq->parent_irq_channel_id = v1_data[0];
+                irq->child_irq_channel_id = v1_data[1];
+                break;
+            }
+            case LOADER_SYMBOLS_ID: {
+                loader_symbols_access_right *loader_symbols = (loader_symbols_access_right *)hdr;
+                loader_symbols->ipc_buffer_vaddr = sel4cp_internal_read_unaligned(v1_data, 8);
+                loader_symbols->pd_id_vaddr = sel4cp_internal_read_unaligned(v1_data + 8, 8);
                 break;
             }
-            case PROTECTION_DOMAIN_CONTROL_ID: {
-                // This access right has already been handled, so it can just be skipped here.
+            case IMAGE_HASH_ID: {
+                image_hash_access_right *image_hash = (image_hash_access_right *)hdr;
+                image_hash->image_hash = sel4cp_internal_read_unaligned(v1_data, 8);
                 break;
             }
             default:
-                sel4cp_dbg_puts("sel4cp_internal_set_up_access_rights: invalid access right type id: ");
-                sel4cp_dbg_puthex64(access_right_type_id);
-                sel4cp_dbg_puts("\n");
-                return -1;
+                break;
         }
     }
     
     return 0;
 }
 
-static int
-sel4cp_internal_set_up_ipc_buffer(uint8_t *src, sel4cp_pd pd)
-{
-    elf_symbol_table_entry *ipc_buffer_symbol = sel4cp_internal_get_symbol(src, "__sel4_ipc_buffer_obj");
-    if (ipc_buffer_symbol == NULL) {
-        sel4cp_dbg_puts("sel4cp_internal_set_up_ipc_buffer: failed to find the __sel4_ipc_buffer_obj symbol\n");
-        return -1;
-    }
-    uint64_t ipc_buffer_vaddr = ipc_buffer_symbol->st_value;
-    
-    // Allocate the IPC buffer.
-    uint64_t ipc_buffer_cap_idx = sel4cp_internal_allocate_page(
-        ipc_buffer_vaddr, 
-        BASE_VSPACE_CAP + pd, 
-        P_FLAGS_WRITABLE | P_FLAGS_READABLE
-    );
-    if (ipc_buffer_cap_idx == 0) {
-        sel4cp_dbg_puts("sel4cp_internal_set_up_ipc_buffer: failed to allocate a page for the IPC buffer of the PD\n");
-        return -1;
-    }
-    
-    // Set the IPC buffer for the new PD.
-    seL4_Error err = seL4_TCB_SetIPCBuffer(
-        BASE_TCB_CAP + pd,
-        ipc_buffer_vaddr,
-        ipc_buffer_cap_idx
-    );
-    if (err != seL4_NoError) {
-        sel4cp_dbg_puts("sel4cp_internal_set_up_ipc_buffer: failed to set the IPC buffer of the PD\n");
-        return -1;
-    }
-    
-    return 0;
-}
-
-static uint8_t *
-sel4cp_internal_get_pd_id_vaddr(uint8_t *src, sel4cp_pd pd) 
-{
-    elf_symbol_table_entry *pd_id_symbol = sel4cp_internal_get_symbol(src, "sel4cp_current_pd_id");
-    if (pd_id_symbol == NULL) {
-        sel4cp_dbg_puts("sel4cp_internal_get_pd_id_vaddr: failed to find the symbol 'sel4cp_current_pd_id' in the given PD\n");
-        return NULL;
-    }
-    
-    // The value of the pd_id_symbol is the virtual address in the new PD.
-    return (uint8_t *)pd_id_symbol->st_value;
-}
-
 /**
- *  Writes the given data to the given write_target if the current_vaddr
- *  is not the pd_id_vaddr. In this latter case, the given PD id is written instead.
- *
- *  Returns the number of written bytes.
+ *  Returns the first access right of the given type in the given decoded access right table.
+ *  The following access rights of the type are found by adding the size of each access right.
  */
-static uint64_t
-sel4cp_internal_write_elf_data(uint8_t data, uint8_t *write_target, uint64_t current_vaddr, uint64_t pd_id_vaddr, sel4cp_pd pd) 
+static access_right_header *
+sel4cp_internal_get_access_rights(access_right_table *table, uint8_t type_id)
 {
-    if (current_vaddr == pd_id_vaddr) {
-        *((sel4cp_pd *)write_target) = pd;
-        return sizeof(pd);
-    }
-    else {
-        *write_target = data;
-        return sizeof(data);
-    }
+    return (access_right_header *)(table->access_rights + table->index[type_id].offset);
 }
 
 /**
- *  Returns a write_handle that can be used to write data to
- *  the given current_vaddr in the given pd.
+ *  Returns the access right starting at the given offset in the given decoded access right table,
+ *  or NULL if no access right starts there.
  */
-static uint8_t *
-sel4cp_internal_ensure_page_is_allocated(uint8_t *write_handle, uint8_t *src, uint64_t current_vaddr, sel4cp_pd pd, uint32_t p_flags) 
-{
-    // Check if a new page must be allocated, assuming a page size of 0x1000 bytes (4 KiB).
-    if (write_handle == NULL || current_vaddr % 0x1000 == 0) {
-        write_handle = sel4cp_internal_allocate_page_with_write_handle(src, current_vaddr, BASE_VSPACE_CAP + pd, p_flags);
-        if (write_handle == NULL) {
-            sel4cp_dbg_puts("sel4cp_internal_ensure_page_is_allocated: failed to allocate a page required to load the ELF file, vaddr = ");
-            sel4cp_dbg_puthex64(current_vaddr);
-            sel4cp_dbg_puts("\n");
-            return NULL;
+static access_right_header *
+sel4cp_internal_find_access_right(access_right_table *table, uint64_t offset)
+{
+    for (uint8_t type_id = 0; type_id < NUM_ACCESS_RIGHT_TYPES; type_id++) {
+        access_right_header *hdr = sel4cp_internal_get_access_rights(table, type_id);
+        for (uint64_t i = 0; i < table->index[type_id].num_access_rights; i++) {
+            if ((uint8_t *)hdr == table->access_rights + offset) {
+                return hdr;
+            }
+            hdr = (access_right_header *)((uint8_t *)hdr + hdr->size);
         }
     }
-    return write_handle;
+    return NULL;
 }
 
 /**
- *  Moves num_caps_to_copy capabilities from the given pool to the CSpace of the given pd.
- *  
+ *  Decodes the v2 access right table at the given address, of which size bytes are available, into the given table,
+ *  validating every access right, such that a malformed table is rejected before 
+ *  anything is set up for the PD. The table must be aligned to 8 bytes.
+ *  Access rights of types unknown to the loader are ignored, such that new types can be added to the table.
+ *
  *  Returns 0 on success.
- *  Otherwise, -1 is returned.
+ *  Returns -1 if the access right table is invalid.
  */
 static int
-sel4cp_internal_move_pool_caps(uint64_t target_cnode, uint64_t pool_base_cap_idx, uint64_t *alloc_state_idx, uint64_t pool_size, uint64_t num_caps_to_copy) 
+sel4cp_internal_decode_access_right_table(uint8_t *access_rights, uint64_t size, access_right_table *table)
 {
-    for (uint64_t i = 0; i < num_caps_to_copy; i++) {
-        if (*alloc_state_idx >= pool_size) {
-            return -1;
+    access_right_table_header *header = (access_right_table_header *)access_rights;
+    access_right_index_entry *index = (access_right_index_entry *)(access_rights + sizeof(access_right_table_header));
+    if (size < sizeof(access_right_table_header) || header->size > size || header->version != ACCESS_RIGHT_TABLE_VERSION || 
+        header->size < sizeof(access_right_table_header) + header->num_types * sizeof(access_right_index_entry)) 
+    {
+        sel4cp_dbg_puts("sel4cp_internal_decode_access_right_table: invalid access right table header\n");
+        return -1;
+    }
+    
+    table->access_rights = access_rights;
+    table->num_shared_pages = 0;
+    table->has_protection_domain_control = false;
+    table->ipc_buffer_vaddr = 0;
+    table->pd_id_vaddr = 0;
+    table->image_hash = 0;
+    
+    for (uint64_t type_id = 0; type_id < NUM_ACCESS_RIGHT_TYPES; type_id++) {
+        table->index[type_id].offset = 0;
+        table->index[type_id].num_access_rights = 0;
+        if (type_id >= header->num_types || index[type_id].num_access_rights == 0) {
+            continue;
         }
+        table->index[type_id] = index[type_id];
         
-        seL4_Error err = seL4_CNode_Move(
-            target_cnode,
-            pool_base_cap_idx + i,
-            PD_CAP_BITS,
-            BASE_CNODE_CAP + sel4cp_current_pd_id,
-            pool_base_cap_idx + *alloc_state_idx,
-            PD_CAP_BITS
-        );
-        if (err != seL4_NoError) {
-            return -1;
+        uint64_t offset = index[type_id].offset;
+        for (uint64_t i = 0; i < index[type_id].num_access_rights; i++) {
+            access_right_header *hdr = (access_right_header *)(access_rights + offset);
+            if (offset % 8 != 0 || offset + sizeof(access_right_header) > header->size || 
+                hdr->type_id != type_id || hdr->size % 8 != 0 || hdr->size < sel4cp_internal_access_right_sizes[type_id] || 
+                hdr->size > header->size - offset) 
+            {
+                sel4cp_dbg_puts("sel4cp_internal_decode_access_right_table: invalid access right of type ");
+                sel4cp_dbg_puthex64(type_id);
+                sel4cp_dbg_puts("\n");
+                return -1;
+            }
+            offset += hdr->size;
+            
+            switch (type_id) {
+                case CHANNEL_ID: {
+                    channel_access_right *channel = (channel_access_right *)hdr;
+                    if (channel->target_pd >= SEL4CP_MAX_PDS || channel->target_id >= SEL4CP_MAX_CHANNELS || channel->own_id >= SEL4CP_MAX_CHANNELS) {
+                        sel4cp_dbg_puts("sel4cp_internal_decode_access_right_table: invalid channel\n");
+                        return -1;
+                    }
+                    break;
+                }
+                case MEMORY_REGION_ID:
+                case LARGE_PAGE_MEMORY_REGION_ID: {
+                    memory_region_access_right *memory_region = (memory_region_access_right *)hdr;
+                    uint64_t page_size = type_id == LARGE_PAGE_MEMORY_REGION_ID ? 0x200000 : 0x1000;
+                    uint64_t num_pages = memory_region->size / page_size;
+                    if (memory_region->size % page_size != 0 || memory_region->vaddr % page_size != 0 || 
+                        memory_region->id > BASE_UNTYPED_CAP - BASE_SHARED_MEMORY_REGION_PAGES || 
+                        num_pages > BASE_UNTYPED_CAP - BASE_SHARED_MEMORY_REGION_PAGES - memory_region->id) 
+                    {
+                        sel4cp_dbg_puts("sel4cp_internal_decode_access_right_table: invalid memory region\n");
+                        return -1;
+                    }
+                    table->num_shared_pages += num_pages;
+                    break;
+                }
+                case IRQ_ID: {
+                    irq_access_right *irq = (irq_access_right *)hdr;
+                    if (irq->parent_irq_channel_id >= SEL4CP_MAX_CHANNELS || irq->child_irq_channel_id >= SEL4CP_MAX_CHANNELS) {
+                        sel4cp_dbg_puts("sel4cp_internal_decode_access_right_table: invalid IRQ\n");
+                        return -1;
+                    }
+                    break;
+                }
+                case PROTECTION_DOMAIN_CONTROL_ID:
+                    table->has_protection_domain_control = true;
+                    break;
+                case LOADER_SYMBOLS_ID: {
+                    loader_symbols_access_right *loader_symbols = (loader_symbols_access_right *)hdr;
+                    table->ipc_buffer_vaddr = loader_symbols->ipc_buffer_vaddr;
+                    table->pd_id_vaddr = loader_symbols->pd_id_vaddr;
+                    break;
+                }
+                case IMAGE_HASH_ID:
+                    table->image_hash = ((image_hash_access_right *)hdr)->image_hash;
+                    break;
+                default:
+                    break;
+            }
         }
-        *alloc_state_idx += 1;
     }
+    
+    if (table->index[SCHEDULING_ID].num_access_rights > 1 || table->index[LOADER_SYMBOLS_ID].num_access_rights > 1 ||
+        table->index[IMAGE_HASH_ID].num_access_rights > 1) 
+    {
+        sel4cp_dbg_puts("sel4cp_internal_decode_access_right_table: duplicate scheduling, loader symbols, or image hash access right\n");
+        return -1;
+    }
+    // The memory region pages are copied into the CSlots preceding the CSlots for untyped capabilities, 
+    // retyped objects and shared read-only pages.
+    if (table->num_shared_pages > BASE_UNTYPED_CAP - BASE_SHARED_MEMORY_REGION_PAGES) {
+        sel4cp_dbg_puts("sel4cp_internal_decode_access_right_table: too many shared memory region pages for the CNode of the child\n");
+        return -1;
+    }
+    
     return 0;
 }
 
 /**
- *  Returns true if and only if the given ELF program contains a protection_domain_control access right.
+ *  Decodes the access right table of the given ELF program, of which elf_size bytes are available, into the given table,
+ *  see sel4cp_internal_decode_access_right_table. A v1 table is converted to v2 first.
+ *  The table must lie within the available bytes.
+ *  The addresses of the symbols needed by the loader are taken from the loader symbols 
+ *  access right, or from the symbol table if the ELF file has been patched without one.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if the access right table is invalid.
  */
-static bool sel4cp_internal_has_protection_domain_control_access_right(uint8_t *elf_file) {    
+static int
+sel4cp_internal_decode_access_rights(uint8_t *elf_file, uint64_t elf_size, access_right_table *table)
+{
+    if (elf_size < sizeof(elf_header)) {
+        sel4cp_dbg_puts("sel4cp_internal_decode_access_rights: the ELF file is too small\n");
+        return -1;
+    }
+    
     // Get the offset of the access right table, 
     // taking into account that the offset is only 7 bytes long.
     uint64_t access_right_table_offset = *((uint64_t *)(elf_file + EI_ACCESS_RIGHT_TABLE_OFFSET_IDX - 1)) >> 8;
+    if (access_right_table_offset == 0) {
+        sel4cp_dbg_puts("sel4cp_internal_decode_access_rights: the ELF file has not been patched with access rights\n");
+        return -1;
+    }
+    if (access_right_table_offset >= elf_size) {
+        sel4cp_dbg_puts("sel4cp_internal_decode_access_rights: the access right table lies outside the ELF file\n");
+        return -1;
+    }
     
-    uint8_t *access_right_reader = elf_file + access_right_table_offset;
+    // A v2 table is always aligned to 8 bytes and starts with the magic number, whereas a v1 table starts with a count.
+    uint8_t *access_rights = elf_file + access_right_table_offset;
+    uint64_t size = elf_size - access_right_table_offset;
+    if ((uint64_t)access_rights % 8 != 0 || size < sizeof(access_right_table_header) || 
+        ((access_right_table_header *)access_rights)->magic != ACCESS_RIGHT_TABLE_MAGIC) 
+    {
+        if (sel4cp_internal_convert_v1_access_rights(access_rights, size)) {
+            return -1;
+        }
+        access_rights = (uint8_t *)sel4cp_internal_converted_access_rights;
+        size = MAX_CONVERTED_ACCESS_RIGHT_TABLE_SIZE;
+    }
     
-    uint64_t num_access_rights = *((uint64_t *) access_right_reader);
-    access_right_reader += 8;
+    if (sel4cp_internal_decode_access_right_table(access_rights, size, table)) {
+        return -1;
+    }
     
-    // Look for the protection_domain_control access right.
-    for (uint64_t i = 0; i < num_access_rights; i++) {
-        uint8_t access_right_type_id = *access_right_reader++;
-        switch (access_right_type_id) {
-            case SCHEDULING_ID:
-                access_right_reader += 18;
-                break;
-            case CHANNEL_ID:
-                access_right_reader += 3;
-                break;
-            case MEMORY_REGION_ID:
-                access_right_reader += 26;
-                break;
-            case IRQ_ID:
-                access_right_reader += 2;
-                break;
-            case PROTECTION_DOMAIN_CONTROL_ID:
-                return true;
-            default:
-                sel4cp_dbg_puts("sel4cp_internal_has_protection_domain_control_access_right: invalid access right type id: ");
-                sel4cp_dbg_puthex64(access_right_type_id);
-                sel4cp_dbg_puts("\n");
-                return false;
+    // ELF files patched without the loader symbols access right are still supported by searching the symbol table.
+    if (table->index[LOADER_SYMBOLS_ID].num_access_rights == 0) {
+        elf_symbol_table_entry *ipc_buffer_symbol = sel4cp_internal_get_symbol(elf_file, "__sel4_ipc_buffer_obj");
+        elf_symbol_table_entry *pd_id_symbol = sel4cp_internal_get_symbol(elf_file, "sel4cp_current_pd_id");
+        if (ipc_buffer_symbol == NULL || pd_id_symbol == NULL) {
+            sel4cp_dbg_puts("sel4cp_internal_decode_access_rights: failed to find the __sel4_ipc_buffer_obj or the sel4cp_current_pd_id symbol\n");
+            return -1;
         }
+        table->ipc_buffer_vaddr = ipc_buffer_symbol->st_value;
+        table->pd_id_vaddr = pd_id_symbol->st_value;
     }
     
-    return false;
+    return 0;
 }
 
+/**
+ *  Sets the number of objects required from each pool for num_new_pds new PDs, and for the objects
+ *  moved to a PD with the access rights in the given table, indexed by the pool index.
+ */
 static void
-sel4cp_internal_pd_restart(sel4cp_pd pd, uintptr_t entry_point)
+sel4cp_internal_get_pool_requirements(access_right_table *table, uint64_t num_new_pds, uint64_t num_required[NUM_POOLS])
 {
-    seL4_Error err;
-    seL4_UserContext ctxt = {0};
-    ctxt.pc = entry_point;
-    err = seL4_TCB_WriteRegisters(
-        BASE_TCB_CAP + pd,
-        true,
-        0, /* No flags */
-        1, /* writing 1 register */
-        &ctxt
-    );
+    // A PD with the protection_domain_control access right gets the objects for POOL_NUM_PD_TARGETS_CHILD PDs.
+    uint64_t num_child_pds = table->has_protection_domain_control ? POOL_NUM_PD_TARGETS_CHILD : 0;
+    uint64_t num_pds = num_new_pds + num_child_pds;
+    num_required[TCB_POOL_ID] = num_pds;
+    num_required[NOTIFICATION_POOL_ID] = num_pds;
+    num_required[CNODE_POOL_ID] = num_pds;
+    num_required[SCHEDCONTEXT_POOL_ID] = num_pds;
+    num_required[VSPACE_POOL_ID] = num_pds;
+    num_required[PAGE_UPPER_DIRECTORY_POOL_ID] = num_child_pds * 2;
+    num_required[PAGE_DIRECTORY_POOL_ID] = num_child_pds * 4;
+    num_required[PAGE_TABLE_POOL_ID] = num_child_pds * 6;
+    num_required[PAGE_POOL_ID] = num_child_pds * 30;
+}
 
-    if (err != seL4_NoError) {
-        sel4cp_dbg_puts("sel4cp_internal_pd_restart: error writing registers\n");
-        sel4cp_internal_crash(err);
+/**
+ *  Checks that the pools hold the given number of objects of each pool, indexed by the pool index.
+ *  The objects missing from the pools must be retyped from untyped memory, and as the CSlots
+ *  for retyped objects are shared by all pools, the missing objects are counted across all pools.
+ *
+ *  Returns 0 if there are enough objects.
+ *  Returns -1 otherwise.
+ */
+static int
+sel4cp_internal_check_pool_requirements(uint64_t num_required[NUM_POOLS])
+{
+    uint64_t num_missing = 0;
+    for (uint64_t pool = 0; pool < NUM_POOLS; pool++) {
+        uint64_t num_pooled = sel4cp_internal_get_num_pooled_caps(pool);
+        if (num_required[pool] > num_pooled) {
+            num_missing += num_required[pool] - num_pooled;
+        }
     }
+    return num_missing > sel4cp_internal_get_num_retypable_caps() ? -1 : 0;
 }
 
+/**
+ *  Checks that the pools hold enough objects for num_new_pds new PDs, 
+ *  and for the objects moved to a PD with the access rights in the given table.
+ *
+ *  Returns 0 if there are enough objects.
+ *  Returns -1 otherwise.
+ */
+static int
+sel4cp_internal_check_pool_capacity(access_right_table *table, uint64_t num_new_pds)
+{
+    uint64_t num_required[NUM_POOLS];
+    sel4cp_internal_get_pool_requirements(table, num_new_pds, num_required);
+    if (sel4cp_internal_check_pool_requirements(num_required)) {
+        sel4cp_dbg_puts("sel4cp_internal_check_pool_capacity: not enough objects left in the pools\n");
+        return -1;
+    }
+    return 0;
+}
 
 /**
- *  Loads the loadable segments of the ELF file at the given src into the given PD.
- *  Sets up the PD according to the access rights included in the given ELF file.
- *  Starts the PD.
- *  
+ *  Maps the pages of the given memory region into the given PD, and copies their capabilities
+ *  into the CSpace of the PD, starting at the CSlot with the given index, which is advanced past the copies.
+ *
  *  Returns 0 on success.
  *  Returns -1 if an error occurs.
  */
-static int 
-sel4cp_internal_pd_load_elf(uint8_t *src, sel4cp_pd pd) 
+static int
+sel4cp_internal_set_up_memory_region(sel4cp_pd pd, memory_region_access_right *memory_region, uint64_t *shared_page_idx)
 {
-    elf_header *elf_hdr = (elf_header *)src;
+    // Parse the rights and VM attributes.
+    seL4_CapRights_t rights = sel4cp_internal_parse_cap_rights(memory_region->perms);
+    seL4_ARM_VMAttributes vm_attributes = sel4cp_internal_parse_vm_attributes(memory_region->perms, memory_region->cached); 
     
-    uint8_t *pd_id_vaddr = sel4cp_internal_get_pd_id_vaddr(src, pd);
-    if (pd_id_vaddr == NULL) {
-        sel4cp_dbg_puts("selcp_pd_load_elf: failed to get the virtual address of the PD id variable for the given PD\n");
-        return -1;
-    }
-    
-    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
-        elf_program_header *prog_hdr = (elf_program_header *)(src + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
-        if (prog_hdr->p_type != PT_LOAD)
-            continue; // the segment should not be loaded.
+    // Map the memory region into the child PD's VSpace.
+    bool large_pages = memory_region->hdr.type_id == LARGE_PAGE_MEMORY_REGION_ID;
+    uint64_t page_size = large_pages ? 0x200000 : 0x1000;
+    uint64_t pd_vspace_cap = BASE_VSPACE_CAP + pd;
+    uint64_t num_pages = memory_region->size / page_size;
+    for (uint64_t j = 0; j < num_pages; j++) {
+        uint64_t page_cap = BASE_SHARED_MEMORY_REGION_PAGES + memory_region->id + j;
+        uint64_t page_vaddr = memory_region->vaddr + (j * page_size);
         
-        uint8_t *src_read = src + prog_hdr->p_offset;
-        uint64_t current_vaddr = prog_hdr->p_vaddr;
-        uint8_t *dst_write = sel4cp_internal_ensure_page_is_allocated(NULL, src, current_vaddr, pd, prog_hdr->p_flags);
-        if (dst_write == NULL) {
+        // Ensure that all required higher-level paging structures are mapped before mapping this page.
+        if (sel4cp_internal_set_up_required_paging_structures(page_vaddr, BASE_VSPACE_CAP + pd, large_pages)) {
             return -1;
         }
         
-        // Copy the segment bytes from the ELF file.
-        uint64_t j = 0;
-        while (j < prog_hdr->p_filesz) {
-            uint64_t bytes_written = sel4cp_internal_write_elf_data(*src_read, dst_write, current_vaddr, (uint64_t)pd_id_vaddr, pd);
-            j += bytes_written;
-            src_read += bytes_written;
-            dst_write += bytes_written;
-            current_vaddr += bytes_written;
-            
-            dst_write = sel4cp_internal_ensure_page_is_allocated(dst_write, src, current_vaddr, pd, prog_hdr->p_flags);
-            if (dst_write == NULL)
-                return -1;
+        // Map the page into the child PD's VSpace.
+        seL4_Error err = seL4_ARM_Page_Map(
+            page_cap, 
+            pd_vspace_cap, 
+            page_vaddr, 
+            rights, 
+            vm_attributes
+        );
+        if (err != seL4_NoError) {
+            sel4cp_dbg_puts("sel4cp_internal_set_up_memory_region: failed to map page for child\n");
+            sel4cp_dbg_puthex64(err);
+            sel4cp_dbg_puts("\n");
+            return -1;
+        } 
+        if (page_cap < BASE_UNTYPED_CAP) {
+            sel4cp_internal_set_cap_owner(page_cap, pd);
         }
-     
-        // Write the required 0-initialized bytes, if needed.
-        if (prog_hdr->p_memsz > prog_hdr->p_filesz) {
-            uint64_t num_zero_bytes = prog_hdr->p_memsz - prog_hdr->p_filesz;
-            j = 0;
-            while (j < num_zero_bytes) {
-                uint64_t bytes_written = sel4cp_internal_write_elf_data(0, dst_write, current_vaddr, (uint64_t)pd_id_vaddr, pd);
-                j += bytes_written;
-                src_read += bytes_written;
-                dst_write += bytes_written;
-                current_vaddr += bytes_written;
-                
-                dst_write = sel4cp_internal_ensure_page_is_allocated(dst_write, src, current_vaddr, pd, prog_hdr->p_flags);
-                if (dst_write == NULL)
-                    return -1;
-            }
+        // Copy the page capability into the child PD's CSpace.
+        err = seL4_CNode_Copy(
+            BASE_CNODE_CAP + pd,
+            *shared_page_idx,
+            PD_CAP_BITS,
+            BASE_CNODE_CAP + sel4cp_current_pd_id,
+            page_cap,
+            PD_CAP_BITS,
+            seL4_AllRights
+        );
+        if (err != seL4_NoError) {
+            return -1;
+        }
+        *shared_page_idx += 1;
+    }
+    return 0;
+}
+
+/**
+ *  Sets up the access rights in the given decoded access right table in the given PD.
+ *  The protection_domain_control and loader symbols access rights have already been handled while loading.
+ */
+static int 
+sel4cp_internal_set_up_access_rights(access_right_table *table, sel4cp_pd pd) 
+{   
+    if (table->index[SCHEDULING_ID].num_access_rights != 0) {
+        scheduling_access_right *scheduling = (scheduling_access_right *)sel4cp_internal_get_access_rights(table, SCHEDULING_ID);
+        if (sel4cp_internal_set_priority(pd, scheduling->priority, scheduling->mcp) ||
+            sel4cp_internal_set_sched_flags(pd, scheduling->budget, scheduling->period)) 
+        {
+            return -1;
         }
     }
     
-    if (sel4cp_internal_set_up_ipc_buffer(src, pd)) {
-        sel4cp_dbg_puts("sel4cp_internal_pd_load_elf: failed to set up the IPC buffer\n");
-        return -1;
+    access_right_header *hdr = sel4cp_internal_get_access_rights(table, CHANNEL_ID);
+    for (uint64_t i = 0; i < table->index[CHANNEL_ID].num_access_rights; i++) {
+        channel_access_right *channel = (channel_access_right *)hdr;
+        if (sel4cp_internal_set_up_channel(pd, channel->target_pd, channel->own_id, channel->target_id)) {
+            return -1;
+        }
+        hdr = (access_right_header *)((uint8_t *)hdr + hdr->size);
     }
     
-    if (sel4cp_internal_set_up_access_rights(src, pd)) {
-        sel4cp_dbg_puts("sel4cp_internal_pd_load_elf: failed to set up access rights\n");
-        return -1;
+    uint64_t shared_page_idx = BASE_SHARED_MEMORY_REGION_PAGES;
+    hdr = sel4cp_internal_get_access_rights(table, MEMORY_REGION_ID);
+    for (uint64_t i = 0; i < table->index[MEMORY_REGION_ID].num_access_rights; i++) {
+        if (sel4cp_internal_set_up_memory_region(pd, (memory_region_access_right *)hdr, &shared_page_idx)) {
+            return -1;
+        }
+        hdr = (access_right_header *)((uint8_t *)hdr + hdr->size);
+    }
+    hdr = sel4cp_internal_get_access_rights(table, LARGE_PAGE_MEMORY_REGION_ID);
+    for (uint64_t i = 0; i < table->index[LARGE_PAGE_MEMORY_REGION_ID].num_access_rights; i++) {
+        if (sel4cp_internal_set_up_memory_region(pd, (memory_region_access_right *)hdr, &shared_page_idx)) {
+            return -1;
+        }
+        hdr = (access_right_header *)((uint8_t *)hdr + hdr->size);
+    }
+    
+    hdr = sel4cp_internal_get_access_rights(table, IRQ_ID);
+    for (uint64_t i = 0; i < table->index[IRQ_ID].num_access_rights; i++) {
+        irq_access_right *irq = (irq_access_right *)hdr;
+        if (sel4cp_internal_set_up_irq(pd, irq->parent_irq_channel_id, irq->child_irq_channel_id)) {
+            return -1;
+        }
+        hdr = (access_right_header *)((uint8_t *)hdr + hdr->size);
     }
     
-    // Start the program at the specified entry point.
-    sel4cp_internal_pd_restart(pd, elf_hdr->e_entry);
     return 0;
 }
 
-// ========== END OF UTILITY FUNCTIONS ==========
-
-// ========== PUBLIC INTERFACE ==========
-
-static inline void
-sel4cp_notify(sel4cp_channel ch)
+/**
+ *  Sets up the given access right of a decoded access right table in the given PD. 
+ *  The pages of a memory region are copied into the CSpace of the PD starting at the CSlot 
+ *  with the given index, which is advanced past the copies, see sel4cp_internal_set_up_memory_region.
+ *  Access rights that are handled while loading are ignored.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_set_up_access_right(sel4cp_pd pd, access_right_header *hdr, uint64_t *shared_page_idx)
 {
-    seL4_Signal(BASE_OUTPUT_NOTIFICATION_CAP + ch);
+    switch (hdr->type_id) {
+        case SCHEDULING_ID: {
+            scheduling_access_right *scheduling = (scheduling_access_right *)hdr;
+            if (sel4cp_internal_set_priority(pd, scheduling->priority, scheduling->mcp)) {
+                return -1;
+            }
+            return sel4cp_internal_set_sched_flags(pd, scheduling->budget, scheduling->period);
+        }
+        case CHANNEL_ID: {
+            channel_access_right *channel = (channel_access_right *)hdr;
+            return sel4cp_internal_set_up_channel(pd, channel->target_pd, channel->own_id, channel->target_id);
+        }
+        case MEMORY_REGION_ID:
+        case LARGE_PAGE_MEMORY_REGION_ID:
+            return sel4cp_internal_set_up_memory_region(pd, (memory_region_access_right *)hdr, shared_page_idx);
+        case IRQ_ID: {
+            irq_access_right *irq = (irq_access_right *)hdr;
+            return sel4cp_internal_set_up_irq(pd, irq->parent_irq_channel_id, irq->child_irq_channel_id);
+        }
+        default:
+            return 0;
+    }
 }
 
-static inline void
-sel4cp_irq_ack(sel4cp_channel ch)
+static int
+sel4cp_internal_set_up_ipc_buffer(uint64_t ipc_buffer_vaddr, sel4cp_pd pd)
 {
-    seL4_IRQHandler_Ack(BASE_IRQ_CAP + ch);
+    // Allocate the IPC buffer.
+    uint64_t ipc_buffer_cap_idx = sel4cp_internal_allocate_page(
+        ipc_buffer_vaddr, 
+        BASE_VSPACE_CAP + pd, 
+        P_FLAGS_WRITABLE | P_FLAGS_READABLE
+    );
+    if (ipc_buffer_cap_idx == 0) {
+        sel4cp_dbg_puts("sel4cp_internal_set_up_ipc_buffer: failed to allocate a page for the IPC buffer of the PD\n");
+        return -1;
+    }
+    
+    // Set the IPC buffer for the new PD.
+    seL4_Error err = seL4_TCB_SetIPCBuffer(
+        BASE_TCB_CAP + pd,
+        ipc_buffer_vaddr,
+        ipc_buffer_cap_idx
+    );
+    if (err != seL4_NoError) {
+        sel4cp_dbg_puts("sel4cp_internal_set_up_ipc_buffer: failed to set the IPC buffer of the PD\n");
+        return -1;
+    }
+    
+    return 0;
 }
 
+/**
+ *  Copies len bytes from src to dst.
+ *  If src and dst have the same alignment, which is the case when copying a loadable segment
+ *  from an ELF file to the page it is loaded into, the bytes are copied 8 bytes at a time.
+ */
 static void
-sel4cp_pd_stop(sel4cp_pd pd)
+sel4cp_internal_copy_bytes(uint8_t *dst, uint8_t *src, uint64_t len)
 {
-    seL4_Error err;
-    err = seL4_TCB_Suspend(BASE_TCB_CAP + pd);
-    if (err != seL4_NoError) {
-        sel4cp_dbg_puts("sel4cp_pd_stop: error writing registers\n");
-        sel4cp_internal_crash(err);
+    if ((uint64_t)dst % 8 == (uint64_t)src % 8) {
+        while (len > 0 && (uint64_t)dst % 8 != 0) {
+            *dst++ = *src++;
+            len--;
+        }
+        for (; len >= 8; len -= 8, dst += 8, src += 8) {
+            *((uint64_t *)dst) = *((uint64_t *)src);
+        }
+    }
+    while (len > 0) {
+        *dst++ = *src++;
+        len--;
     }
 }
 
-static inline sel4cp_msginfo
-sel4cp_ppcall(sel4cp_channel ch, sel4cp_msginfo msginfo)
+/**
+ *  Writes the given PD id to the given pd_id_vaddr, which is part of 
+ *  the page in the CSlot with the given index in the current PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_write_pd_id(uint64_t page_cap_idx, uint64_t pd_id_vaddr, sel4cp_pd pd)
 {
-    return seL4_Call(BASE_OUTPUT_ENDPOINT_CAP + ch, msginfo);
+    uint8_t *write_handle = sel4cp_internal_map_page_with_write_handle(page_cap_idx, pd_id_vaddr);
+    if (write_handle == NULL) {
+        return -1;
+    }
+    *((sel4cp_pd *)write_handle) = pd;
+    return 0;
 }
 
-static inline sel4cp_msginfo
-sel4cp_msginfo_new(uint64_t label, uint16_t count)
+/**
+ *  Returns true if the pages of the given loadable segment of an ELF file with the given
+ *  decoded access right table can be shared between PDs running the ELF file:
+ *  the ELF file has an image hash, and the segment is read-only and does not hold the PD id variable.
+ */
+static bool
+sel4cp_internal_is_shareable_segment(access_right_table *table, elf_program_header *prog_hdr)
 {
-    return seL4_MessageInfo_new(label, 0, 0, count);
+    return table->index[IMAGE_HASH_ID].num_access_rights != 0 && 
+           !(prog_hdr->p_flags & P_FLAGS_WRITABLE) && prog_hdr->p_memsz != 0 &&
+           (table->pd_id_vaddr < prog_hdr->p_vaddr || table->pd_id_vaddr >= prog_hdr->p_vaddr + prog_hdr->p_memsz);
 }
 
-static inline uint64_t
-sel4cp_msginfo_get_label(sel4cp_msginfo msginfo)
+/**
+ *  Returns the recorded read-only segment of an ELF file with the given image hash
+ *  that matches the given program header, or NULL if there is none.
+ */
+static shared_segment *
+sel4cp_internal_find_shared_segment(uint64_t image_hash, elf_program_header *prog_hdr)
 {
-    return seL4_MessageInfo_get_label(msginfo);
+    for (uint64_t i = 0; i < alloc_state.num_shared_segments; i++) {
+        shared_segment *segment = &alloc_state.shared_segments[i];
+        if (segment->num_pds != 0 && segment->image_hash == image_hash && segment->vaddr == prog_hdr->p_vaddr && 
+            segment->memsz == prog_hdr->p_memsz && segment->p_flags == prog_hdr->p_flags) 
+        {
+            return segment;
+        }
+    }
+    return NULL;
 }
 
+/**
+ *  Records that the given read-only segment of an ELF file with the given image hash has been loaded
+ *  into pages of the page pool mapped into the given PD, which are then recorded with the segment instead of the PD.
+ *  If no more segments can be recorded, or not all pages of the segment are mapped into the PD, nothing is done, 
+ *  such that the segment is copied again when it is required.
+ */
 static void
-sel4cp_mr_set(uint8_t mr, uint64_t value)
-{
-    seL4_SetMR(mr, value);
-}
-
-static uint64_t
-sel4cp_mr_get(uint8_t mr)
+sel4cp_internal_record_shared_segment(uint64_t image_hash, elf_program_header *prog_hdr, sel4cp_pd pd)
 {
-    return seL4_GetMR(mr);
+    if (sel4cp_internal_find_shared_segment(image_hash, prog_hdr) != NULL) {
+        return;
+    }
+    uint64_t segment_idx = 0;
+    while (segment_idx < alloc_state.num_shared_segments && alloc_state.shared_segments[segment_idx].num_pds != 0) {
+        segment_idx++;
+    }
+    if (segment_idx >= MAX_SHARED_SEGMENTS) {
+        return;
+    }
+    
+    uint64_t first_page_vaddr = sel4cp_internal_mask_bits(prog_hdr->p_vaddr, 12);
+    uint64_t num_pages = (sel4cp_internal_mask_bits(prog_hdr->p_vaddr + prog_hdr->p_memsz - 1, 12) - first_page_vaddr) / 0x1000 + 1;
+    for (uint64_t i = 0; i < num_pages; i++) {
+        if (sel4cp_internal_find_page(pd + 1, first_page_vaddr + i * 0x1000) == 0) {
+            return;
+        }
+    }
+    for (uint64_t i = 0; i < num_pages; i++) {
+        uint64_t page_cap_idx = sel4cp_internal_find_page(pd + 1, first_page_vaddr + i * 0x1000);
+        alloc_state.cap_owners[page_cap_idx - BASE_TCB_POOL] = SHARED_SEGMENT_OWNER + segment_idx;
+    }
+    
+    shared_segment *segment = &alloc_state.shared_segments[segment_idx];
+    segment->image_hash = image_hash;
+    segment->vaddr = prog_hdr->p_vaddr;
+    segment->memsz = prog_hdr->p_memsz;
+    segment->p_flags = prog_hdr->p_flags;
+    segment->num_pages = num_pages;
+    segment->pd = pd;
+    segment->num_pds = 1;
+    alloc_state.pd_shared_segments[pd] |= 1ULL << segment_idx;
+    if (segment_idx == alloc_state.num_shared_segments) {
+        alloc_state.num_shared_segments++;
+    }
 }
 
 /**
- *  Creates a new PD with the given id and loads the statically linked
-    ELF file pointed to by src in this new PD.
- *  Precondition: No PD with the given id already exists in the system.
- *  Precondition: src != NULL.
+ *  Maps the pages of the given recorded segment into the given PD. A page capability can only be mapped once,
+ *  so a copy of each page capability is mapped, which is then moved into the CSpace of the PD
+ *  at the CSlot with the given index, which is advanced past the copies.
  *
  *  Returns 0 on success.
  *  Returns -1 if an error occurs.
  */
 static int
-sel4cp_pd_create(sel4cp_pd pd, uint8_t *src) 
+sel4cp_internal_map_shared_segment(shared_segment *segment, sel4cp_pd pd, uint64_t *shared_frame_idx)
 {
-    if (src == NULL) {
-        sel4cp_dbg_puts("sel4cp_pd_create: invalid ELF program\n");
-        return -1;
-    }
-
-    // Allocate a CNode for the new PD.
-    if (alloc_state.cnode_idx >= POOL_NUM_CNODES) {
-        return -1;
+    seL4_CapRights_t rights = sel4cp_internal_parse_cap_rights((uint8_t)segment->p_flags);
+    seL4_ARM_VMAttributes vm_attributes = sel4cp_internal_parse_vm_attributes((uint8_t)segment->p_flags, true);
+    
+    // The segment is recorded with the PD first, such that the copies are deleted if the PD is destroyed.
+    uint64_t segment_idx = segment - alloc_state.shared_segments;
+    if (!(alloc_state.pd_shared_segments[pd] & (1ULL << segment_idx))) {
+        alloc_state.pd_shared_segments[pd] |= 1ULL << segment_idx;
+        segment->num_pds++;
     }
-    uint64_t cnode_cap = BASE_CNODE_POOL + alloc_state.cnode_idx;
-    alloc_state.cnode_idx++;
     
-    // Move capabilities for unused pool objects to the new PD, if required.
-    if (sel4cp_internal_has_protection_domain_control_access_right(src)) {
-        if (sel4cp_internal_move_pool_caps(cnode_cap, BASE_TCB_POOL, &alloc_state.tcb_idx, POOL_NUM_TCBS, POOL_NUM_PD_TARGETS_CHILD) ||
-            sel4cp_internal_move_pool_caps(cnode_cap, BASE_NOTIFICATION_POOL, &alloc_state.notification_idx, POOL_NUM_NOTIFICATIONS, POOL_NUM_PD_TARGETS_CHILD) ||
-            sel4cp_internal_move_pool_caps(cnode_cap, BASE_CNODE_POOL, &alloc_state.cnode_idx, POOL_NUM_CNODES, POOL_NUM_PD_TARGETS_CHILD) ||
-            sel4cp_internal_move_pool_caps(cnode_cap, BASE_SCHEDCONTEXT_POOL, &alloc_state.schedcontext_idx, POOL_NUM_SCHEDCONTEXTS, POOL_NUM_PD_TARGETS_CHILD) ||
-            sel4cp_internal_move_pool_caps(cnode_cap, BASE_VSPACE_POOL, &alloc_state.vspace_idx, POOL_NUM_VSPACES, POOL_NUM_PD_TARGETS_CHILD) ||
-            sel4cp_internal_move_pool_caps(cnode_cap, BASE_PAGE_UPPER_DIRECTORY_POOL, &alloc_state.page_upper_directory_idx, POOL_NUM_PAGE_UPPER_DIRECTORIES, POOL_NUM_PD_TARGETS_CHILD * 2) ||
-            sel4cp_internal_move_pool_caps(cnode_cap, BASE_PAGE_DIRECTORY_POOL, &alloc_state.page_directory_idx, POOL_NUM_PAGE_DIRECTORIES, POOL_NUM_PD_TARGETS_CHILD * 4) ||
-            sel4cp_internal_move_pool_caps(cnode_cap, BASE_PAGE_TABLE_POOL, &alloc_state.page_table_idx, POOL_NUM_PAGE_TABLES, POOL_NUM_PD_TARGETS_CHILD * 6) ||
-            sel4cp_internal_move_pool_caps(cnode_cap, BASE_PAGE_POOL, &alloc_state.page_idx, POOL_NUM_PAGES, POOL_NUM_PD_TARGETS_CHILD * 30)) 
-        {    
-            sel4cp_dbg_puts("sel4cp_pd_create: failed to move capabilities for unused pool objects to the new PD\n");
+    uint64_t page_vaddr = sel4cp_internal_mask_bits(segment->vaddr, 12);
+    for (uint64_t i = 0; i < segment->num_pages; i++) {
+        if (sel4cp_internal_set_up_required_paging_structures(page_vaddr, BASE_VSPACE_CAP + pd, false)) {
             return -1;
         }
-    }
-    
-
-    // Allocate a TCB for the new PD.
-    if (alloc_state.tcb_idx >= POOL_NUM_TCBS) {
-        return -1;
-    }
-    uint64_t tcb_cap = BASE_TCB_POOL + alloc_state.tcb_idx;
-    alloc_state.tcb_idx++;
-    
-    // Allocate a notification for the new PD.
-    if (alloc_state.notification_idx >= POOL_NUM_NOTIFICATIONS) {
+        uint64_t page_cap_idx = sel4cp_internal_find_page(SHARED_SEGMENT_OWNER + segment_idx, page_vaddr);
+        if (page_cap_idx == 0) {
+            sel4cp_dbg_puts("sel4cp_internal_map_shared_segment: a page of the shared segment is missing\n");
+            return -1;
+        }
+        
+        // The copy is derived with the rights of the mapping, such that it cannot be used to write to the page.
+        uint64_t temp_cap = sel4cp_internal_allocate_temp_cap();
+        seL4_Error err = seL4_CNode_Copy(
+            BASE_CNODE_CAP + sel4cp_current_pd_id,
+            temp_cap,
+            PD_CAP_BITS,
+            BASE_CNODE_CAP + sel4cp_current_pd_id,
+            page_cap_idx,
+            PD_CAP_BITS,
+            rights
+        );
+        if (err == seL4_NoError) {
+            err = seL4_ARM_Page_Map(
+                temp_cap,
+                BASE_VSPACE_CAP + pd,
+                page_vaddr,
+                rights,
+                vm_attributes
+            );
+        }
+        if (err == seL4_NoError) {
+            err = seL4_CNode_Move(
+                BASE_CNODE_CAP + pd,
+                *shared_frame_idx,
+                PD_CAP_BITS,
+                BASE_CNODE_CAP + sel4cp_current_pd_id,
+                temp_cap,
+                PD_CAP_BITS
+            );
+        }
+        if (err != seL4_NoError) {
+            sel4cp_dbg_puts("sel4cp_internal_map_shared_segment: failed to map a shared page; error code = ");
+            sel4cp_dbg_puthex64(err);
+            sel4cp_dbg_puts("\n");
+            return -1;
+        }
+        
+        *shared_frame_idx += 1;
+        page_vaddr += 0x1000;
+    }
+    return 0;
+}
+
+/**
+ *  Moves num_caps_to_copy capabilities from the pool with the given index to the CSpace of the given pd, 
+ *  whose CNode is target_cnode, where they are placed in the CSlots of the same pool in order.
+ *  The objects may be taken from anywhere in the pool of the current PD.
+ *  The moved capabilities are recorded with the PD, such that they can be moved back, see allocation_state.
+ *  
+ *  Returns 0 on success.
+ *  Otherwise, -1 is returned.
+ */
+static int
+sel4cp_internal_move_pool_caps(sel4cp_pd pd, uint64_t target_cnode, uint64_t pool, uint64_t num_caps_to_copy) 
+{
+    for (uint64_t i = 0; i < num_caps_to_copy; i++) {
+        uint64_t cap_idx = sel4cp_internal_allocate_pool_cap(pd, pool);
+        if (cap_idx == 0) {
+            return -1;
+        }
+        
+        seL4_Error err = seL4_CNode_Move(
+            target_cnode,
+            sel4cp_internal_pool_bases[pool] + i,
+            PD_CAP_BITS,
+            BASE_CNODE_CAP + sel4cp_current_pd_id,
+            cap_idx,
+            PD_CAP_BITS
+        );
+        if (err != seL4_NoError) {
+            sel4cp_internal_free_pool_cap(cap_idx);
+            return -1;
+        }
+        alloc_state.moved_pool_caps[cap_idx - BASE_TCB_POOL] = i + 1;
+    }
+    return 0;
+}
+
+/**
+ *  Starts the given PD at the given entry point.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_pd_restart(sel4cp_pd pd, uintptr_t entry_point)
+{
+    seL4_Error err;
+    seL4_UserContext ctxt = {0};
+    ctxt.pc = entry_point;
+    err = seL4_TCB_WriteRegisters(
+        BASE_TCB_CAP + pd,
+        true,
+        0, /* No flags */
+        1, /* writing 1 register */
+        &ctxt
+    );
+
+    if (err != seL4_NoError) {
+        sel4cp_dbg_puts("sel4cp_internal_pd_restart: error writing registers\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ *  Allocates a CNode for the given new PD.
+ *
+ *  Returns the index of the CSlot with the CNode capability in the current PD.
+ *  Returns 0 if no CNode is available.
+ */
+static uint64_t
+sel4cp_internal_allocate_cnode(sel4cp_pd pd)
+{
+    return sel4cp_internal_allocate_pool_cap(pd, CNODE_POOL_ID);
+}
+
+/**
+ *  Moves capabilities for unused pool objects to the CNode of the given PD in the given cnode_cap CSlot,
+ *  such that the PD can create POOL_NUM_PD_TARGETS_CHILD PDs itself.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_move_unused_pool_caps(sel4cp_pd pd, uint64_t cnode_cap)
+{
+    if (sel4cp_internal_move_pool_caps(pd, cnode_cap, TCB_POOL_ID, POOL_NUM_PD_TARGETS_CHILD) ||
+        sel4cp_internal_move_pool_caps(pd, cnode_cap, NOTIFICATION_POOL_ID, POOL_NUM_PD_TARGETS_CHILD) ||
+        sel4cp_internal_move_pool_caps(pd, cnode_cap, CNODE_POOL_ID, POOL_NUM_PD_TARGETS_CHILD) ||
+        sel4cp_internal_move_pool_caps(pd, cnode_cap, SCHEDCONTEXT_POOL_ID, POOL_NUM_PD_TARGETS_CHILD) ||
+        sel4cp_internal_move_pool_caps(pd, cnode_cap, VSPACE_POOL_ID, POOL_NUM_PD_TARGETS_CHILD) ||
+        sel4cp_internal_move_pool_caps(pd, cnode_cap, PAGE_UPPER_DIRECTORY_POOL_ID, POOL_NUM_PD_TARGETS_CHILD * 2) ||
+        sel4cp_internal_move_pool_caps(pd, cnode_cap, PAGE_DIRECTORY_POOL_ID, POOL_NUM_PD_TARGETS_CHILD * 4) ||
+        sel4cp_internal_move_pool_caps(pd, cnode_cap, PAGE_TABLE_POOL_ID, POOL_NUM_PD_TARGETS_CHILD * 6) ||
+        sel4cp_internal_move_pool_caps(pd, cnode_cap, PAGE_POOL_ID, POOL_NUM_PD_TARGETS_CHILD * 30)) 
+    {    
+        sel4cp_dbg_puts("sel4cp_internal_move_unused_pool_caps: failed to move capabilities for unused pool objects to the new PD\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  Allocates the kernel objects of the given PD, apart from its CNode which is given
+ *  by cnode_cap, and sets up the fixed capabilities of the PD. 
+ *  The PD is not started, as no program has been loaded into it yet.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_pd_create_objects(sel4cp_pd pd, uint64_t cnode_cap)
+{
+    // Allocate a TCB for the new PD.
+    uint64_t tcb_cap = sel4cp_internal_allocate_pool_cap(pd, TCB_POOL_ID);
+    if (tcb_cap == 0) {
+        return -1;
+    }
+    
+    // Allocate a notification for the new PD.
+    uint64_t notification_cap = sel4cp_internal_allocate_pool_cap(pd, NOTIFICATION_POOL_ID);
+    if (notification_cap == 0) {
         return -1;
     }
-    uint64_t notification_cap = BASE_NOTIFICATION_POOL + alloc_state.notification_idx;
-    alloc_state.notification_idx++;
     
     // Allocate a SchedContext for the new PD.
-    if (alloc_state.schedcontext_idx >= POOL_NUM_SCHEDCONTEXTS) {
+    uint64_t schedcontext_cap = sel4cp_internal_allocate_pool_cap(pd, SCHEDCONTEXT_POOL_ID);
+    if (schedcontext_cap == 0) {
         return -1;
     }
-    uint64_t schedcontext_cap = BASE_SCHEDCONTEXT_POOL + alloc_state.schedcontext_idx;
-    alloc_state.schedcontext_idx++;
 
     // Allocate a VSpace for the new PD.
-    if (alloc_state.vspace_idx >= POOL_NUM_VSPACES) {
+    uint64_t vspace_cap = sel4cp_internal_allocate_pool_cap(pd, VSPACE_POOL_ID);
+    if (vspace_cap == 0) {
         return -1;
     }
-    uint64_t vspace_cap = BASE_VSPACE_POOL + alloc_state.vspace_idx;
-    alloc_state.vspace_idx++;
     
     // Assign the VSpace to the same ASID pool as all other VSpaces in the system.
+    // An ASID cannot be unassigned, so a VSpace returned to its pool by a failed or destroyed PD
+    // keeps its ASID, in which case seL4 reports seL4_InvalidCapability.
     seL4_Error err = seL4_ARM_ASIDPool_Assign(ASID_POOL_CAP_IDX, vspace_cap);
-    if (err != seL4_NoError) {
+    if (err != seL4_NoError && err != seL4_InvalidCapability) {
         return -1;
     }
     
@@ -1324,9 +2653,13 @@ sel4cp_pd_create(sel4cp_pd pd, uint8_t *src)
     
     
     // Set the VSpace, CSpace, and fault endpoint.
+    uint64_t fault_ep_cap = sel4cp_internal_get_fault_ep(pd);
+    if (fault_ep_cap == 0) {
+        return -1;
+    }
     err = seL4_TCB_SetSpace(
         tcb_cap,
-        FAULT_EP_CAP_IDX,
+        fault_ep_cap,
         cnode_cap,
         64 - PD_CAP_BITS,
         vspace_cap,
@@ -1344,9 +2677,1955 @@ sel4cp_pd_create(sel4cp_pd pd, uint8_t *src)
     if (err != seL4_NoError) {
         return -1;
     }
+    
+    return 0;
+}
+
+/**
+ *  Returns the program header of the loadable segment of the ELF file at the given src
+ *  that holds the given vaddr, or NULL if there is none.
+ */
+static elf_program_header *
+sel4cp_internal_find_loadable_segment(uint8_t *src, uint64_t vaddr)
+{
+    elf_header *elf_hdr = (elf_header *)src;
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(src + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
+        if (prog_hdr->p_type == PT_LOAD && vaddr >= prog_hdr->p_vaddr && vaddr < prog_hdr->p_vaddr + prog_hdr->p_memsz) {
+            return prog_hdr;
+        }
+    }
+    return NULL;
+}
+
+/**
+ *  Allocates the page holding the given vaddr of the given loadable segment of the ELF file at the given src,
+ *  maps it into the given PD, and copies the bytes of the segment in the ELF file that belong to the page.
+ *  The remaining bytes of the page are already 0-initialized, as the page has just been allocated,
+ *  so pages without any bytes from the ELF file are not mapped into the current PD at all.
+ *
+ *  Returns the index of the CSlot containing the page in the current PD on success.
+ *  Returns 0 if an error occurs.
+ */
+static uint64_t
+sel4cp_internal_load_page(uint8_t *src, sel4cp_pd pd, elf_program_header *prog_hdr, uint64_t vaddr)
+{
+    uint64_t page_cap_idx = sel4cp_internal_allocate_page(vaddr, BASE_VSPACE_CAP + pd, prog_hdr->p_flags);
+    if (page_cap_idx == 0) {
+        sel4cp_dbg_puts("sel4cp_internal_load_page: failed to allocate a page required to load the ELF file, vaddr = ");
+        sel4cp_dbg_puthex64(vaddr);
+        sel4cp_dbg_puts("\n");
+        return 0;
+    }
+    
+    uint64_t page_start = sel4cp_internal_mask_bits(vaddr, 12);
+    uint64_t file_end = prog_hdr->p_vaddr + prog_hdr->p_filesz;
+    uint64_t start = page_start > prog_hdr->p_vaddr ? page_start : prog_hdr->p_vaddr;
+    uint64_t end = page_start + 0x1000 < file_end ? page_start + 0x1000 : file_end;
+    if (start < end) {
+        uint8_t *dst_write = sel4cp_internal_map_page_with_write_handle(page_cap_idx, start);
+        if (dst_write == NULL) {
+            return 0;
+        }
+        sel4cp_internal_copy_bytes(dst_write, src + prog_hdr->p_offset + (start - prog_hdr->p_vaddr), end - start);
+    }
+    return page_cap_idx;
+}
+
+/**
+ *  Completes loading a program into the given PD once its pages have been loaded: 
+ *  sets up the IPC buffer and the access rights in the given decoded access right table 
+ *  of the program, and starts the PD at the given entry point.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_pd_finish_load(uint64_t entry_point, sel4cp_pd pd, access_right_table *table)
+{
+    if (sel4cp_internal_set_up_ipc_buffer(table->ipc_buffer_vaddr, pd)) {
+        sel4cp_dbg_puts("sel4cp_internal_pd_finish_load: failed to set up the IPC buffer\n");
+        return -1;
+    }
+    
+    if (sel4cp_internal_set_up_access_rights(table, pd)) {
+        sel4cp_dbg_puts("sel4cp_internal_pd_finish_load: failed to set up access rights\n");
+        return -1;
+    }
+    
+    // Start the program at the specified entry point.
+    return sel4cp_internal_pd_restart(pd, entry_point);
+}
+
+/**
+ *  Loads the loadable segments of the ELF file at the given src into the given PD.
+ *  The pages of read-only segments that have already been loaded for an ELF file with the same
+ *  image hash are shared instead of copied.
+ *  Sets up the PD according to the given decoded access right table of the ELF file.
+ *  Starts the PD.
+ *  
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int 
+sel4cp_internal_pd_load_elf(uint8_t *src, sel4cp_pd pd, access_right_table *table) 
+{
+    elf_header *elf_hdr = (elf_header *)src;
+    uint64_t pd_id_vaddr = table->pd_id_vaddr;
+    
+    // The page holding the PD id variable, which is written once all segments have been loaded.
+    uint64_t pd_id_page_cap_idx = 0;
+    // The CSlot in the CNode of the PD for the next copy of a shared page.
+    uint64_t shared_frame_idx = BASE_SHARED_FRAME_CAP;
+    
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(src + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
+        if (prog_hdr->p_type != PT_LOAD)
+            continue; // the segment should not be loaded.
         
-    // Start the specified program in the new PD.
-    return sel4cp_internal_pd_load_elf(src, pd);
+        bool shareable = sel4cp_internal_is_shareable_segment(table, prog_hdr);
+        if (shareable) {
+            shared_segment *segment = sel4cp_internal_find_shared_segment(table->image_hash, prog_hdr);
+            if (segment != NULL && shared_frame_idx + segment->num_pages <= BASE_TEMP_CAP) {
+                if (sel4cp_internal_map_shared_segment(segment, pd, &shared_frame_idx)) {
+                    return -1;
+                }
+                continue;
+            }
+        }
+        // Load the segment one page at a time, assuming a page size of 0x1000 bytes (4 KiB).
+        uint64_t current_vaddr = prog_hdr->p_vaddr;
+        uint64_t segment_end = prog_hdr->p_vaddr + prog_hdr->p_memsz;
+        while (current_vaddr < segment_end) {
+            uint64_t page_cap_idx = sel4cp_internal_load_page(src, pd, prog_hdr, current_vaddr);
+            if (page_cap_idx == 0) {
+                return -1;
+            }
+            uint64_t page_end = sel4cp_internal_mask_bits(current_vaddr, 12) + 0x1000;
+            if (page_end > segment_end) {
+                page_end = segment_end;
+            }
+            if (pd_id_vaddr >= current_vaddr && pd_id_vaddr < page_end) {
+                pd_id_page_cap_idx = page_cap_idx;
+            }
+            current_vaddr = page_end;
+        }
+        
+        if (shareable) {
+            sel4cp_internal_record_shared_segment(table->image_hash, prog_hdr, pd);
+        }
+    }
+    
+    if (pd_id_page_cap_idx == 0) {
+        sel4cp_dbg_puts("sel4cp_internal_pd_load_elf: the PD id variable is not part of a loadable segment\n");
+        return -1;
+    }
+    if (sel4cp_internal_write_pd_id(pd_id_page_cap_idx, pd_id_vaddr, pd)) {
+        return -1;
+    }
+    
+    return sel4cp_internal_pd_finish_load(((elf_header *)src)->e_entry, pd, table);
+}
+
+/**
+ *  Loads the ELF file at the given src into the given PD on demand: only the pages holding 
+ *  the entry point and the PD id variable are loaded before the PD is started, apart from 
+ *  the pages of read-only segments that can be shared. All other pages of the loadable segments,
+ *  including the stack, are loaded when the PD first accesses them, see sel4cp_pd_handle_fault.
+ *  Sets up the PD according to the given decoded access right table of the ELF file.
+ *  Starts the PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_pd_load_elf_lazily(uint8_t *src, sel4cp_pd pd, access_right_table *table)
+{
+    elf_header *elf_hdr = (elf_header *)src;
+    uint64_t pd_id_vaddr = table->pd_id_vaddr;
+    uint64_t pd_id_page_cap_idx = 0;
+    uint64_t shared_frame_idx = BASE_SHARED_FRAME_CAP;
+    
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(src + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
+        if (prog_hdr->p_type != PT_LOAD)
+            continue; // the segment should not be loaded.
+        
+        // Mapping the pages of a shared segment does not require copying, so they are mapped right away.
+        if (sel4cp_internal_is_shareable_segment(table, prog_hdr)) {
+            shared_segment *segment = sel4cp_internal_find_shared_segment(table->image_hash, prog_hdr);
+            if (segment != NULL && shared_frame_idx + segment->num_pages <= BASE_TEMP_CAP) {
+                if (sel4cp_internal_map_shared_segment(segment, pd, &shared_frame_idx)) {
+                    return -1;
+                }
+                continue;
+            }
+        }
+        
+        uint64_t segment_end = prog_hdr->p_vaddr + prog_hdr->p_memsz;
+        uint64_t entry_page_cap_idx = 0;
+        if (elf_hdr->e_entry >= prog_hdr->p_vaddr && elf_hdr->e_entry < segment_end) {
+            entry_page_cap_idx = sel4cp_internal_load_page(src, pd, prog_hdr, elf_hdr->e_entry);
+            if (entry_page_cap_idx == 0) {
+                return -1;
+            }
+        }
+        if (pd_id_vaddr >= prog_hdr->p_vaddr && pd_id_vaddr < segment_end) {
+            if (entry_page_cap_idx != 0 && sel4cp_internal_mask_bits(pd_id_vaddr, 12) == sel4cp_internal_mask_bits(elf_hdr->e_entry, 12)) {
+                pd_id_page_cap_idx = entry_page_cap_idx;
+            }
+            else {
+                pd_id_page_cap_idx = sel4cp_internal_load_page(src, pd, prog_hdr, pd_id_vaddr);
+                if (pd_id_page_cap_idx == 0) {
+                    return -1;
+                }
+            }
+        }
+    }
+    
+    if (pd_id_page_cap_idx == 0) {
+        sel4cp_dbg_puts("sel4cp_internal_pd_load_elf_lazily: the PD id variable is not part of a loadable segment\n");
+        return -1;
+    }
+    if (sel4cp_internal_write_pd_id(pd_id_page_cap_idx, pd_id_vaddr, pd)) {
+        return -1;
+    }
+    
+    return sel4cp_internal_pd_finish_load(((elf_header *)src)->e_entry, pd, table);
+}
+
+/**
+ *  Writes len bytes from data to the given vaddr of the loadable segment with the
+ *  given program header in the streamed ELF file. If data is NULL, the bytes are 0-initialized.
+ *  The bytes must directly follow the bytes previously written to the segment, if any,
+ *  such that pages only have to be allocated when the start of the segment or 
+ *  a page boundary is reached.
+ *  As newly allocated pages are 0-initialized, nothing has to be written for 0-initialized bytes, 
+ *  and pages that only hold such bytes are not mapped into the current PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_stream_write_segment(sel4cp_elf_stream *stream, elf_program_header *prog_hdr, uint64_t vaddr, uint8_t *data, uint64_t len)
+{
+    while (len > 0) {
+        if (vaddr == prog_hdr->p_vaddr || vaddr % 0x1000 == 0) {
+            uint64_t page_cap_idx = sel4cp_internal_allocate_page(vaddr, BASE_VSPACE_CAP + stream->pd, prog_hdr->p_flags);
+            if (page_cap_idx == 0) {
+                sel4cp_dbg_puts("sel4cp_internal_stream_write_segment: failed to allocate a page required to load the ELF file, vaddr = ");
+                sel4cp_dbg_puthex64(vaddr);
+                sel4cp_dbg_puts("\n");
+                return -1;
+            }
+            stream->write_page_cap = page_cap_idx;
+        }
+        
+        // Write the bytes belonging to the current page.
+        uint64_t num_bytes = 0x1000 - (vaddr % 0x1000);
+        if (num_bytes > len) {
+            num_bytes = len;
+        }
+        if (data != NULL) {
+            uint8_t *write_handle = sel4cp_internal_map_page_with_write_handle(stream->write_page_cap, vaddr);
+            if (write_handle == NULL) {
+                return -1;
+            }
+            sel4cp_internal_copy_bytes(write_handle, data, num_bytes);
+            data += num_bytes;
+        }
+        vaddr += num_bytes;
+        len -= num_bytes;
+    }
+    return 0;
+}
+
+/**
+ *  Loads the len bytes at the given offset in the streamed ELF file, which are given by data,
+ *  into the loadable segments they belong to. The 0-initialized bytes of a segment
+ *  are written as soon as the last byte of the segment in the ELF file has been loaded.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_stream_load_range(sel4cp_elf_stream *stream, uint64_t offset, uint8_t *data, uint64_t len)
+{
+    elf_header *elf_hdr = (elf_header *)stream->metadata;
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(stream->metadata + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
+        if (prog_hdr->p_type != PT_LOAD)
+            continue; // the segment should not be loaded.
+        
+        // Find the bytes of the range that belong to the segment.
+        uint64_t segment_end = prog_hdr->p_offset + prog_hdr->p_filesz;
+        uint64_t start = offset > prog_hdr->p_offset ? offset : prog_hdr->p_offset;
+        uint64_t end = offset + len < segment_end ? offset + len : segment_end;
+        if (start >= end)
+            continue;
+        
+        if (sel4cp_internal_stream_write_segment(stream, prog_hdr, prog_hdr->p_vaddr + (start - prog_hdr->p_offset), data + (start - offset), end - start)) {
+            return -1;
+        }
+        
+        // Allocate the pages of the 0-initialized bytes once the segment has been loaded, if needed.
+        if (end == segment_end && prog_hdr->p_memsz > prog_hdr->p_filesz) {
+            if (sel4cp_internal_stream_write_segment(stream, prog_hdr, prog_hdr->p_vaddr + prog_hdr->p_filesz, NULL, prog_hdr->p_memsz - prog_hdr->p_filesz)) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Creates the PD of the given stream once the ELF header and the program headers have been received,
+ *  and loads the parts of the headers that belong to a loadable segment.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_stream_load_headers(sel4cp_elf_stream *stream)
+{
+    elf_header *elf_hdr = (elf_header *)stream->metadata;
+    
+    // The bytes following the last loadable segment are kept in the metadata buffer
+    // after the headers, with the same alignment as in the ELF file.
+    stream->tail_offset = stream->headers_size;
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(stream->metadata + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
+        if (prog_hdr->p_type == PT_LOAD && prog_hdr->p_offset + prog_hdr->p_filesz > stream->tail_offset) {
+            stream->tail_offset = prog_hdr->p_offset + prog_hdr->p_filesz;
+        }
+    }
+    stream->tail_base = ((stream->headers_size + 7) & ~((uint64_t)7)) + (stream->tail_offset % 8);
+    
+    uint64_t cnode_cap = sel4cp_internal_allocate_cnode(stream->pd);
+    if (cnode_cap == 0 || sel4cp_internal_pd_create_objects(stream->pd, cnode_cap)) {
+        sel4cp_dbg_puts("sel4cp_internal_stream_load_headers: failed to create the PD\n");
+        return -1;
+    }
+    
+    // Segments without bytes in the ELF file are not reached while loading, so their pages are allocated now.
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(stream->metadata + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
+        if (prog_hdr->p_type == PT_LOAD && prog_hdr->p_filesz == 0 && 
+            sel4cp_internal_stream_write_segment(stream, prog_hdr, prog_hdr->p_vaddr, NULL, prog_hdr->p_memsz)) 
+        {
+            return -1;
+        }
+    }
+    
+    stream->headers_loaded = true;
+    return sel4cp_internal_stream_load_range(stream, 0, stream->metadata, stream->headers_size);
+}
+
+/**
+ *  Rewrites the offsets of the section headers, the sections, and the access right table 
+ *  of the streamed ELF file, such that they refer to the metadata buffer of the stream.
+ *  The metadata buffer can then be used in place of the ELF file when looking up symbols
+ *  and setting up access rights. A stripped ELF file only has an access right table to relocate.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if the section headers, the symbol table, or the access right table 
+ *  are not located after the loadable segments.
+ */
+static int
+sel4cp_internal_stream_relocate_metadata(sel4cp_elf_stream *stream)
+{
+    elf_header *elf_hdr = (elf_header *)stream->metadata;
+    uint64_t delta = stream->tail_offset - stream->tail_base;
+    
+    // A stripped ELF file has no section headers, in which case only the access right table follows the loadable segments.
+    if (elf_hdr->e_shnum != 0) {
+        if (elf_hdr->e_shoff < stream->tail_offset || elf_hdr->e_shoff > stream->num_received ||
+            (uint64_t)elf_hdr->e_shnum * elf_hdr->e_shentsize > stream->num_received - elf_hdr->e_shoff) 
+        {
+            sel4cp_dbg_puts("sel4cp_internal_stream_relocate_metadata: the section headers do not follow the loadable segments\n");
+            return -1;
+        }
+        elf_hdr->e_shoff -= delta;
+    }
+    
+    for (uint64_t i = 0; i < elf_hdr->e_shnum; i++) {
+        elf_section_header *section_hdr = (elf_section_header *)(stream->metadata + elf_hdr->e_shoff + (i * elf_hdr->e_shentsize));
+        if (section_hdr->sh_offset >= stream->tail_offset) {
+            section_hdr->sh_offset -= delta;
+        }
+        else if (section_hdr->sh_type == SHT_SYMTAB) {
+            sel4cp_dbg_puts("sel4cp_internal_stream_relocate_metadata: the symbol table does not follow the loadable segments\n");
+            return -1;
+        }
+    }
+    
+    // The offset of the access right table is only 7 bytes long.
+    uint64_t access_right_table_offset = *((uint64_t *)(stream->metadata + EI_ACCESS_RIGHT_TABLE_OFFSET_IDX - 1)) >> 8;
+    if (access_right_table_offset < stream->tail_offset || access_right_table_offset >= stream->num_received) {
+        sel4cp_dbg_puts("sel4cp_internal_stream_relocate_metadata: the access right table does not follow the loadable segments\n");
+        return -1;
+    }
+    access_right_table_offset -= delta;
+    for (uint64_t i = 0; i < 7; i++) {
+        elf_hdr->e_ident[EI_ACCESS_RIGHT_TABLE_OFFSET_IDX + i] = (uint8_t)(access_right_table_offset >> (8 * i));
+    }
+    
+    return 0;
+}
+
+/**
+ *  Writes the id of the PD of the given stream to the given pd_id_vaddr in the PD,
+ *  which must be part of a loadable segment that has already been loaded.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_stream_write_pd_id(sel4cp_elf_stream *stream, uint64_t pd_id_vaddr)
+{
+    elf_header *elf_hdr = (elf_header *)stream->metadata;
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(stream->metadata + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
+        if (prog_hdr->p_type != PT_LOAD || pd_id_vaddr < prog_hdr->p_vaddr || pd_id_vaddr >= prog_hdr->p_vaddr + prog_hdr->p_memsz)
+            continue;
+        
+        uint64_t page_cap_idx = sel4cp_internal_find_page(stream->pd + 1, pd_id_vaddr);
+        if (page_cap_idx == 0) {
+            break;
+        }
+        return sel4cp_internal_write_pd_id(page_cap_idx, pd_id_vaddr, stream->pd);
+    }
+    
+    sel4cp_dbg_puts("sel4cp_internal_stream_write_pd_id: the PD id variable is not part of a loadable segment\n");
+    return -1;
+}
+
+/**
+ *  Records the read-only segments of the ELF file of the given stream with the given decoded 
+ *  access right table, such that their pages can be shared with PDs loading the same ELF file later on.
+ *  The pages cannot be shared with the PD of the stream itself, as the image hash is 
+ *  only received after the loadable segments have been loaded.
+ */
+static void
+sel4cp_internal_stream_record_shared_segments(sel4cp_elf_stream *stream, access_right_table *table)
+{
+    elf_header *elf_hdr = (elf_header *)stream->metadata;
+    for (uint64_t i = 0; i < elf_hdr->e_phnum; i++) {
+        elf_program_header *prog_hdr = (elf_program_header *)(stream->metadata + elf_hdr->e_phoff + (i * elf_hdr->e_phentsize));
+        if (prog_hdr->p_type == PT_LOAD && sel4cp_internal_is_shareable_segment(table, prog_hdr)) {
+            sel4cp_internal_record_shared_segment(table->image_hash, prog_hdr, stream->pd);
+        }
+    }
+}
+
+/**
+ *  Returns a program header describing the pages of the given run of a paged image as a loadable segment,
+ *  such that the pages of shared runs are recorded and found like the read-only segments of ELF files.
+ */
+static elf_program_header
+sel4cp_internal_get_run_segment(sel4cp_paged_image_run *run)
+{
+    elf_program_header prog_hdr;
+    prog_hdr.p_type = PT_LOAD;
+    prog_hdr.p_flags = run->p_flags;
+    prog_hdr.p_offset = 0;
+    prog_hdr.p_vaddr = run->vaddr;
+    prog_hdr.p_paddr = run->vaddr;
+    prog_hdr.p_filesz = (uint64_t)run->num_pages * 0x1000;
+    prog_hdr.p_memsz = prog_hdr.p_filesz;
+    prog_hdr.p_align = 0x1000;
+    return prog_hdr;
+}
+
+/**
+ *  Decodes the headers of the paged image at the given address, of which at least 
+ *  data_offset bytes are available, into the given access right table, validating the runs 
+ *  and the access right table before anything is set up for the PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if the paged image is invalid.
+ */
+static int
+sel4cp_internal_decode_paged_image(uint8_t *image, access_right_table *table)
+{
+    sel4cp_paged_image_header *header = (sel4cp_paged_image_header *)image;
+    sel4cp_paged_image_run *runs = (sel4cp_paged_image_run *)(image + sizeof(sel4cp_paged_image_header));
+    if (header->access_rights_offset % 8 != 0 || header->access_rights_size < sizeof(access_right_table_header) ||
+        header->access_rights_offset < sizeof(sel4cp_paged_image_header) ||
+        header->num_runs > (header->access_rights_offset - sizeof(sel4cp_paged_image_header)) / sizeof(sel4cp_paged_image_run) ||
+        (uint64_t)header->access_rights_offset + header->access_rights_size > header->data_offset) 
+    {
+        sel4cp_dbg_puts("sel4cp_internal_decode_paged_image: invalid paged image header\n");
+        return -1;
+    }
+    
+    uint8_t *access_rights = image + header->access_rights_offset;
+    if (((access_right_table_header *)access_rights)->magic != ACCESS_RIGHT_TABLE_MAGIC || 
+        sel4cp_internal_decode_access_right_table(access_rights, header->access_rights_size, table)) 
+    {
+        sel4cp_dbg_puts("sel4cp_internal_decode_paged_image: invalid access right table\n");
+        return -1;
+    }
+    // There is no symbol table to fall back on.
+    if (table->index[LOADER_SYMBOLS_ID].num_access_rights == 0) {
+        sel4cp_dbg_puts("sel4cp_internal_decode_paged_image: the paged image has no loader symbols access right\n");
+        return -1;
+    }
+    
+    // The runs must not overlap, and the PD id variable must be part of a run whose pages are not shared.
+    bool has_pd_id_page = false;
+    uint64_t runs_end = 0;
+    for (uint64_t i = 0; i < header->num_runs; i++) {
+        sel4cp_paged_image_run *run = &runs[i];
+        if (run->vaddr % 0x1000 != 0 || run->vaddr < runs_end || run->vaddr >= 0x1000000000000 || run->num_pages == 0 || 
+            run->kind > SEL4CP_PAGED_IMAGE_SHARED || (run->kind == SEL4CP_PAGED_IMAGE_SHARED && (run->p_flags & P_FLAGS_WRITABLE))) 
+        {
+            sel4cp_dbg_puts("sel4cp_internal_decode_paged_image: invalid run at index ");
+            sel4cp_dbg_puthex64(i);
+            sel4cp_dbg_puts("\n");
+            return -1;
+        }
+        runs_end = run->vaddr + (uint64_t)run->num_pages * 0x1000;
+        if (table->pd_id_vaddr >= run->vaddr && table->pd_id_vaddr < runs_end) {
+            has_pd_id_page = run->kind != SEL4CP_PAGED_IMAGE_SHARED;
+        }
+    }
+    if (!has_pd_id_page) {
+        sel4cp_dbg_puts("sel4cp_internal_decode_paged_image: the PD id variable is not part of a run that is not shared\n");
+        return -1;
+    }
+    
+    return 0;
+}
+
+/**
+ *  Allocates the next page of the current run of the given paged image stream and maps it into the PD.
+ *
+ *  Returns the index of the CSlot containing the page in the current PD on success.
+ *  Returns 0 if an error occurs.
+ */
+static uint64_t
+sel4cp_internal_stream_allocate_run_page(sel4cp_elf_stream *stream)
+{
+    sel4cp_paged_image_run *run = (sel4cp_paged_image_run *)(stream->metadata + sizeof(sel4cp_paged_image_header)) + stream->run_idx;
+    uint64_t vaddr = run->vaddr + stream->run_page_idx * 0x1000;
+    uint64_t page_cap_idx = sel4cp_internal_allocate_page(vaddr, BASE_VSPACE_CAP + stream->pd, run->p_flags);
+    if (page_cap_idx == 0) {
+        sel4cp_dbg_puts("sel4cp_internal_stream_allocate_run_page: failed to allocate a page required to load the paged image, vaddr = ");
+        sel4cp_dbg_puthex64(vaddr);
+        sel4cp_dbg_puts("\n");
+        return 0;
+    }
+    if (sel4cp_internal_mask_bits(stream->table.pd_id_vaddr, 12) == vaddr) {
+        stream->pd_id_page_cap = page_cap_idx;
+    }
+    stream->run_page_idx++;
+    return page_cap_idx;
+}
+
+/**
+ *  Records the current run of the given paged image stream if it is a shared run whose pages 
+ *  have been loaded, such that they can be shared with PDs loading the same program later on.
+ */
+static void
+sel4cp_internal_stream_record_run(sel4cp_elf_stream *stream)
+{
+    sel4cp_paged_image_run *run = (sel4cp_paged_image_run *)(stream->metadata + sizeof(sel4cp_paged_image_header)) + stream->run_idx;
+    elf_program_header prog_hdr = sel4cp_internal_get_run_segment(run);
+    if (run->kind == SEL4CP_PAGED_IMAGE_SHARED && !stream->run_mapped && sel4cp_internal_is_shareable_segment(&stream->table, &prog_hdr)) {
+        sel4cp_internal_record_shared_segment(stream->table.image_hash, &prog_hdr, stream->pd);
+    }
+}
+
+/**
+ *  Moves the given paged image stream on to the run with the given index. The pages of runs 
+ *  without contents in the image are allocated right away, until a run with contents is reached. 
+ *  As the access right table precedes the pages, a shared run is mapped from a previously
+ *  loaded run of the same program if possible, in which case its contents are skipped.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_stream_enter_run(sel4cp_elf_stream *stream, uint64_t run_idx)
+{
+    sel4cp_paged_image_header *header = (sel4cp_paged_image_header *)stream->metadata;
+    sel4cp_paged_image_run *runs = (sel4cp_paged_image_run *)(stream->metadata + sizeof(sel4cp_paged_image_header));
+    for (stream->run_idx = run_idx; stream->run_idx < header->num_runs; stream->run_idx++) {
+        sel4cp_paged_image_run *run = &runs[stream->run_idx];
+        stream->run_page_idx = 0;
+        stream->run_mapped = false;
+        
+        elf_program_header prog_hdr = sel4cp_internal_get_run_segment(run);
+        if (run->kind == SEL4CP_PAGED_IMAGE_SHARED && sel4cp_internal_is_shareable_segment(&stream->table, &prog_hdr)) {
+            shared_segment *segment = sel4cp_internal_find_shared_segment(stream->table.image_hash, &prog_hdr);
+            if (segment != NULL && stream->shared_frame_idx + segment->num_pages <= BASE_TEMP_CAP) {
+                if (sel4cp_internal_map_shared_segment(segment, stream->pd, &stream->shared_frame_idx)) {
+                    return -1;
+                }
+                stream->run_mapped = true;
+            }
+        }
+        if (run->kind != SEL4CP_PAGED_IMAGE_ZERO) {
+            return 0; // the pages of the run are loaded as their contents arrive.
+        }
+        
+        for (uint64_t i = 0; i < run->num_pages; i++) {
+            if (sel4cp_internal_stream_allocate_run_page(stream) == 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Creates the PD of the given paged image stream once the headers and the access right table 
+ *  of the paged image have been received. Unlike for an ELF file, the access rights are known 
+ *  before any page is loaded, so they are validated before any objects are allocated for the PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_stream_load_image_headers(sel4cp_elf_stream *stream)
+{
+    if (sel4cp_internal_decode_paged_image(stream->metadata, &stream->table) || 
+        sel4cp_internal_check_pool_capacity(&stream->table, 1)) 
+    {
+        return -1;
+    }
+    
+    uint64_t cnode_cap = sel4cp_internal_allocate_cnode(stream->pd);
+    if (cnode_cap == 0) {
+        return -1;
+    }
+    if (stream->table.has_protection_domain_control) {
+        if (sel4cp_internal_move_unused_pool_caps(stream->pd, cnode_cap)) {
+            return -1;
+        }
+    }
+    if (sel4cp_internal_pd_create_objects(stream->pd, cnode_cap)) {
+        sel4cp_dbg_puts("sel4cp_internal_stream_load_image_headers: failed to create the PD\n");
+        return -1;
+    }
+    
+    stream->shared_frame_idx = BASE_SHARED_FRAME_CAP;
+    stream->pd_id_page_cap = 0;
+    stream->headers_loaded = true;
+    return sel4cp_internal_stream_enter_run(stream, 0);
+}
+
+/**
+ *  Loads the len bytes of the contents of the pages of the paged image of the given stream 
+ *  that follow the bytes received so far, which are given by data.
+ *  Each page is allocated when its first byte arrives, and the bytes are copied to it directly.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_stream_load_image_data(sel4cp_elf_stream *stream, uint8_t *data, uint64_t len)
+{
+    sel4cp_paged_image_header *header = (sel4cp_paged_image_header *)stream->metadata;
+    sel4cp_paged_image_run *runs = (sel4cp_paged_image_run *)(stream->metadata + sizeof(sel4cp_paged_image_header));
+    while (len > 0) {
+        uint64_t page_offset = (stream->num_received - stream->headers_size) % 0x1000;
+        if (page_offset == 0) {
+            // Move on to the next run with contents once all pages of the current run have arrived.
+            if (stream->run_idx < header->num_runs && stream->run_page_idx == runs[stream->run_idx].num_pages) {
+                sel4cp_internal_stream_record_run(stream);
+                if (sel4cp_internal_stream_enter_run(stream, stream->run_idx + 1)) {
+                    return -1;
+                }
+            }
+            if (stream->run_idx >= header->num_runs) {
+                sel4cp_dbg_puts("sel4cp_internal_stream_load_image_data: the paged image holds more pages than its runs\n");
+                return -1;
+            }
+            
+            if (stream->run_mapped) {
+                stream->run_page_idx++;
+                stream->write_page_cap = 0;
+            }
+            else {
+                stream->write_page_cap = sel4cp_internal_stream_allocate_run_page(stream);
+                if (stream->write_page_cap == 0) {
+                    return -1;
+                }
+            }
+        }
+        
+        // Write the bytes belonging to the current page, unless the page is shared.
+        uint64_t num_bytes = 0x1000 - page_offset;
+        if (num_bytes > len) {
+            num_bytes = len;
+        }
+        if (stream->write_page_cap != 0) {
+            uint8_t *write_handle = sel4cp_internal_map_page_with_write_handle(stream->write_page_cap, page_offset);
+            if (write_handle == NULL) {
+                return -1;
+            }
+            sel4cp_internal_copy_bytes(write_handle, data, num_bytes);
+        }
+        data += num_bytes;
+        len -= num_bytes;
+        stream->num_received += num_bytes;
+    }
+    return 0;
+}
+
+/**
+ *  Completes loading the paged image of the given stream once the contents of all of its pages 
+ *  have been loaded: allocates the pages of the remaining runs without contents,
+ *  writes the PD id of the new PD, sets up the PD according to its access rights, and starts the PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_stream_finish_image(sel4cp_elf_stream *stream)
+{
+    sel4cp_paged_image_header *header = (sel4cp_paged_image_header *)stream->metadata;
+    sel4cp_paged_image_run *runs = (sel4cp_paged_image_run *)(stream->metadata + sizeof(sel4cp_paged_image_header));
+    if (stream->run_idx < header->num_runs && stream->run_page_idx == runs[stream->run_idx].num_pages &&
+        (stream->num_received - stream->headers_size) % 0x1000 == 0) 
+    {
+        sel4cp_internal_stream_record_run(stream);
+        if (sel4cp_internal_stream_enter_run(stream, stream->run_idx + 1)) {
+            return -1;
+        }
+    }
+    if (stream->run_idx < header->num_runs) {
+        sel4cp_dbg_puts("sel4cp_internal_stream_finish_image: the paged image is missing the contents of some of its pages\n");
+        return -1;
+    }
+    
+    if (stream->pd_id_page_cap == 0 || sel4cp_internal_write_pd_id(stream->pd_id_page_cap, stream->table.pd_id_vaddr, stream->pd)) {
+        return -1;
+    }
+    return sel4cp_internal_pd_finish_load(header->entry_point, stream->pd, &stream->table);
+}
+
+/**
+ *  Decodes the header of the load plan of plan_size bytes at the given address into the given 
+ *  access right table, validating the access right table and every operation of the plan
+ *  before anything is set up for the PD. The resource totals in the header must match the operations,
+ *  such that they can be relied on to check the pools, see sel4cp_internal_check_plan_capacity.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if the load plan is invalid.
+ */
+static int
+sel4cp_internal_decode_load_plan(uint8_t *plan, uint64_t plan_size, access_right_table *table)
+{
+    sel4cp_load_plan_header *header = (sel4cp_load_plan_header *)plan;
+    sel4cp_load_op *ops = (sel4cp_load_op *)(plan + sizeof(sel4cp_load_plan_header));
+    if (plan == NULL || (uint64_t)plan % 8 != 0 || plan_size < sizeof(sel4cp_load_plan_header) || 
+        header->magic != SEL4CP_LOAD_PLAN_MAGIC || header->data_offset % 0x1000 != 0 || header->data_offset > plan_size ||
+        header->access_rights_offset % 8 != 0 || header->access_rights_size < sizeof(access_right_table_header) ||
+        header->access_rights_offset < sizeof(sel4cp_load_plan_header) ||
+        header->num_ops > (header->access_rights_offset - sizeof(sel4cp_load_plan_header)) / sizeof(sel4cp_load_op) ||
+        (uint64_t)header->access_rights_offset + header->access_rights_size > header->data_offset) 
+    {
+        sel4cp_dbg_puts("sel4cp_internal_decode_load_plan: invalid load plan header\n");
+        return -1;
+    }
+    
+    uint8_t *access_rights = plan + header->access_rights_offset;
+    if (((access_right_table_header *)access_rights)->magic != ACCESS_RIGHT_TABLE_MAGIC || 
+        sel4cp_internal_decode_access_right_table(access_rights, header->access_rights_size, table)) 
+    {
+        sel4cp_dbg_puts("sel4cp_internal_decode_load_plan: invalid access right table\n");
+        return -1;
+    }
+    
+    uint64_t num_content_pages = (plan_size - header->data_offset) / 0x1000;
+    uint64_t num_structures[3] = {0, 0, 0};
+    uint64_t num_pages = 0;
+    uint64_t next_access_right_offset = 0; // each access right is set up at most once, in the order of the table.
+    for (uint64_t i = 0; i < header->num_ops; i++) {
+        sel4cp_load_op *op = &ops[i];
+        sel4cp_load_op *prev_op = i == 0 ? NULL : &ops[i - 1];
+        uint64_t end = op->vaddr + (uint64_t)op->num_pages * 0x1000;
+        bool valid = op->vaddr < 0x1000000000000;
+        switch (op->type) {
+            case SEL4CP_LOAD_OP_MAP_PAGE_UPPER_DIRECTORY:
+            case SEL4CP_LOAD_OP_MAP_PAGE_DIRECTORY:
+            case SEL4CP_LOAD_OP_MAP_PAGE_TABLE:
+                num_structures[op->type]++;
+                break;
+            case SEL4CP_LOAD_OP_MAP_DATA_PAGES:
+            case SEL4CP_LOAD_OP_MAP_ZERO_PAGES:
+            case SEL4CP_LOAD_OP_MAP_SHARED_PAGES:
+                valid = valid && op->vaddr % 0x1000 == 0 && op->num_pages != 0 && end <= 0x1000000000000 &&
+                        (op->type == SEL4CP_LOAD_OP_MAP_ZERO_PAGES || (uint64_t)op->arg + op->num_pages <= num_content_pages) &&
+                        (op->type != SEL4CP_LOAD_OP_MAP_SHARED_PAGES || !(op->p_flags & P_FLAGS_WRITABLE));
+                num_pages += op->num_pages;
+                break;
+            case SEL4CP_LOAD_OP_WRITE_PD_ID:
+                // The PD id variable must be part of the pages mapped by the previous operation, which are not shared.
+                valid = valid && prev_op != NULL && 
+                        (prev_op->type == SEL4CP_LOAD_OP_MAP_DATA_PAGES || prev_op->type == SEL4CP_LOAD_OP_MAP_ZERO_PAGES) &&
+                        op->vaddr >= prev_op->vaddr && op->vaddr < prev_op->vaddr + (uint64_t)prev_op->num_pages * 0x1000 &&
+                        op->vaddr % 0x1000 <= 0x1000 - sizeof(sel4cp_pd);
+                break;
+            case SEL4CP_LOAD_OP_SET_IPC_BUFFER:
+                num_pages++;
+                break;
+            case SEL4CP_LOAD_OP_SET_UP_ACCESS_RIGHT:
+                valid = valid && op->arg >= next_access_right_offset && sel4cp_internal_find_access_right(table, op->arg) != NULL;
+                next_access_right_offset = (uint64_t)op->arg + 1;
+                break;
+            default:
+                valid = false;
+                break;
+        }
+        if (!valid) {
+            sel4cp_dbg_puts("sel4cp_internal_decode_load_plan: invalid operation at index ");
+            sel4cp_dbg_puthex64(i);
+            sel4cp_dbg_puts("\n");
+            return -1;
+        }
+    }
+    
+    if (num_structures[SEL4CP_LOAD_OP_MAP_PAGE_UPPER_DIRECTORY] != header->num_page_upper_directories ||
+        num_structures[SEL4CP_LOAD_OP_MAP_PAGE_DIRECTORY] != header->num_page_directories ||
+        num_structures[SEL4CP_LOAD_OP_MAP_PAGE_TABLE] != header->num_page_tables || num_pages != header->num_pages) 
+    {
+        sel4cp_dbg_puts("sel4cp_internal_decode_load_plan: the resource totals do not match the operations\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  Checks that the pools hold enough objects for a new PD loaded with the load plan with the given header
+ *  and decoded access right table, using the resource totals of the plan instead of its operations.
+ *
+ *  Returns 0 if there are enough objects.
+ *  Returns -1 otherwise.
+ */
+static int
+sel4cp_internal_check_plan_capacity(sel4cp_load_plan_header *header, access_right_table *table)
+{
+    // The objects moved to a PD with the protection_domain_control access right are taken from the pools first.
+    uint64_t num_required[NUM_POOLS];
+    sel4cp_internal_get_pool_requirements(table, 1, num_required);
+    num_required[PAGE_UPPER_DIRECTORY_POOL_ID] += header->num_page_upper_directories;
+    num_required[PAGE_DIRECTORY_POOL_ID] += header->num_page_directories;
+    num_required[PAGE_TABLE_POOL_ID] += header->num_page_tables;
+    num_required[PAGE_POOL_ID] += header->num_pages;
+    if (sel4cp_internal_check_pool_requirements(num_required)) {
+        sel4cp_dbg_puts("sel4cp_internal_check_plan_capacity: not enough objects left in the pools for the load plan\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  Maps the pages of the given operation of a load plan into the given PD, taking them from the page pool. 
+ *  The contents of the pages are copied from the given contents, unless it is NULL.
+ *  The paging structures of the pages have been mapped by preceding operations.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_execute_map_pages_op(sel4cp_pd pd, sel4cp_load_op *op, uint8_t *contents)
+{
+    for (uint64_t i = 0; i < op->num_pages; i++) {
+        uint64_t page_cap_idx = sel4cp_internal_map_next_page(op->vaddr + i * 0x1000, BASE_VSPACE_CAP + pd, op->p_flags);
+        if (page_cap_idx == 0) {
+            sel4cp_dbg_puts("sel4cp_internal_execute_map_pages_op: failed to map a page of the load plan, vaddr = ");
+            sel4cp_dbg_puthex64(op->vaddr + i * 0x1000);
+            sel4cp_dbg_puts("\n");
+            return -1;
+        }
+        
+        if (contents != NULL) {
+            uint8_t *write_handle = sel4cp_internal_map_page_with_write_handle(page_cap_idx, 0);
+            if (write_handle == NULL) {
+                return -1;
+            }
+            sel4cp_internal_copy_bytes(write_handle, contents + i * 0x1000, 0x1000);
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Executes the operations of the given decoded load plan in order, 
+ *  loading the program into the given PD, whose objects have been created.
+ *  Shared pages are mapped from a previously loaded run of the same program if possible.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_execute_load_plan(sel4cp_pd pd, uint8_t *plan, access_right_table *table)
+{
+    sel4cp_load_plan_header *header = (sel4cp_load_plan_header *)plan;
+    sel4cp_load_op *ops = (sel4cp_load_op *)(plan + sizeof(sel4cp_load_plan_header));
+    uint8_t *contents = plan + header->data_offset;
+    uint64_t pd_vspace_cap = BASE_VSPACE_CAP + pd;
+    uint64_t shared_frame_idx = BASE_SHARED_FRAME_CAP;
+    uint64_t shared_page_idx = BASE_SHARED_MEMORY_REGION_PAGES;
+    for (uint64_t i = 0; i < header->num_ops; i++) {
+        sel4cp_load_op *op = &ops[i];
+        int result = 0;
+        switch (op->type) {
+            case SEL4CP_LOAD_OP_MAP_PAGE_UPPER_DIRECTORY:
+                result = sel4cp_internal_map_paging_structure(pd_vspace_cap, op->vaddr, 12 + 9 + 9 + 9);
+                break;
+            case SEL4CP_LOAD_OP_MAP_PAGE_DIRECTORY:
+                result = sel4cp_internal_map_paging_structure(pd_vspace_cap, op->vaddr, 12 + 9 + 9);
+                break;
+            case SEL4CP_LOAD_OP_MAP_PAGE_TABLE:
+                result = sel4cp_internal_map_paging_structure(pd_vspace_cap, op->vaddr, 12 + 9);
+                break;
+            case SEL4CP_LOAD_OP_MAP_DATA_PAGES:
+            case SEL4CP_LOAD_OP_MAP_ZERO_PAGES: {
+                uint8_t *op_contents = op->type == SEL4CP_LOAD_OP_MAP_DATA_PAGES ? contents + (uint64_t)op->arg * 0x1000 : NULL;
+                result = sel4cp_internal_execute_map_pages_op(pd, op, op_contents);
+                break;
+            }
+            case SEL4CP_LOAD_OP_MAP_SHARED_PAGES: {
+                sel4cp_paged_image_run run = {op->vaddr, op->num_pages, op->p_flags, SEL4CP_PAGED_IMAGE_SHARED, 0};
+                elf_program_header prog_hdr = sel4cp_internal_get_run_segment(&run);
+                bool shareable = sel4cp_internal_is_shareable_segment(table, &prog_hdr);
+                shared_segment *segment = shareable ? sel4cp_internal_find_shared_segment(table->image_hash, &prog_hdr) : NULL;
+                if (segment != NULL && shared_frame_idx + segment->num_pages <= BASE_TEMP_CAP) {
+                    result = sel4cp_internal_map_shared_segment(segment, pd, &shared_frame_idx);
+                    break;
+                }
+                result = sel4cp_internal_execute_map_pages_op(pd, op, contents + (uint64_t)op->arg * 0x1000);
+                if (result == 0 && shareable) {
+                    sel4cp_internal_record_shared_segment(table->image_hash, &prog_hdr, pd);
+                }
+                break;
+            }
+            case SEL4CP_LOAD_OP_WRITE_PD_ID: {
+                uint64_t page_cap_idx = sel4cp_internal_find_page(pd + 1, op->vaddr);
+                result = page_cap_idx == 0 ? -1 : sel4cp_internal_write_pd_id(page_cap_idx, op->vaddr, pd);
+                break;
+            }
+            case SEL4CP_LOAD_OP_SET_IPC_BUFFER:
+                result = sel4cp_internal_set_up_ipc_buffer(op->vaddr, pd);
+                break;
+            case SEL4CP_LOAD_OP_SET_UP_ACCESS_RIGHT:
+                result = sel4cp_internal_set_up_access_right(pd, sel4cp_internal_find_access_right(table, op->arg), &shared_page_idx);
+                break;
+        }
+        if (result) {
+            sel4cp_dbg_puts("sel4cp_internal_execute_load_plan: failed to execute the operation at index ");
+            sel4cp_dbg_puthex64(i);
+            sel4cp_dbg_puts("\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Returns true if the object or memory region page in the CSlot with the given index in the current PD
+ *  is recorded with the given owner and, unless journal is NULL, has been journaled, see pd_create_journal.
+ */
+static bool
+sel4cp_internal_is_reclaimed_cap(uint64_t cap_idx, uint64_t owner, pd_create_journal *journal)
+{
+    uint64_t i = cap_idx - BASE_TCB_POOL;
+    return alloc_state.cap_owners[i] == owner && (journal == NULL || (journal->owned_caps[i / 64] & (1ULL << (i % 64))));
+}
+
+/**
+ *  Reverts everything that has been set up for the given PD, and returns the objects recorded with it
+ *  to the pools, see allocation_state. The capabilities moved to the PD are moved back first, such that
+ *  the objects of the PDs the PD has created itself are returned as well, apart from those whose 
+ *  capabilities the PD has passed on.
+ *  If the PD has been started, journal is NULL and all its pages are 0-initialized again.
+ *  Otherwise, the PD is being created, and only the objects, pages and IRQs in the given journal
+ *  are reverted, of which only the pages the current PD has written to are 0-initialized again.
+ *  The results of most invocations are not checked, as each of them only fails 
+ *  if there was nothing for it to revert.
+ */
+static void
+sel4cp_internal_reclaim_pd(sel4cp_pd pd, pd_create_journal *journal)
+{
+    uint64_t cnode_cap = BASE_CNODE_CAP + sel4cp_current_pd_id;
+    uint64_t owner = pd + 1;
+    bool started = journal == NULL;
+    
+    // Find the CNode of the PD, which is the only CNode recorded with it that has not been moved to it, and stop the PD.
+    uint64_t pd_cnode_cap = 0;
+    for (uint64_t i = 0; i < NUM_OWNED_CAPS; i++) {
+        if (!sel4cp_internal_is_reclaimed_cap(BASE_TCB_POOL + i, owner, journal) || alloc_state.moved_pool_caps[i] != 0 || !sel4cp_internal_is_pool_cap(BASE_TCB_POOL + i)) {
+            continue;
+        }
+        uint64_t pool = sel4cp_internal_get_pool(BASE_TCB_POOL + i);
+        if (pool == CNODE_POOL_ID) {
+            pd_cnode_cap = BASE_TCB_POOL + i;
+        }
+        else if (pool == TCB_POOL_ID) {
+            seL4_TCB_Suspend(BASE_TCB_POOL + i);
+        }
+    }
+    
+    // Take the IRQHandler capabilities back from the PD and stop notifying it of the IRQs.
+    for (uint64_t i = 0; i <= SEL4CP_MAX_CHANNELS; i++) {
+        if (alloc_state.irq_owners[i] != owner || (journal != NULL && !(journal->owned_irqs & (1ULL << i)))) {
+            continue;
+        }
+        if (pd_cnode_cap != 0) {
+            seL4_CNode_Move(cnode_cap, BASE_IRQ_CAP + i, PD_CAP_BITS, pd_cnode_cap, BASE_IRQ_CAP + alloc_state.irq_child_channel_ids[i], PD_CAP_BITS);
+        }
+        seL4_IRQHandler_Clear(BASE_IRQ_CAP + i);
+        alloc_state.irq_owners[i] = 0;
+    }
+    
+    // Take the capabilities for pool objects back from the PD. An object whose capability
+    // the PD no longer holds in the CSlot it was moved to is lost.
+    for (uint64_t i = 0; i < NUM_OWNED_CAPS; i++) {
+        if (!sel4cp_internal_is_reclaimed_cap(BASE_TCB_POOL + i, owner, journal) || alloc_state.moved_pool_caps[i] == 0) {
+            continue;
+        }
+        uint64_t pool_base_cap_idx = sel4cp_internal_pool_bases[sel4cp_internal_get_pool(BASE_TCB_POOL + i)];
+        seL4_Error err = pd_cnode_cap == 0 ? seL4_FailedLookup : seL4_CNode_Move(
+            cnode_cap,
+            BASE_TCB_POOL + i,
+            PD_CAP_BITS,
+            pd_cnode_cap,
+            pool_base_cap_idx + alloc_state.moved_pool_caps[i] - 1,
+            PD_CAP_BITS
+        );
+        if (err != seL4_NoError) {
+            alloc_state.cap_owners[i] = 0;
+        }
+        alloc_state.moved_pool_caps[i] = 0;
+    }
+    
+    // Unbind the objects from each other and clear pending signals, which also stops 
+    // the PDs the PD has created itself, and unmap the memory region pages of the current PD from the PD.
+    for (uint64_t i = 0; i < NUM_OWNED_CAPS; i++) {
+        if (!sel4cp_internal_is_reclaimed_cap(BASE_TCB_POOL + i, owner, journal)) {
+            continue;
+        }
+        uint64_t cap_idx = BASE_TCB_POOL + i;
+        if (!sel4cp_internal_is_pool_cap(cap_idx)) {
+            seL4_ARM_Page_Unmap(cap_idx);
+            alloc_state.cap_owners[i] = 0;
+            continue;
+        }
+        switch (sel4cp_internal_get_pool(cap_idx)) {
+            case TCB_POOL_ID:
+                seL4_TCB_Suspend(cap_idx);
+                seL4_TCB_UnbindNotification(cap_idx);
+                break;
+            case SCHEDCONTEXT_POOL_ID:
+                seL4_SchedContext_Unbind(cap_idx);
+                break;
+            case NOTIFICATION_POOL_ID:
+                seL4_Poll(cap_idx, NULL);
+                break;
+        }
+    }
+    
+    // Empty the CSpace of the PD, which unmaps the copies of shared pages and deletes
+    // the copies of memory region pages and the capabilities for the channels to other PDs.
+    // The CNodes of the PDs the PD has created itself are only used if it has been started.
+    for (uint64_t cap_idx = sel4cp_internal_next_pool_cap(CNODE_POOL_ID, 0); cap_idx != 0; cap_idx = sel4cp_internal_next_pool_cap(CNODE_POOL_ID, cap_idx)) {
+        if (sel4cp_internal_is_reclaimed_cap(cap_idx, owner, journal) && (cap_idx == pd_cnode_cap || started)) {
+            for (uint64_t j = 0; j < (1 << PD_CAP_BITS); j++) {
+                seL4_CNode_Delete(cap_idx, j, PD_CAP_BITS);
+            }
+        }
+    }
+    
+    // Unmap the pages of the shared segments loaded into the PD from it, and return the pages 
+    // of the shared segments that are no longer mapped into any PD to the page pool.
+    for (uint64_t i = 0; i < alloc_state.num_shared_segments; i++) {
+        shared_segment *segment = &alloc_state.shared_segments[i];
+        if (!(alloc_state.pd_shared_segments[pd] & (1ULL << i))) {
+            continue;
+        }
+        for (uint64_t cap_idx = sel4cp_internal_next_pool_cap(PAGE_POOL_ID, 0); cap_idx != 0; cap_idx = sel4cp_internal_next_pool_cap(PAGE_POOL_ID, cap_idx)) {
+            if (alloc_state.cap_owners[cap_idx - BASE_TCB_POOL] != SHARED_SEGMENT_OWNER + i) {
+                continue;
+            }
+            if (segment->pd == pd) {
+                seL4_ARM_Page_Unmap(cap_idx);
+            }
+            if (segment->num_pds == 1) {
+                sel4cp_internal_free_page(cap_idx, true);
+            }
+        }
+        segment->num_pds--;
+    }
+    while (alloc_state.num_shared_segments > 0 && alloc_state.shared_segments[alloc_state.num_shared_segments - 1].num_pds == 0) {
+        alloc_state.num_shared_segments--;
+    }
+    alloc_state.pd_shared_segments[pd] = 0;
+    
+    // Return the objects to the pools, unmapping the pages before the paging structures, and deleting 
+    // all capabilities derived from them, including those in other PDs and the ones in the CSpace
+    // of the current PD for the PD id. seL4 clears a paging structure when it is unmapped.
+    for (uint64_t pool = NUM_POOLS; pool-- > 0;) {
+        for (uint64_t cap_idx = sel4cp_internal_next_pool_cap(pool, 0); cap_idx != 0; cap_idx = sel4cp_internal_next_pool_cap(pool, cap_idx)) {
+            if (!sel4cp_internal_is_reclaimed_cap(cap_idx, owner, journal)) {
+                continue;
+            }
+            switch (pool) {
+                case PAGE_POOL_ID: {
+                    uint64_t page_idx = sel4cp_internal_get_page_idx(cap_idx);
+                    sel4cp_internal_free_page(cap_idx, started || (journal->written_pages[page_idx / 64] & (1ULL << (page_idx % 64))));
+                    continue;
+                }
+                case PAGE_TABLE_POOL_ID:
+                    seL4_ARM_PageTable_Unmap(cap_idx);
+                    break;
+                case PAGE_DIRECTORY_POOL_ID:
+                    seL4_ARM_PageDirectory_Unmap(cap_idx);
+                    break;
+                case PAGE_UPPER_DIRECTORY_POOL_ID:
+                    seL4_ARM_PageUpperDirectory_Unmap(cap_idx);
+                    break;
+            }
+            seL4_CNode_Revoke(cnode_cap, cap_idx, PD_CAP_BITS);
+            sel4cp_internal_free_pool_cap(cap_idx);
+        }
+    }
+    
+    // Forget the paging structures mapped into the VSpace of the PD.
+    uint64_t num_mapped_paging_structures = 0;
+    for (uint64_t i = 0; i < alloc_state.num_mapped_paging_structures; i++) {
+        if (alloc_state.mapped_paging_structures[i].vspace_cap != BASE_VSPACE_CAP + pd) {
+            alloc_state.mapped_paging_structures[num_mapped_paging_structures] = alloc_state.mapped_paging_structures[i];
+            num_mapped_paging_structures++;
+        }
+    }
+    alloc_state.num_mapped_paging_structures = num_mapped_paging_structures;
+    
+    sel4cp_internal_lazy_pds[pd].src = NULL;
+    sel4cp_internal_lazy_pds[pd].num_demand_faulted_pages = 0;
+}
+
+/**
+ *  Returns true if the PD with the given id has been created by the current PD,
+ *  i.e. it holds objects taken from the pools, IRQs or shared segments of the current PD.
+ */
+static bool
+sel4cp_internal_is_created_pd(sel4cp_pd pd)
+{
+    bool created = alloc_state.pd_shared_segments[pd] != 0;
+    for (uint64_t i = 0; i < NUM_OWNED_CAPS && !created; i++) {
+        created = alloc_state.cap_owners[i] == pd + 1;
+    }
+    for (uint64_t i = 0; i <= SEL4CP_MAX_CHANNELS && !created; i++) {
+        created = alloc_state.irq_owners[i] == pd + 1;
+    }
+    return created;
+}
+
+/**
+ *  Checks that a new PD can be created with the given id: the id must lie within the ranges of
+ *  capabilities kept per PD, it must not be the id of the current PD, and no PD with the id may exist, 
+ *  neither one created by the current PD nor a child PD of the current PD created by the sel4cp tool,
+ *  whose TCB capability the current PD holds.
+ *
+ *  Returns 0 if a new PD can be created with the given id.
+ *  Returns -1 otherwise.
+ */
+static int
+sel4cp_internal_check_new_pd_id(sel4cp_pd pd)
+{
+    if (pd > SEL4CP_MAX_PDS || pd == sel4cp_current_pd_id) {
+        sel4cp_dbg_puts("sel4cp_internal_check_new_pd_id: invalid PD id ");
+        sel4cp_dbg_puthex64(pd);
+        sel4cp_dbg_puts("\n");
+        return -1;
+    }
+    if (sel4cp_internal_is_created_pd(pd)) {
+        sel4cp_dbg_puts("sel4cp_internal_check_new_pd_id: a PD with id ");
+        sel4cp_dbg_puthex64(pd);
+        sel4cp_dbg_puts(" has already been created\n");
+        return -1;
+    }
+    
+    // Copying the TCB capability of the PD only succeeds if there is one.
+    uint64_t temp_cap = sel4cp_internal_allocate_temp_cap();
+    seL4_Error err = seL4_CNode_Copy(
+        BASE_CNODE_CAP + sel4cp_current_pd_id,
+        temp_cap,
+        PD_CAP_BITS,
+        BASE_CNODE_CAP + sel4cp_current_pd_id,
+        BASE_TCB_CAP + pd,
+        PD_CAP_BITS,
+        seL4_AllRights
+    );
+    if (err == seL4_NoError) {
+        // Do not keep the copy of the TCB capability of the PD around in the temp CSlot.
+        sel4cp_internal_delete_temp_cap(temp_cap);
+        alloc_state.temp_cap_used[temp_cap - BASE_TEMP_CAP] = false;
+        
+        sel4cp_dbg_puts("sel4cp_internal_check_new_pd_id: a PD with id ");
+        sel4cp_dbg_puthex64(pd);
+        sel4cp_dbg_puts(" already exists\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  Begins creating the PD with the given id, journaling the pages the current PD writes to for it,
+ *  such that sel4cp_internal_end_pd_create can revert it if creating the PD fails, see pd_create_journal.
+ *  The temp pages of the current PD are prepared first, as the paging structures they take from the pools
+ *  are kept by the current PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if no new PD can be created with the given id, see sel4cp_internal_check_new_pd_id,
+ *  or if an error occurs, in which case nothing has been taken from the pools.
+ */
+static int
+sel4cp_internal_begin_pd_create(sel4cp_pd pd)
+{
+    if (sel4cp_internal_check_new_pd_id(pd) || sel4cp_internal_prepare_temp_pages()) {
+        return -1;
+    }
+    
+    pd_create_journal *journal = &sel4cp_internal_journal;
+    journal->active = true;
+    journal->pd = pd;
+    for (uint64_t i = 0; i < (MAX_POOL_PAGES + 63) / 64; i++) {
+        journal->written_pages[i] = 0;
+    }
+    for (uint64_t i = 0; i < (NUM_OWNED_CAPS + 63) / 64; i++) {
+        journal->owned_caps[i] = 0;
+    }
+    journal->owned_irqs = 0;
+    return 0;
+}
+
+/**
+ *  Ends creating the PD begun with sel4cp_internal_begin_pd_create, given the result of creating it.
+ *  If creating the PD failed, everything that has been set up for it is reverted and the objects
+ *  taken from the pools for it are returned to the pools, see sel4cp_internal_reclaim_pd.
+ *
+ *  Returns the given result.
+ */
+static int
+sel4cp_internal_end_pd_create(int result)
+{
+    sel4cp_internal_journal.active = false;
+    if (result != 0) {
+        sel4cp_internal_reclaim_pd(sel4cp_internal_journal.pd, &sel4cp_internal_journal);
+    }
+    return result;
+}
+
+/**
+ *  Creates a new PD with the given id and loads the ELF file of src_size bytes pointed to by src in this new PD, 
+ *  see sel4cp_pd_create. If lazy is true, the pages of the ELF file are loaded on demand,
+ *  see sel4cp_pd_create_lazy.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_internal_pd_create(sel4cp_pd pd, uint8_t *src, uint64_t src_size, bool lazy)
+{
+    if (src == NULL) {
+        sel4cp_dbg_puts("sel4cp_pd_create: invalid ELF program\n");
+        return -1;
+    }
+    
+    // Reject invalid access rights before any objects are allocated for the new PD.
+    access_right_table table;
+    if (sel4cp_internal_decode_access_rights(src, src_size, &table) || sel4cp_internal_check_pool_capacity(&table, 1)) {
+        return -1;
+    }
+
+    if (sel4cp_internal_begin_pd_create(pd)) {
+        return -1;
+    }
+    
+    // The PD is recorded as loaded on demand before its objects are created, such that its faults are delivered to the current PD.
+    lazy_pd *lazy_state = &sel4cp_internal_lazy_pds[pd];
+    lazy_state->src = lazy ? src : NULL;
+    lazy_state->num_demand_faulted_pages = 0;
+    
+    // Allocate a CNode for the new PD, and move capabilities for unused pool objects to it, if required.
+    uint64_t cnode_cap = sel4cp_internal_allocate_cnode(pd);
+    
+    // Start the specified program in the new PD.
+    int result;
+    if (cnode_cap == 0 || (table.has_protection_domain_control && sel4cp_internal_move_unused_pool_caps(pd, cnode_cap)) ||
+        sel4cp_internal_pd_create_objects(pd, cnode_cap)) 
+    {
+        result = -1;
+    }
+    else if (lazy) {
+        result = sel4cp_internal_pd_load_elf_lazily(src, pd, &table);
+    }
+    else {
+        result = sel4cp_internal_pd_load_elf(src, pd, &table);
+    }
+    return sel4cp_internal_end_pd_create(result);
+}
+
+// ========== END OF UTILITY FUNCTIONS ==========
+
+// ========== PUBLIC INTERFACE ==========
+
+static inline void
+sel4cp_notify(sel4cp_channel ch)
+{
+    seL4_Signal(BASE_OUTPUT_NOTIFICATION_CAP + ch);
+}
+
+static inline void
+sel4cp_irq_ack(sel4cp_channel ch)
+{
+    seL4_IRQHandler_Ack(BASE_IRQ_CAP + ch);
+}
+
+static void
+sel4cp_pd_stop(sel4cp_pd pd)
+{
+    seL4_Error err;
+    err = seL4_TCB_Suspend(BASE_TCB_CAP + pd);
+    if (err != seL4_NoError) {
+        sel4cp_dbg_puts("sel4cp_pd_stop: error writing registers\n");
+        sel4cp_internal_crash(err);
+    }
+}
+
+/**
+ *  Destroys the PD with the given id, which has been created by the current PD, 
+ *  such that the id can be used for a new PD. Everything set up for the PD is reverted,
+ *  and the objects taken from the pools for it, including those moved to it to create PDs itself,
+ *  are returned to the pools. The PDs the PD has created itself are destroyed as well.
+ *  The IRQs and objects whose capabilities the PD has passed on, e.g. to the PDs it has created itself, are lost.
+ *  A PD whose stream has failed can be destroyed as well, to return the objects taken for the stream.
+ *  Precondition: No stream for the PD is in progress.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if no PD with the given id has been created by the current PD.
+ */
+static int
+sel4cp_pd_destroy(sel4cp_pd pd)
+{
+    if (pd > SEL4CP_MAX_PDS || pd == sel4cp_current_pd_id) {
+        sel4cp_dbg_puts("sel4cp_pd_destroy: invalid PD id\n");
+        return -1;
+    }
+    if (!sel4cp_internal_is_created_pd(pd)) {
+        sel4cp_dbg_puts("sel4cp_pd_destroy: the PD has not been created by the current PD\n");
+        return -1;
+    }
+    
+    sel4cp_internal_reclaim_pd(pd, NULL);
+    return 0;
+}
+
+/**
+ *  Returns the number of objects left in the pool with the given index, e.g. PAGE_POOL_ID, including
+ *  the objects that have been returned to the pool by destroyed PDs and failed PD creations.
+ *  While the current PD has untyped memory, this includes the objects that can still be retyped 
+ *  from it as far as there are CSlots for them, which is an upper bound.
+ *  Returns 0 if there is no pool with the given index.
+ */
+static uint64_t
+sel4cp_pool_get_num_free(uint64_t pool_id)
+{
+    if (pool_id >= NUM_POOLS) {
+        return 0;
+    }
+    return sel4cp_internal_get_num_free_pool_caps(pool_id);
+}
+
+/**
+ *  Returns the number of objects of the pool with the given index, e.g. PAGE_POOL_ID, that are not left
+ *  in the pool, i.e. in use by the PDs created by the current PD or lost, see sel4cp_pd_destroy.
+ *  Returns 0 if there is no pool with the given index.
+ */
+static uint64_t
+sel4cp_pool_get_num_used(uint64_t pool_id)
+{
+    if (pool_id >= NUM_POOLS) {
+        return 0;
+    }
+    pool_allocator *allocator = &alloc_state.pools[pool_id];
+    return allocator->num_handed_out + allocator->num_retyped - allocator->num_free;
+}
+
+static inline sel4cp_msginfo
+sel4cp_ppcall(sel4cp_channel ch, sel4cp_msginfo msginfo)
+{
+    return seL4_Call(BASE_OUTPUT_ENDPOINT_CAP + ch, msginfo);
+}
+
+static inline sel4cp_msginfo
+sel4cp_msginfo_new(uint64_t label, uint16_t count)
+{
+    return seL4_MessageInfo_new(label, 0, 0, count);
+}
+
+static inline uint64_t
+sel4cp_msginfo_get_label(sel4cp_msginfo msginfo)
+{
+    return seL4_MessageInfo_get_label(msginfo);
+}
+
+static void
+sel4cp_mr_set(uint8_t mr, uint64_t value)
+{
+    seL4_SetMR(mr, value);
+}
+
+static uint64_t
+sel4cp_mr_get(uint8_t mr)
+{
+    return seL4_GetMR(mr);
+}
+
+/**
+ *  Updates the given CRC-32 (as used by zlib and Ethernet) with the given data.
+ *  Start with crc = 0; the result can be passed back in to continue the computation.
+ *  Uses the ARMv8 CRC32 instructions if they are available.
+ */
+static uint32_t
+sel4cp_crc32(uint32_t crc, uint8_t *data, uint64_t len)
+{
+    crc = ~crc;
+#if defined(__ARM_FEATURE_CRC32)
+    // Process single bytes until the data is 8-byte aligned, as unaligned loads are not allowed.
+    while (len > 0 && ((uintptr_t)data % 8) != 0) {
+        asm("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"(*data));
+        data++;
+        len--;
+    }
+    while (len >= 8) {
+        asm("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(*((uint64_t *)data)));
+        data += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        asm("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"(*data));
+        data++;
+        len--;
+    }
+#else
+    while (len > 0) {
+        crc ^= *data;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+        data++;
+        len--;
+    }
+#endif
+    return ~crc;
+}
+
+/**
+ *  Creates a new PD with the given id and loads the statically linked
+    ELF file of src_size bytes pointed to by src in this new PD.
+ *  Fails if a PD with the given id already exists in the system, see sel4cp_internal_check_new_pd_id.
+ *  Precondition: src != NULL.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs, in which case everything set up for the PD has been reverted
+ *  and the objects taken from the pools for it can be used again.
+ */
+static int
+sel4cp_pd_create(sel4cp_pd pd, uint8_t *src, uint64_t src_size) 
+{
+    return sel4cp_internal_pd_create(pd, src, src_size, false);
+}
+
+/**
+ *  Creates a new PD with the given id like sel4cp_pd_create, but only loads the pages of the
+ *  ELF file pointed to by src that are needed to start the PD. The faults of the PD are delivered 
+ *  to the current PD, which loads the remaining pages when the PD first accesses them 
+ *  by passing the faults to sel4cp_pd_handle_fault. The current PD must thus have an input endpoint,
+ *  i.e. it must have child PDs or provide a protected procedure.
+ *  Fails if a PD with the given id already exists in the system.
+ *  Precondition: src != NULL, and the ELF file is neither moved nor changed while the PD exists.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_pd_create_lazy(sel4cp_pd pd, uint8_t *src, uint64_t src_size) 
+{
+    return sel4cp_internal_pd_create(pd, src, src_size, true);
+}
+
+/**
+ *  Loads the page accessed by the given PD when it caused the fault given by msginfo,
+ *  if the PD was created with sel4cp_pd_create_lazy and the fault was caused by accessing
+ *  a page of one of its loadable segments that has not been loaded yet. The PD is then resumed,
+ *  such that it retries the access. This is meant to be called from fault().
+ *
+ *  Returns true if the fault has been handled.
+ *  Returns false otherwise, in which case the PD remains blocked on the fault.
+ */
+static bool
+sel4cp_pd_handle_fault(sel4cp_pd pd, sel4cp_msginfo msginfo)
+{
+    if (pd > SEL4CP_MAX_PDS || sel4cp_internal_lazy_pds[pd].src == NULL || sel4cp_msginfo_get_label(msginfo) != seL4_Fault_VMFault) {
+        return false;
+    }
+    lazy_pd *lazy = &sel4cp_internal_lazy_pds[pd];
+    
+    // Other faults than translation faults, e.g. writing to a read-only page, are caused by accessing mapped pages.
+    // The message registers are read first, as they are overwritten by the invocations to load the page.
+    uint64_t vaddr = seL4_GetMR(seL4_VMFault_Addr);
+    if ((seL4_GetMR(seL4_VMFault_FSR) & ARM_FSR_STATUS_MASK) != ARM_FSR_TRANSLATION_FAULT) {
+        return false;
+    }
+    elf_program_header *prog_hdr = sel4cp_internal_find_loadable_segment(lazy->src, vaddr);
+    if (prog_hdr == NULL || sel4cp_internal_load_page(lazy->src, pd, prog_hdr, vaddr) == 0) {
+        return false;
+    }
+    lazy->num_demand_faulted_pages++;
+    
+    // Reply to the fault message, which resumes the PD.
+    seL4_Send(REPLY_CAP_IDX, seL4_MessageInfo_new(0, 0, 0, 0));
+    return true;
+}
+
+/**
+ *  Returns the number of pages of the given PD that have been loaded by sel4cp_pd_handle_fault
+ *  since the PD was created with sel4cp_pd_create_lazy, or 0 if the PD was not created that way.
+ */
+static uint64_t
+sel4cp_pd_get_num_demand_faulted_pages(sel4cp_pd pd)
+{
+    if (pd > SEL4CP_MAX_PDS) {
+        return 0;
+    }
+    return sel4cp_internal_lazy_pds[pd].num_demand_faulted_pages;
+}
+
+
+/**
+ *  Prepares loading an ELF file into a new PD with the given id while the bytes of 
+ *  the ELF file arrive, such that the ELF file does not have to be buffered in full.
+ *  The bytes are passed in order with sel4cp_pd_stream_write, after which 
+ *  sel4cp_pd_stream_finish starts the PD.
+ *
+ *  The given metadata buffer must be 8-byte aligned and large enough to hold the ELF header,
+ *  the program headers, and all bytes of the ELF file following the last loadable segment,
+ *  or, if a paged image is streamed instead, the bytes of the image preceding its data_offset.
+ *  The PDs of several streams may be created at the same time, so unlike for sel4cp_pd_create,
+ *  the objects taken from the pools for a stream that fails are not returned to the pools 
+ *  until the PD is destroyed with sel4cp_pd_destroy.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if no new PD can be created with the given id, see sel4cp_internal_check_new_pd_id,
+ *  in which case all calls for the stream fail.
+ */
+static int
+sel4cp_pd_stream_init(sel4cp_elf_stream *stream, sel4cp_pd pd, uint8_t *metadata, uint64_t metadata_size)
+{
+    stream->pd = pd;
+    stream->metadata = metadata;
+    stream->metadata_size = metadata_size;
+    stream->num_received = 0;
+    stream->headers_size = 0;
+    stream->tail_offset = 0;
+    stream->tail_base = 0;
+    stream->headers_loaded = false;
+    stream->failed = false;
+    stream->write_page_cap = 0;
+    stream->paged_image = false;
+    
+    if (sel4cp_internal_check_new_pd_id(pd)) {
+        stream->failed = true;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  Sets the metadata buffer of the given stream, see sel4cp_pd_stream_init, which has not received any bytes yet.
+ *  This allows to initialize several streams up front, checking their PD ids once,
+ *  before it is known which part of a shared metadata buffer each of them can use.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if the stream has failed or has already received bytes.
+ */
+static int
+sel4cp_pd_stream_set_metadata(sel4cp_elf_stream *stream, uint8_t *metadata, uint64_t metadata_size)
+{
+    if (stream->failed || stream->num_received != 0) {
+        return -1;
+    }
+    stream->metadata = metadata;
+    stream->metadata_size = metadata_size;
+    return 0;
+}
+
+/**
+ *  Passes the next len bytes of the ELF file of the given stream.
+ *  The PD is created as soon as the program headers have been received, 
+ *  and the bytes of the loadable segments are written directly to the pages of the PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs, in which case all further calls for the stream fail.
+ */
+static int
+sel4cp_pd_stream_write(sel4cp_elf_stream *stream, uint8_t *data, uint64_t len)
+{
+    if (stream->failed) {
+        return -1;
+    }
+    
+    // Collect the ELF header and the program headers in the metadata buffer.
+    while (!stream->headers_loaded) {
+        uint64_t target_size = stream->headers_size != 0 ? stream->headers_size : sizeof(elf_header);
+        uint64_t num_bytes = target_size - stream->num_received;
+        if (num_bytes > len) {
+            num_bytes = len;
+        }
+        for (uint64_t i = 0; i < num_bytes; i++) {
+            stream->metadata[stream->num_received + i] = data[i];
+        }
+        stream->num_received += num_bytes;
+        data += num_bytes;
+        len -= num_bytes;
+        
+        if (stream->num_received < target_size) {
+            break;
+        }
+        
+        if (stream->headers_size == 0) {
+            elf_header *elf_hdr = (elf_header *)stream->metadata;
+            sel4cp_paged_image_header *image_hdr = (sel4cp_paged_image_header *)stream->metadata;
+            if (image_hdr->magic == SEL4CP_PAGED_IMAGE_MAGIC) {
+                // Everything preceding the contents of the pages of a paged image is kept.
+                if (image_hdr->data_offset == 0 || image_hdr->data_offset % 0x1000 != 0 || image_hdr->data_offset > stream->metadata_size) {
+                    sel4cp_dbg_puts("sel4cp_pd_stream_write: the metadata buffer is too small for the headers of the paged image\n");
+                    stream->failed = true;
+                    return -1;
+                }
+                stream->paged_image = true;
+                stream->headers_size = image_hdr->data_offset;
+            }
+            else if (elf_hdr->e_phentsize != sizeof(elf_program_header) || elf_hdr->e_phnum > SEL4CP_STREAM_MAX_PROGRAM_HEADERS ||
+                     elf_hdr->e_phoff < sizeof(elf_header) || elf_hdr->e_phoff + elf_hdr->e_phnum * elf_hdr->e_phentsize > stream->metadata_size) 
+            {
+                sel4cp_dbg_puts("sel4cp_pd_stream_write: unsupported program headers\n");
+                stream->failed = true;
+                return -1;
+            }
+            else {
+                stream->headers_size = elf_hdr->e_phoff + elf_hdr->e_phnum * elf_hdr->e_phentsize;
+            }
+        }
+        else if (stream->paged_image ? sel4cp_internal_stream_load_image_headers(stream) : sel4cp_internal_stream_load_headers(stream)) {
+            stream->failed = true;
+            return -1;
+        }
+    }
+    
+    if (len == 0) {
+        return 0;
+    }
+    
+    if (stream->paged_image) {
+        if (sel4cp_internal_stream_load_image_data(stream, data, len)) {
+            stream->failed = true;
+            return -1;
+        }
+        return 0;
+    }
+    
+    if (sel4cp_internal_stream_load_range(stream, stream->num_received, data, len)) {
+        stream->failed = true;
+        return -1;
+    }
+    
+    // Keep the bytes following the loadable segments.
+    uint64_t end = stream->num_received + len;
+    if (end > stream->tail_offset) {
+        uint64_t start = stream->num_received > stream->tail_offset ? stream->num_received : stream->tail_offset;
+        uint64_t metadata_idx = stream->tail_base + (start - stream->tail_offset);
+        if (metadata_idx + (end - start) > stream->metadata_size) {
+            sel4cp_dbg_puts("sel4cp_pd_stream_write: the metadata buffer is too small for the ELF file\n");
+            stream->failed = true;
+            return -1;
+        }
+        for (uint64_t i = 0; i < end - start; i++) {
+            stream->metadata[metadata_idx + i] = data[start - stream->num_received + i];
+        }
+    }
+    stream->num_received = end;
+    return 0;
+}
+
+/**
+ *  Completes loading the ELF file of the given stream once all of its bytes have been 
+ *  passed with sel4cp_pd_stream_write: writes the PD id of the new PD, sets up the PD 
+ *  according to the access rights included in the ELF file, and starts the PD.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs.
+ */
+static int
+sel4cp_pd_stream_finish(sel4cp_elf_stream *stream)
+{
+    if (stream->failed || !stream->headers_loaded) {
+        sel4cp_dbg_puts("sel4cp_pd_stream_finish: the ELF file has not been loaded\n");
+        return -1;
+    }
+    stream->failed = true; // the stream cannot be finished twice.
+    
+    if (stream->paged_image) {
+        return sel4cp_internal_stream_finish_image(stream);
+    }
+    
+    if (sel4cp_internal_stream_relocate_metadata(stream)) {
+        return -1;
+    }
+    
+    // The access right table is only received after the loadable segments, 
+    // so the objects of the PD itself have already been allocated.
+    // The bytes received after the loadable segments end in the metadata buffer at the relocated end of the ELF file.
+    access_right_table table;
+    uint64_t metadata_size = stream->num_received - (stream->tail_offset - stream->tail_base);
+    if (sel4cp_internal_decode_access_rights(stream->metadata, metadata_size, &table) || sel4cp_internal_check_pool_capacity(&table, 0)) {
+        return -1;
+    }
+    
+    if (sel4cp_internal_stream_write_pd_id(stream, table.pd_id_vaddr)) {
+        return -1;
+    }
+    sel4cp_internal_stream_record_shared_segments(stream, &table);
+    
+    // Move capabilities for unused pool objects to the new PD, if required.
+    if (table.has_protection_domain_control) {
+        if (sel4cp_internal_move_unused_pool_caps(stream->pd, BASE_CNODE_CAP + stream->pd)) {
+            return -1;
+        }
+    }
+    
+    return sel4cp_internal_pd_finish_load(((elf_header *)stream->metadata)->e_entry, stream->pd, &table);
+}
+
+
+/**
+ *  Returns the number of bytes of the metadata buffer of the given stream 
+ *  that are in use, such that the rest of the buffer can be used for other purposes.
+ */
+static uint64_t
+sel4cp_pd_stream_get_metadata_size(sel4cp_elf_stream *stream)
+{
+    if (!stream->headers_loaded) {
+        return stream->num_received;
+    }
+    if (stream->paged_image) {
+        return stream->headers_size;
+    }
+    if (stream->num_received <= stream->tail_offset) {
+        return stream->tail_base;
+    }
+    return stream->tail_base + (stream->num_received - stream->tail_offset);
+}
+
+/**
+ *  Creates a new PD with the given id and loads the paged image of image_size bytes 
+ *  pointed to by image in this new PD, see sel4cp_paged_image_header. 
+ *  No program headers are interpreted: the contents of the image are copied one whole page
+ *  at a time, and the pages of 0-initialized runs are only allocated.
+ *  Fails if a PD with the given id already exists in the system.
+ *  Precondition: image is 8-byte aligned.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs, in which case the PD creation has been reverted like for sel4cp_pd_create.
+ */
+static int
+sel4cp_pd_create_from_image(sel4cp_pd pd, uint8_t *image, uint64_t image_size)
+{
+    sel4cp_paged_image_header *header = (sel4cp_paged_image_header *)image;
+    if (image == NULL || (uint64_t)image % 8 != 0 || image_size < sizeof(sel4cp_paged_image_header) || 
+        header->magic != SEL4CP_PAGED_IMAGE_MAGIC || header->data_offset == 0 || header->data_offset % 0x1000 != 0 || 
+        header->data_offset > image_size) 
+    {
+        sel4cp_dbg_puts("sel4cp_pd_create_from_image: invalid paged image\n");
+        return -1;
+    }
+    
+    // The headers of a paged image precede the contents of its pages, so the image is loaded 
+    // like a stream whose metadata buffer is the image itself, of which all bytes have arrived.
+    sel4cp_elf_stream stream;
+    if (sel4cp_pd_stream_init(&stream, pd, image, header->data_offset)) {
+        return -1;
+    }
+    stream.paged_image = true;
+    stream.headers_size = header->data_offset;
+    stream.num_received = header->data_offset;
+    if (sel4cp_internal_begin_pd_create(pd)) {
+        return -1;
+    }
+    int result = -1;
+    if (!sel4cp_internal_stream_load_image_headers(&stream) && 
+        !sel4cp_internal_stream_load_image_data(&stream, image + header->data_offset, image_size - header->data_offset)) 
+    {
+        result = sel4cp_internal_stream_finish_image(&stream);
+    }
+    return sel4cp_internal_end_pd_create(result);
+}
+
+/**
+ *  Creates a new PD with the given id and executes the load plan of plan_size bytes 
+ *  pointed to by plan to load a program in this new PD, see sel4cp_load_plan_header.
+ *  The plan is compiled from a patched ELF file on the host, so nothing but the operations of the plan 
+ *  is interpreted, and the paging structures are mapped without probing for them.
+ *  The pools are checked against the resource totals of the plan before any object is allocated.
+ *  Fails if a PD with the given id already exists in the system.
+ *  Precondition: plan is 8-byte aligned.
+ *
+ *  Returns 0 on success.
+ *  Returns -1 if an error occurs, in which case the PD creation has been reverted like for sel4cp_pd_create.
+ */
+static int
+sel4cp_pd_create_from_plan(sel4cp_pd pd, uint8_t *plan, uint64_t plan_size)
+{
+    access_right_table table;
+    if (sel4cp_internal_decode_load_plan(plan, plan_size, &table) || 
+        sel4cp_internal_check_plan_capacity((sel4cp_load_plan_header *)plan, &table)) 
+    {
+        return -1;
+    }
+    
+    if (sel4cp_internal_begin_pd_create(pd)) {
+        return -1;
+    }
+    uint64_t cnode_cap = sel4cp_internal_allocate_cnode(pd);
+    if (cnode_cap == 0 || (table.has_protection_domain_control && sel4cp_internal_move_unused_pool_caps(pd, cnode_cap)) ||
+        sel4cp_internal_pd_create_objects(pd, cnode_cap) || sel4cp_internal_execute_load_plan(pd, plan, &table)) 
+    {
+        sel4cp_dbg_puts("sel4cp_pd_create_from_plan: failed to load the PD\n");
+        return sel4cp_internal_end_pd_create(-1);
+    }
+    return sel4cp_internal_end_pd_create(sel4cp_internal_pd_restart(pd, ((sel4cp_load_plan_header *)plan)->entry_point));
+}
+
+/**
+ *  Checks that the given bundle of bundle_size bytes is well-formed:
+ *  the manifest fits in the bundle, the ELF files are page-aligned, lie within the bundle 
+ *  and match their CRC-32, and no two ELF files are loaded into the same PD.
+ *  Also checks that a new PD can be created with each PD id of the manifest, 
+ *  see sel4cp_internal_check_new_pd_id.
+ *
+ *  Returns 0 if the bundle is well-formed and its PDs can be created.
+ *  Returns -1 otherwise.
+ */
+static int
+sel4cp_bundle_validate(uint8_t *bundle, uint64_t bundle_size)
+{
+    sel4cp_bundle_header *header = (sel4cp_bundle_header *)bundle;
+    if (bundle_size < sizeof(sel4cp_bundle_header) || header->magic != SEL4CP_BUNDLE_MAGIC || header->num_programs > SEL4CP_BUNDLE_MAX_PROGRAMS) {
+        sel4cp_dbg_puts("sel4cp_bundle_validate: invalid bundle header\n");
+        return -1;
+    }
+    
+    uint64_t manifest_size = sizeof(sel4cp_bundle_header) + header->num_programs * sizeof(sel4cp_bundle_entry);
+    sel4cp_bundle_entry *entries = (sel4cp_bundle_entry *)(bundle + sizeof(sel4cp_bundle_header));
+    for (uint64_t i = 0; i < header->num_programs; i++) {
+        sel4cp_bundle_entry *entry = &entries[i];
+        if (sel4cp_internal_check_new_pd_id(entry->pd_id)) {
+            return -1;
+        }
+        if (entry->offset % 0x1000 != 0 || entry->offset < manifest_size || entry->size > bundle_size || entry->offset > bundle_size - entry->size) {
+            sel4cp_dbg_puts("sel4cp_bundle_validate: the ELF file for PD ");
+            sel4cp_dbg_puthex64(entry->pd_id);
+            sel4cp_dbg_puts(" does not lie within the bundle\n");
+            return -1;
+        }
+        if (sel4cp_crc32(0, bundle + entry->offset, entry->size) != entry->crc32) {
+            sel4cp_dbg_puts("sel4cp_bundle_validate: the ELF file for PD ");
+            sel4cp_dbg_puthex64(entry->pd_id);
+            sel4cp_dbg_puts(" does not match its CRC-32\n");
+            return -1;
+        }
+        access_right_table table;
+        if (sel4cp_internal_decode_access_rights(bundle + entry->offset, entry->size, &table)) {
+            sel4cp_dbg_puts("sel4cp_bundle_validate: the ELF file for PD ");
+            sel4cp_dbg_puthex64(entry->pd_id);
+            sel4cp_dbg_puts(" has invalid access rights\n");
+            return -1;
+        }
+        for (uint64_t j = 0; j < i; j++) {
+            if (entries[j].pd_id == entry->pd_id) {
+                sel4cp_dbg_puts("sel4cp_bundle_validate: several ELF files are loaded into PD ");
+                sel4cp_dbg_puthex64(entry->pd_id);
+                sel4cp_dbg_puts("\n");
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Creates a new PD for each ELF file in the given bundle of bundle_size bytes, see sel4cp_pd_create_bundle.
+ *  If lazy is true, the pages of the ELF files are loaded on demand, see sel4cp_pd_create_lazy.
+ */
+static int
+sel4cp_internal_pd_create_bundle(uint8_t *bundle, uint64_t bundle_size, bool lazy)
+{
+    if (bundle == NULL || sel4cp_bundle_validate(bundle, bundle_size)) {
+        return -1;
+    }
+    
+    sel4cp_bundle_header *header = (sel4cp_bundle_header *)bundle;
+    sel4cp_bundle_entry *entries = (sel4cp_bundle_entry *)(bundle + sizeof(sel4cp_bundle_header));
+    int num_started = 0;
+    for (uint64_t i = 0; i < header->num_programs; i++) {
+        if (sel4cp_internal_pd_create(entries[i].pd_id, bundle + entries[i].offset, entries[i].size, lazy)) {
+            sel4cp_dbg_puts("sel4cp_pd_create_bundle: failed to create a new PD with id ");
+            sel4cp_dbg_puthex64(entries[i].pd_id);
+            sel4cp_dbg_puts(" and load the ELF file from the bundle\n");
+            continue;
+        }
+        num_started++;
+    }
+    return num_started;
+}
+
+/**
+ *  Creates a new PD for each ELF file in the given bundle of bundle_size bytes,
+ *  see sel4cp_bundle_header, and starts the ELF file in it.
+ *  The ELF files are loaded directly from the bundle, in the order of the manifest.
+ *  The whole bundle is validated before any PD is created.
+ *
+ *  The temporary page used for loading and the paging structures of the loading PD
+ *  are set up once for all PDs of the bundle.
+ *
+ *  Returns the number of PDs that have been started, which is smaller than the number 
+ *  of ELF files in the bundle if loading some of them fails, in which case the objects
+ *  taken from the pools for them are returned to the pools.
+ *  Returns -1 if the bundle is malformed or a PD with an id used in the bundle already exists,
+ *  in which case no PD is created.
+ */
+static int
+sel4cp_pd_create_bundle(uint8_t *bundle, uint64_t bundle_size)
+{
+    return sel4cp_internal_pd_create_bundle(bundle, bundle_size, false);
+}
+
+/**
+ *  Creates a new PD for each ELF file in the given bundle of bundle_size bytes like
+ *  sel4cp_pd_create_bundle, but loads the pages of the ELF files on demand, see sel4cp_pd_create_lazy.
+ *  Precondition: The bundle is neither moved nor changed while any of its PDs exists.
+ */
+static int
+sel4cp_pd_create_bundle_lazy(uint8_t *bundle, uint64_t bundle_size)
+{
+    return sel4cp_internal_pd_create_bundle(bundle, bundle_size, true);
 }
 
 
@@ -0,0 +1,23 @@
+// Utilities for reading the ARM generic timer.
+// The physical counter can be read directly from user level, as the kernel
+// is configured with KernelArmExportPCNTUser.
+
+uint64_t timer_get_ticks() {
+    uint64_t ticks;
+    asm volatile("isb; mrs %0, cntpct_el0" : "=r"(ticks));
+    return ticks;
+}
+
+uint64_t timer_get_frequency() {
+    uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    return frequency;
+}
+
+uint64_t timer_us_to_ticks(uint64_t us) {
+    return (us * timer_get_frequency()) / 1000000;
+}
+
+uint64_t timer_ticks_to_us(uint64_t ticks) {
+    return (ticks * 1000000) / timer_get_frequency();
+}
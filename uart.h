@@ -6,45 +6,238 @@ extern uint8_t *uart_base_vaddr;
 #define RHR_MASK 0b111111111
 #define UARTDR 0x000
 #define UARTFR 0x018
+#define UARTLCR_H 0x02c
+#define UARTIFLS 0x034
 #define UARTIMSC 0x038
 #define UARTICR 0x044
 #define PL011_UARTFR_TXFF (1 << 5)
 #define PL011_UARTFR_RXFE (1 << 4)
+#define PL011_UARTLCR_H_FEN (1 << 4) // enables the transmit and receive FIFOs.
+#define PL011_UARTLCR_H_WLEN_8 (0b11 << 5) // 8 data bits per frame.
+#define PL011_UARTIFLS_RX_1_2 (0b010 << 3) // raise the receive interrupt when the receive FIFO is half full.
+#define PL011_UARTIFLS_TX_1_2 (0b010 << 0) // raise the transmit interrupt when the transmit FIFO is half empty.
+#define PL011_UARTIMSC_RXIM (1 << 4)
+#define PL011_UARTIMSC_TXIM (1 << 5)
+#define PL011_UARTIMSC_RTIM (1 << 6)
 
 #define REG_PTR(base, offset) ((volatile uint32_t *)((base) + (offset)))
 
+// Characters to transmit are queued in a ring buffer, which is drained into the 
+// transmit FIFO whenever there is room, i.e. when the transmit interrupt is raised.
+// The size must be a power of two.
+#define UART_TX_BUFFER_SIZE 0x1000
+
+static char uart_tx_buffer[UART_TX_BUFFER_SIZE];
+static uint64_t uart_tx_head = 0; // the index of the next character to transmit.
+static uint64_t uart_tx_tail = 0; // the index of the next free entry.
+static uint64_t uart_tx_num_dropped = 0; // the characters dropped because the buffer was full, reported once it has drained.
+static bool uart_tx_at_line_start = true; // whether the last character moved into the transmit FIFO ended a line.
+
+// A protocol reply, see uart_put_reply, is not queued behind the characters in the ring buffer,
+// but kept in a slot of its own that uart_tx_flush transmits ahead of them at the next line boundary,
+// such that the reply neither waits for the queued output nor splits a line of it.
+// A reply that has not started yet is replaced by a newer one, as each reply supersedes the previous ones.
+#define UART_REPLY_MAX_SIZE 8
+
+static uint8_t uart_reply[UART_REPLY_MAX_SIZE]; // the reply being transmitted.
+static int uart_reply_size = 0;
+static int uart_reply_num_sent = 0;
+static uint8_t uart_next_reply[UART_REPLY_MAX_SIZE]; // the reply to transmit once uart_reply has been transmitted.
+static int uart_next_reply_size = 0; // 0 if there is no next reply.
+
+// The kernel's debug output (sel4cp_dbg_puts) is written straight into the transmit FIFO,
+// bypassing the ring buffer. To keep both in order, the ring buffer must be drained before
+// any debug output, see uart_dbg_puts. This includes calls of the sel4cp functions that print,
+// except for those loading the payload of each frame, which only print if they fail:
+// draining before every frame would make each reply wait for the UART.
+
 void uart_init() {
-    *REG_PTR(uart_base_vaddr, UARTIMSC) = 0x50;
+    // Enable the FIFOs such that a single interrupt can cover several received characters.
+    // The receive timeout interrupt ensures that characters left below the FIFO trigger level are still delivered.
+    *REG_PTR(uart_base_vaddr, UARTLCR_H) = PL011_UARTLCR_H_FEN | PL011_UARTLCR_H_WLEN_8;
+    *REG_PTR(uart_base_vaddr, UARTIFLS) = PL011_UARTIFLS_RX_1_2 | PL011_UARTIFLS_TX_1_2;
+    *REG_PTR(uart_base_vaddr, UARTIMSC) = PL011_UARTIMSC_RXIM | PL011_UARTIMSC_RTIM;
+}
+
+int uart_has_char() {
+    return (*REG_PTR(uart_base_vaddr, UARTFR) & PL011_UARTFR_RXFE) == 0;
 }
 
 int uart_get_char() {
     int ch = 0;
 
-    if ((*REG_PTR(uart_base_vaddr, UARTFR) & PL011_UARTFR_RXFE) == 0) {
+    if (uart_has_char()) {
         ch = *REG_PTR(uart_base_vaddr, UARTDR) & RHR_MASK;
     }
 
     return ch;
 }
 
-void uart_put_char(int ch) {
-    while ((*REG_PTR(uart_base_vaddr, UARTFR) & PL011_UARTFR_TXFF) != 0);
+int uart_tx_pending() {
+    return uart_tx_head != uart_tx_tail || uart_reply_num_sent < uart_reply_size || uart_next_reply_size != 0;
+}
 
-    *REG_PTR(uart_base_vaddr, UARTDR) = ch;
-    if (ch == '\r') {
-        uart_put_char('\n');
+// Writes the given integer as a 64 bit hexadecimal number into the given buffer,
+// formatted in the same way as sel4cp_dbg_puthex64.
+void uart_format_hex64(char buffer[19], uint64_t val) {
+    buffer[0] = '0';
+    buffer[1] = 'x';
+    for (int i = 0; i < 16; i++) {
+        uint8_t digit = (val >> (4 * (15 - i))) & 0xf;
+        buffer[2 + i] = digit < 10 ? '0' + digit : 'a' + digit - 10;
     }
+    buffer[18] = '\0';
 }
 
-void uart_put_str(char *str) {
-    while (*str) {
-        uart_put_char(*str);
-        str++;
+// Queues the given character without translation and without waiting for the UART.
+// Returns 0 and counts the character as dropped if the transmit buffer is full.
+int uart_queue_char(int ch) {
+    if (uart_tx_tail - uart_tx_head >= UART_TX_BUFFER_SIZE) {
+        uart_tx_num_dropped++;
+        return 0;
     }
+    uart_tx_buffer[uart_tx_tail % UART_TX_BUFFER_SIZE] = ch;
+    uart_tx_tail++;
+    return 1;
 }
 
-void uart_handle_irq() {
-    *REG_PTR(uart_base_vaddr, UARTICR) = 0x7f0;
+// Queues a line reporting the number of dropped characters, if any, which is
+// done once the transmit buffer has drained such that the line itself is not dropped.
+void uart_report_dropped() {
+    if (uart_tx_num_dropped == 0 || uart_tx_pending()) {
+        return;
+    }
+    char count[19];
+    uart_format_hex64(count, uart_tx_num_dropped);
+    uart_tx_num_dropped = 0;
+    
+    char *parts[3] = { "\r\nuart: dropped ", count, " characters of output\r\n" };
+    for (int i = 0; i < 3; i++) {
+        for (char *c = parts[i]; *c; c++) {
+            uart_queue_char(*c);
+        }
+    }
+}
+
+// Moves the pending reply and queued characters into the transmit FIFO until either is exhausted.
+// The reply goes first once the characters moved so far end with a complete line, or once none are left.
+// The transmit interrupt is only enabled while characters or a reply remain.
+void uart_tx_flush() {
+    uart_report_dropped();
+    while ((*REG_PTR(uart_base_vaddr, UARTFR) & PL011_UARTFR_TXFF) == 0) {
+        if (uart_reply_num_sent == uart_reply_size && uart_next_reply_size != 0) {
+            for (int i = 0; i < uart_next_reply_size; i++) {
+                uart_reply[i] = uart_next_reply[i];
+            }
+            uart_reply_size = uart_next_reply_size;
+            uart_reply_num_sent = 0;
+            uart_next_reply_size = 0;
+        }
+        
+        // A reply that has started is completed first, such that it is not split by other output.
+        if (uart_reply_num_sent < uart_reply_size && 
+            (uart_reply_num_sent > 0 || uart_tx_at_line_start || uart_tx_head == uart_tx_tail)) 
+        {
+            *REG_PTR(uart_base_vaddr, UARTDR) = uart_reply[uart_reply_num_sent];
+            uart_reply_num_sent++;
+        }
+        else if (uart_tx_head != uart_tx_tail) {
+            char ch = uart_tx_buffer[uart_tx_head % UART_TX_BUFFER_SIZE];
+            *REG_PTR(uart_base_vaddr, UARTDR) = ch;
+            uart_tx_head++;
+            uart_tx_at_line_start = ch == '\n';
+        }
+        else {
+            break;
+        }
+        
+        if (!uart_tx_pending()) {
+            uart_report_dropped();
+        }
+    }
+    
+    if (uart_tx_pending()) {
+        *REG_PTR(uart_base_vaddr, UARTIMSC) |= PL011_UARTIMSC_TXIM;
+    }
+    else {
+        *REG_PTR(uart_base_vaddr, UARTIMSC) &= ~PL011_UARTIMSC_TXIM;
+    }
+}
+
+// Transmits all queued characters and the pending reply, waiting for room in the transmit FIFO if necessary.
+// This must be done before handing the UART IRQ over to another PD, 
+// as the queued characters would otherwise never be transmitted.
+void uart_tx_drain() {
+    while (uart_tx_pending()) {
+        uart_tx_flush();
+    }
+}
+
+// Queues the given character for transmission without waiting for the UART.
+// The character is queued as is, i.e. a line feed is not preceded by a carriage return.
+// Returns 0 if the character was dropped because the transmit buffer is full.
+int uart_put_char(int ch) {
+    if (!uart_queue_char(ch)) {
+        return 0;
+    }
+    uart_tx_flush();
+    return 1;
+}
+
+// Transmits the given reply without any translation of line feeds ahead of the queued characters,
+// at the next line boundary, see uart_reply, without waiting for the UART.
+// Returns 0 if the reply is larger than UART_REPLY_MAX_SIZE.
+int uart_put_reply(uint8_t *bytes, int num_bytes) {
+    if (num_bytes > UART_REPLY_MAX_SIZE) {
+        return 0;
+    }
+    for (int i = 0; i < num_bytes; i++) {
+        uart_next_reply[i] = bytes[i];
+    }
+    uart_next_reply_size = num_bytes;
+    uart_tx_flush();
+    return 1;
 }
 
+// Queues the given string for transmission without waiting for the UART.
+// Line feeds are preceded by a carriage return, matching the output of sel4cp_dbg_puts.
+// Characters that do not fit in the transmit buffer are dropped and reported once it has drained.
+// Returns the number of characters of the string queued.
+int uart_put_str(char *str) {
+    int num_queued = 0;
+    for (; *str; str++) {
+        if (*str == '\n' && !uart_queue_char('\r')) {
+            uart_tx_num_dropped++;
+            continue;
+        }
+        num_queued += uart_queue_char(*str);
+    }
+    uart_tx_flush();
+    return num_queued;
+}
 
+// Queues the given integer as a 64 bit hexadecimal number,
+// formatted in the same way as sel4cp_dbg_puthex64.
+void uart_put_hex64(uint64_t val) {
+    char buffer[19];
+    uart_format_hex64(buffer, val);
+    uart_put_str(buffer);
+}
+
+// Prints the given string through sel4cp_dbg_puts once all queued characters have been transmitted,
+// such that it appears after them.
+void uart_dbg_puts(const char *str) {
+    uart_tx_drain();
+    sel4cp_dbg_puts(str);
+}
+
+// Prints the given integer through sel4cp_dbg_puthex64 once all queued characters have been transmitted.
+void uart_dbg_puthex64(uint64_t val) {
+    uart_tx_drain();
+    sel4cp_dbg_puthex64(val);
+}
+
+void uart_handle_irq() {
+    *REG_PTR(uart_base_vaddr, UARTICR) = 0x7f0;
+    uart_tx_flush();
+}